@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstdlib>
+#include <atomic>
+
+#include "alloc.hpp"
+
+static std::atomic<bool> counting(false);
+static std::atomic<unsigned long long> allocations(0);
+static std::atomic<unsigned long long> bytes(0);
+
+static inline void count(size_t size)
+{
+    if (counting.load(std::memory_order_relaxed)) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+}
+
+#ifdef __GLIBC__
+
+/* Replace the allocation functions as documented in the glibc manual,
+ * section "Replacing malloc", and forward to the glibc implementations. */
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+
+void* malloc(size_t size)
+{
+    count(size);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size)
+{
+    count(n * size);
+    return __libc_calloc(n, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    count(size);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr)
+{
+    __libc_free(ptr);
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+    count(size);
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+    count(size);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size)
+{
+    // like glibc: a power of two multiple of sizeof(void*)
+    size_t multiple = alignment / sizeof(void*);
+    if (alignment == 0 || alignment % sizeof(void*) != 0 || (multiple & (multiple - 1)) != 0)
+        return 22; // EINVAL
+    count(size);
+    void* p = __libc_memalign(alignment, size);
+    if (!p && size != 0)
+        return 12; // ENOMEM
+    *ptr = p;
+    return 0;
+}
+
+}
+
+bool allocCountingAvailable()
+{
+    return true;
+}
+
+#else
+
+bool allocCountingAvailable()
+{
+    return false;
+}
+
+#endif
+
+void allocCountingStart()
+{
+    allocations.store(0);
+    bytes.store(0);
+    counting.store(true);
+}
+
+AllocCounts allocCountingStop()
+{
+    counting.store(false);
+    return AllocCounts { allocations.load(), bytes.load() };
+}
+
+void AllocProbe::begin()
+{
+    allocCountingStart();
+}
+
+void AllocProbe::end(Result& result)
+{
+    AllocCounts c = allocCountingStop();
+    result.add("heap allocations per iteration", double(c.allocations) / result.iterations, "");
+    result.add("heap bytes per iteration", double(c.bytes) / result.iterations, "bytes");
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ALLOC_HPP
+#define ALLOC_HPP
+
+#include "benchmark.hpp"
+
+/* Counting of heap allocations in all threads, e.g. by the OpenGL driver.
+ * This works by replacing malloc() and friends and is only available with
+ * the GNU C library. */
+
+struct AllocCounts
+{
+    unsigned long long allocations;
+    unsigned long long bytes;
+};
+
+bool allocCountingAvailable();
+void allocCountingStart();
+AllocCounts allocCountingStop();
+
+/* A probe that reports heap allocations per iteration */
+class AllocProbe : public Probe
+{
+public:
+    void begin() override;
+    void end(Result& result) override;
+};
+
+#endif
@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "benchmark.hpp"
+
+/* Cost of barriers between dependent passes. Each iteration runs two passes;
+ * the second one reads what the first one wrote. The reference runs the same
+ * passes on independent data without a barrier. */
+
+#ifndef GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT
+#define GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT 0x00004000
+#endif
+#ifndef GL_QUERY_BUFFER_BARRIER_BIT
+#define GL_QUERY_BUFFER_BARRIER_BIT 0x00008000
+#endif
+
+typedef void (QOPENGLF_APIENTRYP TextureBarrier)();
+
+static const char copyCS[] =
+    "layout(local_size_x = 64) in;\n"
+    "layout(std430, binding = 0) readonly buffer Src { vec4 src[]; };\n"
+    "layout(std430, binding = 1) writeonly buffer Dst { vec4 dst[]; };\n"
+    "void main()\n"
+    "{\n"
+    "    uint i = gl_GlobalInvocationID.x;\n"
+    "    dst[i] = src[i] * 0.5 + vec4(1.0);\n"
+    "}\n";
+
+static const char imageStoreFS[] =
+    "layout(r32f, binding = 0) writeonly uniform highp image2D img;\n"
+    "layout(location = 0) out vec4 fcolor;\n"
+    "void main()\n"
+    "{\n"
+    "    imageStore(img, ivec2(gl_FragCoord.xy), vec4(gl_FragCoord.x * gl_FragCoord.y));\n"
+    "    fcolor = vec4(0.0);\n"
+    "}\n";
+
+static const char imageLoadFS[] =
+    "layout(r32f, binding = 0) readonly uniform highp image2D img;\n"
+    "layout(location = 0) out vec4 fcolor;\n"
+    "void main()\n"
+    "{\n"
+    "    fcolor = imageLoad(img, ivec2(gl_FragCoord.xy));\n"
+    "}\n";
+
+static const char feedbackFS[] =
+    "uniform highp sampler2D tex;\n"
+    "layout(location = 0) out vec4 fcolor;\n"
+    "void main()\n"
+    "{\n"
+    "    fcolor = texelFetch(tex, ivec2(gl_FragCoord.xy), 0) * 0.5 + vec4(0.25);\n"
+    "}\n";
+
+void benchmarkBarrier(Bench& bench)
+{
+    QOpenGLExtraFunctions* gl = bench.gl;
+    if (!bench.atLeast(43, 31)) {
+        bench.skip("requires OpenGL 4.3 or OpenGL ES 3.1");
+        return;
+    }
+    const struct { GLbitfield bit; const char* name; bool byRegion; } barriers[] = {
+        { GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT, "GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT", false },
+        { GL_ELEMENT_ARRAY_BARRIER_BIT, "GL_ELEMENT_ARRAY_BARRIER_BIT", false },
+        { GL_UNIFORM_BARRIER_BIT, "GL_UNIFORM_BARRIER_BIT", true },
+        { GL_TEXTURE_FETCH_BARRIER_BIT, "GL_TEXTURE_FETCH_BARRIER_BIT", true },
+        { GL_SHADER_IMAGE_ACCESS_BARRIER_BIT, "GL_SHADER_IMAGE_ACCESS_BARRIER_BIT", true },
+        { GL_COMMAND_BARRIER_BIT, "GL_COMMAND_BARRIER_BIT", false },
+        { GL_PIXEL_BUFFER_BARRIER_BIT, "GL_PIXEL_BUFFER_BARRIER_BIT", false },
+        { GL_TEXTURE_UPDATE_BARRIER_BIT, "GL_TEXTURE_UPDATE_BARRIER_BIT", false },
+        { GL_BUFFER_UPDATE_BARRIER_BIT, "GL_BUFFER_UPDATE_BARRIER_BIT", false },
+        { GL_FRAMEBUFFER_BARRIER_BIT, "GL_FRAMEBUFFER_BARRIER_BIT", true },
+        { GL_TRANSFORM_FEEDBACK_BARRIER_BIT, "GL_TRANSFORM_FEEDBACK_BARRIER_BIT", false },
+        { GL_ATOMIC_COUNTER_BARRIER_BIT, "GL_ATOMIC_COUNTER_BARRIER_BIT", true },
+        { GL_SHADER_STORAGE_BARRIER_BIT, "GL_SHADER_STORAGE_BARRIER_BIT", true },
+        { GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT, "GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT", false },
+        { GL_QUERY_BUFFER_BARRIER_BIT, "GL_QUERY_BUFFER_BARRIER_BIT", false },
+        { GL_ALL_BARRIER_BITS, "GL_ALL_BARRIER_BITS", true }
+    };
+    const int elements = 64 * 1024;
+    const int size = 1024;
+
+    /* Compute: glMemoryBarrier with each bit between two dispatches */
+    GLuint computePrg = bench.computeProgram(copyCS);
+    if (!computePrg) {
+        bench.skip("cannot build compute program");
+        return;
+    }
+    gl->glUseProgram(computePrg);
+    GLuint buffers[4];
+    gl->glGenBuffers(4, buffers);
+    for (GLuint b : buffers) {
+        gl->glBindBuffer(GL_SHADER_STORAGE_BUFFER, b);
+        gl->glBufferData(GL_SHADER_STORAGE_BUFFER, elements * 4 * sizeof(float), nullptr, GL_DYNAMIC_COPY);
+    }
+    gl->glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    // Pass 1 copies buffer 0 to 1, pass 2 copies buffer 1 (dependent) or 2 (independent) to 3
+    auto computePasses = [&](GLuint secondSource, const std::function<void ()>& barrier) {
+        gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffers[0]);
+        gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, buffers[1]);
+        gl->glDispatchCompute(elements / 64, 1, 1);
+        barrier();
+        gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, secondSource);
+        gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, buffers[3]);
+        gl->glDispatchCompute(elements / 64, 1, 1);
+    };
+    Result& r0 = bench.measure("barrier", "compute, no barrier (independent)",
+            [&]() { computePasses(buffers[2], []() {}); });
+    double reference = r0.seconds;
+    for (const auto& b : barriers) {
+        // These bits were added in OpenGL 4.4 and are not part of OpenGL ES
+        if ((b.bit == GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT || b.bit == GL_QUERY_BUFFER_BARRIER_BIT)
+                && (bench.isGLES() || !bench.atLeast(44, 0)))
+            continue;
+        Result& r = bench.measure("barrier", QString("compute, glMemoryBarrier %1").arg(b.name),
+                [&]() { computePasses(buffers[1], [&]() { gl->glMemoryBarrier(b.bit); }); });
+        r.add("cost over no barrier", (r.seconds - reference) * 1e3, "ms");
+    }
+    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+    gl->glDeleteBuffers(4, buffers);
+    gl->glDeleteProgram(computePrg);
+
+    /* Fragment: image stores in one draw, image loads in the next */
+    GLint fragmentImages = 0;
+    gl->glGetIntegerv(GL_MAX_FRAGMENT_IMAGE_UNIFORMS, &fragmentImages);
+    GLuint colorTex = bench.texture(GL_RGBA8, size, size);
+    GLuint fbo = bench.framebuffer(colorTex);
+    gl->glViewport(0, 0, size, size);
+    if (fragmentImages < 1) {
+        bench.skip("fragment image access: not supported");
+    } else {
+        GLuint storePrg = bench.program(fullScreenTriangleVS, imageStoreFS);
+        GLuint loadPrg = bench.program(fullScreenTriangleVS, imageLoadFS);
+        if (!storePrg || !loadPrg) {
+            bench.skip("fragment image access: cannot build shader programs");
+        } else {
+            GLuint images[2] = { bench.texture(GL_R32F, size, size), bench.texture(GL_R32F, size, size) };
+            auto fragmentPasses = [&](GLuint secondImage, const std::function<void ()>& barrier) {
+                gl->glUseProgram(storePrg);
+                gl->glBindImageTexture(0, images[0], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+                gl->glDrawArrays(GL_TRIANGLES, 0, 3);
+                barrier();
+                gl->glUseProgram(loadPrg);
+                gl->glBindImageTexture(0, secondImage, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+                gl->glDrawArrays(GL_TRIANGLES, 0, 3);
+            };
+            Result& f0 = bench.measure("barrier", "fragment, no barrier (independent)",
+                    [&]() { fragmentPasses(images[1], []() {}); });
+            reference = f0.seconds;
+            Result& f1 = bench.measure("barrier", "fragment, glMemoryBarrier GL_SHADER_IMAGE_ACCESS_BARRIER_BIT",
+                    [&]() { fragmentPasses(images[0], [&]() { gl->glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT); }); });
+            f1.add("cost over no barrier", (f1.seconds - reference) * 1e3, "ms");
+            if (bench.atLeast(45, 31)) {
+                for (const auto& b : barriers) {
+                    if (!b.byRegion)
+                        continue;
+                    Result& r = bench.measure("barrier", QString("fragment, glMemoryBarrierByRegion %1").arg(b.name),
+                            [&]() { fragmentPasses(images[0], [&]() { gl->glMemoryBarrierByRegion(b.bit); }); });
+                    r.add("cost over no barrier", (r.seconds - reference) * 1e3, "ms");
+                }
+            } else {
+                bench.skip("glMemoryBarrierByRegion: requires OpenGL 4.5 or OpenGL ES 3.1");
+            }
+            gl->glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+            gl->glDeleteTextures(2, images);
+        }
+        gl->glDeleteProgram(storePrg);
+        gl->glDeleteProgram(loadPrg);
+    }
+
+    /* Fragment: read-modify-write of the render target via texture fetches */
+    TextureBarrier textureBarrier = nullptr;
+    if (!bench.isGLES() && (bench.atLeast(45, 0) || bench.hasExtension("GL_ARB_texture_barrier")))
+        textureBarrier = bench.getProc<TextureBarrier>("glTextureBarrier");
+    else if (bench.hasExtension("GL_NV_texture_barrier"))
+        textureBarrier = bench.getProc<TextureBarrier>("glTextureBarrierNV");
+    GLuint feedbackPrg = bench.program(fullScreenTriangleVS, feedbackFS);
+    if (!textureBarrier) {
+        bench.skip("glTextureBarrier: requires OpenGL 4.5, GL_ARB_texture_barrier, or GL_NV_texture_barrier");
+    } else if (!feedbackPrg) {
+        bench.skip("glTextureBarrier: cannot build shader program");
+    } else {
+        GLuint otherTex = bench.texture(GL_RGBA8, size, size);
+        gl->glUseProgram(feedbackPrg);
+        gl->glUniform1i(gl->glGetUniformLocation(feedbackPrg, "tex"), 0);
+        gl->glActiveTexture(GL_TEXTURE0);
+        Result& t0 = bench.measure("barrier", "render target feedback, no barrier (independent)", [&]() {
+                gl->glBindTexture(GL_TEXTURE_2D, otherTex);
+                gl->glDrawArrays(GL_TRIANGLES, 0, 3);
+                gl->glDrawArrays(GL_TRIANGLES, 0, 3);
+            });
+        reference = t0.seconds;
+        Result& t1 = bench.measure("barrier", "render target feedback, glTextureBarrier", [&]() {
+                // Both draws read what the previous one (possibly of the
+                // previous iteration) wrote, so both need a barrier
+                gl->glBindTexture(GL_TEXTURE_2D, colorTex);
+                textureBarrier();
+                gl->glDrawArrays(GL_TRIANGLES, 0, 3);
+                textureBarrier();
+                gl->glDrawArrays(GL_TRIANGLES, 0, 3);
+            });
+        t1.add("cost over no barrier", (t1.seconds - reference) * 1e3, "ms");
+        t1.add("cost per barrier", (t1.seconds - reference) * 1e3 / 2, "ms");
+        gl->glBindTexture(GL_TEXTURE_2D, 0);
+        gl->glDeleteTextures(1, &otherTex);
+    }
+    gl->glDeleteProgram(feedbackPrg);
+    gl->glDeleteFramebuffers(1, &fbo);
+    gl->glDeleteTextures(1, &colorTex);
+}
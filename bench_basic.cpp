@@ -0,0 +1,337 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <vector>
+
+#include "benchmark.hpp"
+
+static const char constantColorFS[] =
+    "uniform vec4 color;\n"
+    "layout(location = 0) out vec4 fcolor;\n"
+    "void main()\n"
+    "{\n"
+    "    fcolor = color;\n"
+    "}\n";
+
+static const char positionVS[] =
+    "layout(location = 0) in vec2 pos;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position = vec4(pos, 0.0, 1.0);\n"
+    "}\n";
+
+void benchmarkFill(Bench& bench)
+{
+    QOpenGLExtraFunctions* gl = bench.gl;
+    const struct { GLenum format; const char* name; } formats[] = {
+        { GL_RGBA8, "RGBA8" },
+        { GL_RGBA16F, "RGBA16F" },
+        { GL_RGBA32F, "RGBA32F" }
+    };
+    const int sizes[][2] = { { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 } };
+
+    GLuint prg = bench.program(fullScreenTriangleVS, constantColorFS);
+    if (!prg) {
+        bench.skip("cannot build shader program");
+        return;
+    }
+    gl->glUseProgram(prg);
+    gl->glUniform4f(gl->glGetUniformLocation(prg, "color"), 0.1f, 0.2f, 0.3f, 0.4f);
+    bool haveHalfFloat = !bench.isGLES() || bench.hasExtension("GL_EXT_color_buffer_half_float")
+        || bench.hasExtension("GL_EXT_color_buffer_float");
+    bool haveFloat = !bench.isGLES() || bench.hasExtension("GL_EXT_color_buffer_float");
+    if (!haveHalfFloat)
+        bench.skip("RGBA16F: requires rendering to RGBA16F");
+    if (!haveFloat)
+        bench.skip("RGBA32F: requires GL_EXT_color_buffer_float");
+    for (const auto& f : formats) {
+        if ((f.format == GL_RGBA16F && !haveHalfFloat) || (f.format == GL_RGBA32F && !haveFloat))
+            continue;
+        for (const auto& s : sizes) {
+            GLuint tex = bench.texture(f.format, s[0], s[1]);
+            GLuint fbo = bench.framebuffer(tex);
+            gl->glViewport(0, 0, s[0], s[1]);
+            Result& r = bench.measure("fill", QString("%1 %2x%3").arg(f.name).arg(s[0]).arg(s[1]),
+                    [&]() { gl->glDrawArrays(GL_TRIANGLES, 0, 3); });
+            r.addRate("fill rate", double(s[0]) * s[1] / 1e9, "GPixel/s");
+            gl->glDeleteFramebuffers(1, &fbo);
+            gl->glDeleteTextures(1, &tex);
+        }
+    }
+    gl->glDeleteProgram(prg);
+}
+
+void benchmarkDraw(Bench& bench)
+{
+    QOpenGLExtraFunctions* gl = bench.gl;
+    const int gridSize = 512; // quads per row and column
+
+    GLuint prg = bench.program(positionVS, constantColorFS);
+    if (!prg) {
+        bench.skip("cannot build shader program");
+        return;
+    }
+    gl->glUseProgram(prg);
+    gl->glUniform4f(gl->glGetUniformLocation(prg, "color"), 0.1f, 0.2f, 0.3f, 0.4f);
+
+    GLuint buffers[2];
+    GLsizei indexCount = bench.gridMesh(gridSize, buffers);
+
+    GLuint tex = bench.texture(GL_RGBA8, 1024, 1024);
+    GLuint fbo = bench.framebuffer(tex);
+    gl->glViewport(0, 0, 1024, 1024);
+
+    Result& r1 = bench.measure("draw", "glDrawElements 2 triangles",
+            [&]() { gl->glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr); });
+    r1.addRate("draw calls", 1.0, "1/s");
+    Result& r2 = bench.measure("draw", QString("glDrawElements %1 triangles").arg(2 * gridSize * gridSize),
+            [&]() { gl->glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr); });
+    r2.addRate("triangles", 2.0 * gridSize * gridSize / 1e6, "MTriangles/s");
+
+    gl->glDisableVertexAttribArray(0);
+    gl->glBindBuffer(GL_ARRAY_BUFFER, 0);
+    gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    gl->glDeleteBuffers(2, buffers);
+    gl->glDeleteFramebuffers(1, &fbo);
+    gl->glDeleteTextures(1, &tex);
+    gl->glDeleteProgram(prg);
+}
+
+void benchmarkUpload(Bench& bench)
+{
+    QOpenGLExtraFunctions* gl = bench.gl;
+
+    const int bufferSizes[] = { 64 * 1024, 1024 * 1024, 16 * 1024 * 1024 };
+    std::vector<unsigned char> data(16 * 1024 * 1024);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = i * 7;
+    GLuint buf;
+    gl->glGenBuffers(1, &buf);
+    gl->glBindBuffer(GL_ARRAY_BUFFER, buf);
+    for (int size : bufferSizes) {
+        gl->glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+        Result& r = bench.measure("upload", QString("glBufferSubData %1 KiB").arg(size / 1024),
+                [&]() { gl->glBufferSubData(GL_ARRAY_BUFFER, 0, size, data.data()); });
+        r.addRate("bandwidth", size / 1e9, "GB/s");
+    }
+    gl->glBindBuffer(GL_ARRAY_BUFFER, 0);
+    gl->glDeleteBuffers(1, &buf);
+
+    const int textureSizes[] = { 256, 1024, 2048 };
+    for (int size : textureSizes) {
+        GLuint tex = bench.texture(GL_RGBA8, size, size);
+        Result& r = bench.measure("upload", QString("glTexSubImage2D RGBA8 %1x%1").arg(size),
+                [&]() { gl->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, data.data()); });
+        r.addRate("bandwidth", 4.0 * size * size / 1e9, "GB/s");
+        gl->glDeleteTextures(1, &tex);
+    }
+}
+
+void benchmarkCompute(Bench& bench)
+{
+    QOpenGLExtraFunctions* gl = bench.gl;
+    if (!bench.atLeast(43, 31)) {
+        bench.skip("requires OpenGL 4.3 or OpenGL ES 3.1");
+        return;
+    }
+
+    const int loopIterations = 256;
+    const int groups = 1024;
+    const int groupSize = 256;
+    GLuint prg = bench.computeProgram(
+            "layout(local_size_x = 256) in;\n"
+            "layout(std430, binding = 0) buffer Data { vec4 data[]; };\n"
+            "uniform float k;\n"
+            "void main()\n"
+            "{\n"
+            "    vec4 a0 = vec4(float(gl_GlobalInvocationID.x));\n"
+            "    vec4 a1 = a0 + 1.0, a2 = a0 + 2.0, a3 = a0 + 3.0;\n"
+            "    for (int i = 0; i < 256; i++) {\n"
+            "        a0 = a0 * k + k; a1 = a1 * k + k; a2 = a2 * k + k; a3 = a3 * k + k;\n"
+            "    }\n"
+            "    data[gl_GlobalInvocationID.x] = a0 + a1 + a2 + a3;\n"
+            "}\n");
+    if (!prg) {
+        bench.skip("cannot build compute program");
+        return;
+    }
+    gl->glUseProgram(prg);
+    gl->glUniform1f(gl->glGetUniformLocation(prg, "k"), 0.999f);
+    GLuint buf;
+    gl->glGenBuffers(1, &buf);
+    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buf);
+    gl->glBufferData(GL_SHADER_STORAGE_BUFFER, groups * groupSize * 4 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+
+    Result& r1 = bench.measure("compute", "glDispatchCompute 1 group",
+            [&]() { gl->glDispatchCompute(1, 1, 1); });
+    r1.addRate("dispatches", 1.0, "1/s");
+    Result& r2 = bench.measure("compute", QString("glDispatchCompute %1 groups").arg(groups),
+            [&]() { gl->glDispatchCompute(groups, 1, 1); });
+    // 4 vec4 multiply-adds = 32 floating point operations per loop iteration
+    r2.addRate("arithmetic", 32.0 * loopIterations * groups * groupSize / 1e9, "GFLOP/s");
+
+    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+    gl->glDeleteBuffers(1, &buf);
+    gl->glDeleteProgram(prg);
+}
+
+void benchmarkState(Bench& bench)
+{
+    QOpenGLExtraFunctions* gl = bench.gl;
+
+    GLuint prg[2] = {
+        bench.program(fullScreenTriangleVS, constantColorFS),
+        bench.program(fullScreenTriangleVS,
+                "uniform sampler2D tex;\n"
+                "layout(location = 0) out vec4 fcolor;\n"
+                "void main()\n"
+                "{\n"
+                "    fcolor = texelFetch(tex, ivec2(gl_FragCoord.xy), 0);\n"
+                "}\n")
+    };
+    if (!prg[0] || !prg[1]) {
+        bench.skip("cannot build shader programs");
+        return;
+    }
+    GLuint tex[2] = { bench.texture(GL_RGBA8, 64, 64), bench.texture(GL_RGBA8, 64, 64) };
+    GLuint target[2] = { bench.texture(GL_RGBA8, 64, 64), bench.texture(GL_RGBA8, 64, 64) };
+    GLuint fbo[2] = { bench.framebuffer(target[0]), bench.framebuffer(target[1]) };
+    gl->glViewport(0, 0, 64, 64);
+    gl->glUseProgram(prg[1]);
+    gl->glBindTexture(GL_TEXTURE_2D, tex[0]);
+
+    int i = 0;
+    Result& r0 = bench.measure("state", "no state change", [&]() {
+            gl->glDrawArrays(GL_TRIANGLES, 0, 3);
+        });
+    r0.addRate("draw calls", 1.0, "1/s");
+    Result& r1 = bench.measure("state", "glUseProgram", [&]() {
+            gl->glUseProgram(prg[i++ & 1]);
+            gl->glDrawArrays(GL_TRIANGLES, 0, 3);
+        });
+    r1.addRate("draw calls", 1.0, "1/s");
+    gl->glUseProgram(prg[1]);
+    Result& r2 = bench.measure("state", "glBindTexture", [&]() {
+            gl->glBindTexture(GL_TEXTURE_2D, tex[i++ & 1]);
+            gl->glDrawArrays(GL_TRIANGLES, 0, 3);
+        });
+    r2.addRate("draw calls", 1.0, "1/s");
+    Result& r3 = bench.measure("state", "glEnable/glDisable GL_BLEND", [&]() {
+            if (i++ & 1)
+                gl->glEnable(GL_BLEND);
+            else
+                gl->glDisable(GL_BLEND);
+            gl->glDrawArrays(GL_TRIANGLES, 0, 3);
+        });
+    r3.addRate("draw calls", 1.0, "1/s");
+    gl->glDisable(GL_BLEND);
+    Result& r4 = bench.measure("state", "glBindFramebuffer", [&]() {
+            gl->glBindFramebuffer(GL_FRAMEBUFFER, fbo[i++ & 1]);
+            gl->glDrawArrays(GL_TRIANGLES, 0, 3);
+        });
+    r4.addRate("draw calls", 1.0, "1/s");
+
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    gl->glDeleteFramebuffers(2, fbo);
+    gl->glDeleteTextures(2, target);
+    gl->glDeleteTextures(2, tex);
+    gl->glDeleteProgram(prg[0]);
+    gl->glDeleteProgram(prg[1]);
+}
+
+void benchmarkUniform(Bench& bench)
+{
+    QOpenGLExtraFunctions* gl = bench.gl;
+
+    GLuint prg = bench.program(
+            "uniform mat4 matrix;\n"
+            "void main()\n"
+            "{\n"
+            "    vec2 p = vec2(float((gl_VertexID & 1) << 2) - 1.0, float((gl_VertexID & 2) << 1) - 1.0);\n"
+            "    gl_Position = matrix * vec4(p, 0.0, 1.0);\n"
+            "}\n",
+            "uniform vec4 color;\n"
+            "uniform vec4 colors[64];\n"
+            "layout(std140) uniform Block { vec4 blockColors[64]; };\n"
+            "layout(location = 0) out vec4 fcolor;\n"
+            "void main()\n"
+            "{\n"
+            "    int i = int(gl_FragCoord.x) & 63;\n"
+            "    fcolor = color + colors[i] + blockColors[i];\n"
+            "}\n");
+    if (!prg) {
+        bench.skip("cannot build shader program");
+        return;
+    }
+    gl->glUseProgram(prg);
+    GLint matrixLoc = gl->glGetUniformLocation(prg, "matrix");
+    GLint colorLoc = gl->glGetUniformLocation(prg, "color");
+    GLint colorsLoc = gl->glGetUniformLocation(prg, "colors");
+    gl->glUniformBlockBinding(prg, gl->glGetUniformBlockIndex(prg, "Block"), 0);
+    float values[4 * 64];
+    for (int j = 0; j < 4 * 64; j++)
+        values[j] = j / 256.0f;
+    GLuint ubo;
+    gl->glGenBuffers(1, &ubo);
+    gl->glBindBufferBase(GL_UNIFORM_BUFFER, 0, ubo);
+    gl->glBufferData(GL_UNIFORM_BUFFER, sizeof(values), values, GL_DYNAMIC_DRAW);
+    const float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+    gl->glUniformMatrix4fv(matrixLoc, 1, GL_FALSE, identity);
+    GLuint tex = bench.texture(GL_RGBA8, 64, 64);
+    GLuint fbo = bench.framebuffer(tex);
+    gl->glViewport(0, 0, 64, 64);
+
+    int i = 0;
+    Result& r0 = bench.measure("uniform", "glUniform4f", [&]() {
+            gl->glUniform4f(colorLoc, i++ & 1, 0.0f, 0.0f, 1.0f);
+        });
+    r0.addRate("updates", 1.0, "1/s");
+    Result& r1 = bench.measure("uniform", "glUniform4f + draw", [&]() {
+            gl->glUniform4f(colorLoc, i++ & 1, 0.0f, 0.0f, 1.0f);
+            gl->glDrawArrays(GL_TRIANGLES, 0, 3);
+        });
+    r1.addRate("draw calls", 1.0, "1/s");
+    Result& r2 = bench.measure("uniform", "glUniformMatrix4fv + draw", [&]() {
+            gl->glUniformMatrix4fv(matrixLoc, 1, GL_FALSE, identity);
+            gl->glDrawArrays(GL_TRIANGLES, 0, 3);
+        });
+    r2.addRate("draw calls", 1.0, "1/s");
+    Result& r3 = bench.measure("uniform", "glUniform4fv 64 vec4 + draw", [&]() {
+            values[0] = i++ & 1;
+            gl->glUniform4fv(colorsLoc, 64, values);
+            gl->glDrawArrays(GL_TRIANGLES, 0, 3);
+        });
+    r3.addRate("draw calls", 1.0, "1/s");
+    Result& r4 = bench.measure("uniform", "glBufferSubData UBO 64 vec4 + draw", [&]() {
+            values[0] = i++ & 1;
+            gl->glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(values), values);
+            gl->glDrawArrays(GL_TRIANGLES, 0, 3);
+        });
+    r4.addRate("draw calls", 1.0, "1/s");
+
+    gl->glBindBufferBase(GL_UNIFORM_BUFFER, 0, 0);
+    gl->glDeleteBuffers(1, &ubo);
+    gl->glDeleteFramebuffers(1, &fbo);
+    gl->glDeleteTextures(1, &tex);
+    gl->glDeleteProgram(prg);
+}
@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <vector>
+
+#include "benchmark.hpp"
+
+/* Bandwidth of clears, blits, and copies, the building blocks of
+ * post-processing chains. Blits and copies report the sum of bytes read and
+ * written, glClearTexImage the bytes written. glClear reports pixels cleared
+ * instead: drivers may implement it as a fast clear that only updates
+ * compression metadata, so its rate says nothing about memory bandwidth. */
+
+typedef void (QOPENGLF_APIENTRYP ClearTexImage)(GLuint texture, GLint level, GLenum format, GLenum type, const void* data);
+typedef void (QOPENGLF_APIENTRYP CopyImageSubData)(GLuint srcName, GLenum srcTarget, GLint srcLevel, GLint srcX, GLint srcY, GLint srcZ,
+        GLuint dstName, GLenum dstTarget, GLint dstLevel, GLint dstX, GLint dstY, GLint dstZ,
+        GLsizei srcWidth, GLsizei srcHeight, GLsizei srcDepth);
+
+void benchmarkCopy(Bench& bench)
+{
+    QOpenGLExtraFunctions* gl = bench.gl;
+    const struct { GLenum format; GLenum type; int bytes; const char* name; } formats[] = {
+        { GL_RGBA8, GL_UNSIGNED_BYTE, 4, "RGBA8" },
+        { GL_RGBA16F, GL_FLOAT, 8, "RGBA16F" },
+        { GL_RGBA32F, GL_FLOAT, 16, "RGBA32F" }
+    };
+    const int sizes[] = { 1024, 2048, 4096 };
+    const unsigned char clearBytes[4] = { 25, 51, 76, 102 };
+    const float clearFloats[4] = { 0.1f, 0.2f, 0.3f, 0.4f };
+
+    ClearTexImage clearTexImage = nullptr;
+    if (!bench.isGLES() && (bench.atLeast(44, 0) || bench.hasExtension("GL_ARB_clear_texture")))
+        clearTexImage = bench.getProc<ClearTexImage>("glClearTexImage");
+    else if (bench.isGLES() && bench.hasExtension("GL_EXT_clear_texture"))
+        clearTexImage = bench.getProc<ClearTexImage>("glClearTexImageEXT");
+    CopyImageSubData copyImageSubData = nullptr;
+    if (bench.atLeast(43, 32))
+        copyImageSubData = bench.getProc<CopyImageSubData>("glCopyImageSubData");
+    if (!clearTexImage)
+        bench.skip("glClearTexImage: requires OpenGL 4.4, GL_ARB_clear_texture, or GL_EXT_clear_texture");
+    if (!copyImageSubData)
+        bench.skip("glCopyImageSubData: requires OpenGL 4.3 or OpenGL ES 3.2");
+
+    bool haveHalfFloat = !bench.isGLES() || bench.hasExtension("GL_EXT_color_buffer_half_float")
+        || bench.hasExtension("GL_EXT_color_buffer_float");
+    bool haveFloat = !bench.isGLES() || bench.hasExtension("GL_EXT_color_buffer_float");
+    if (!haveHalfFloat)
+        bench.skip("RGBA16F: requires rendering to RGBA16F");
+    if (!haveFloat)
+        bench.skip("RGBA32F: requires GL_EXT_color_buffer_float");
+
+    for (const auto& f : formats) {
+        if ((f.format == GL_RGBA16F && !haveHalfFloat) || (f.format == GL_RGBA32F && !haveFloat))
+            continue;
+        for (int size : sizes) {
+            QString suffix = QString("%1 %2x%2").arg(f.name).arg(size);
+            double bytes = double(size) * size * f.bytes;
+            GLuint srcTex = bench.texture(f.format, size, size);
+            GLuint srcFbo = bench.framebuffer(srcTex);
+            GLuint dstTex = bench.texture(f.format, size, size);
+            GLuint dstFbo = bench.framebuffer(dstTex);
+            gl->glViewport(0, 0, size, size);
+
+            // Clears of the destination
+            gl->glClearColor(clearFloats[0], clearFloats[1], clearFloats[2], clearFloats[3]);
+            Result& r0 = bench.measure("copy", "glClear " + suffix,
+                    [&]() { gl->glClear(GL_COLOR_BUFFER_BIT); });
+            r0.addRate("clear rate", double(size) * size / 1e9, "GPixel/s");
+            r0.notes.append("may be a fast clear; not a bandwidth measurement");
+            if (clearTexImage) {
+                const void* data = (f.type == GL_UNSIGNED_BYTE ? static_cast<const void*>(clearBytes) : clearFloats);
+                Result& r = bench.measure("copy", "glClearTexImage " + suffix,
+                        [&]() { clearTexImage(dstTex, 0, GL_RGBA, f.type, data); });
+                r.addRate("bandwidth (write)", bytes / 1e9, "GB/s");
+            }
+
+            // Blits from the source to the destination
+            gl->glBindFramebuffer(GL_READ_FRAMEBUFFER, srcFbo);
+            Result& r1 = bench.measure("copy", "glBlitFramebuffer " + suffix,
+                    [&]() { gl->glBlitFramebuffer(0, 0, size, size, 0, 0, size, size, GL_COLOR_BUFFER_BIT, GL_NEAREST); });
+            r1.addRate("bandwidth (read + write)", 2.0 * bytes / 1e9, "GB/s");
+            Result& r2 = bench.measure("copy", "glBlitFramebuffer linear downscale " + suffix,
+                    [&]() { gl->glBlitFramebuffer(0, 0, size, size, 0, 0, size / 2, size / 2, GL_COLOR_BUFFER_BIT, GL_LINEAR); });
+            r2.addRate("bandwidth (read + write)", 1.25 * bytes / 1e9, "GB/s");
+            Result& r3 = bench.measure("copy", "glBlitFramebuffer linear upscale " + suffix,
+                    [&]() { gl->glBlitFramebuffer(0, 0, size / 2, size / 2, 0, 0, size, size, GL_COLOR_BUFFER_BIT, GL_LINEAR); });
+            r3.addRate("bandwidth (read + write)", 1.25 * bytes / 1e9, "GB/s");
+
+            // Copy without a framebuffer
+            if (copyImageSubData) {
+                Result& r = bench.measure("copy", "glCopyImageSubData " + suffix,
+                        [&]() { copyImageSubData(srcTex, GL_TEXTURE_2D, 0, 0, 0, 0, dstTex, GL_TEXTURE_2D, 0, 0, 0, 0, size, size, 1); });
+                r.addRate("bandwidth (read + write)", 2.0 * bytes / 1e9, "GB/s");
+            }
+
+            gl->glDeleteFramebuffers(1, &dstFbo);
+            gl->glDeleteFramebuffers(1, &srcFbo);
+            gl->glDeleteTextures(1, &dstTex);
+            gl->glDeleteTextures(1, &srcTex);
+        }
+    }
+
+    // Depth clears
+    const struct { GLenum format; const char* name; } depthFormats[] = {
+        { GL_DEPTH_COMPONENT24, "DEPTH24" },
+        { GL_DEPTH_COMPONENT32F, "DEPTH32F" }
+    };
+    for (const auto& f : depthFormats) {
+        for (int size : sizes) {
+            GLuint tex = bench.texture(f.format, size, size);
+            GLuint fbo = bench.framebuffer(0, tex);
+            gl->glViewport(0, 0, size, size);
+            gl->glClearDepthf(0.5f);
+            Result& r = bench.measure("copy", QString("glClear %1 %2x%2").arg(f.name).arg(size),
+                    [&]() { gl->glClear(GL_DEPTH_BUFFER_BIT); });
+            r.addRate("clear rate", double(size) * size / 1e9, "GPixel/s");
+            r.notes.append("may be a fast clear; not a bandwidth measurement");
+            gl->glDeleteFramebuffers(1, &fbo);
+            gl->glDeleteTextures(1, &tex);
+        }
+    }
+    gl->glClearDepthf(1.0f);
+    gl->glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
+    // Buffer copies
+    const int bufferSizes[] = { 1, 16, 64 };
+    GLuint buffers[2];
+    gl->glGenBuffers(2, buffers);
+    gl->glBindBuffer(GL_COPY_READ_BUFFER, buffers[0]);
+    gl->glBindBuffer(GL_COPY_WRITE_BUFFER, buffers[1]);
+    for (int mib : bufferSizes) {
+        GLsizeiptr size = GLsizeiptr(mib) * 1024 * 1024;
+        std::vector<unsigned char> data(size, 0x55);
+        gl->glBufferData(GL_COPY_READ_BUFFER, size, data.data(), GL_STATIC_COPY);
+        gl->glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STATIC_COPY);
+        Result& r = bench.measure("copy", QString("glCopyBufferSubData %1 MiB").arg(mib),
+                [&]() { gl->glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, size); });
+        r.addRate("bandwidth (read + write)", 2.0 * size / 1e9, "GB/s");
+    }
+    gl->glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    gl->glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    gl->glDeleteBuffers(2, buffers);
+}
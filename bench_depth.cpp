@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+
+#include "benchmark.hpp"
+
+/* Depth-only rendering as in shadow map passes: a stack of full-coverage
+ * grids drawn with an empty fragment shader into depth and depth-stencil
+ * formats, front to back (so that early depth tests reject hidden fragments)
+ * and back to front, and into the six faces of a cube map, either with one
+ * pass per face or in a single layered pass via a geometry shader. */
+
+static const char casterVS[] =
+    "layout(location = 0) in vec2 pos;\n"
+    "uniform float zStart;\n"
+    "uniform float zStep;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position = vec4(pos, zStart + zStep * float(gl_InstanceID), 1.0);\n"
+    "}\n";
+
+static const char casterFS[] =
+    "void main()\n"
+    "{\n"
+    "}\n";
+
+static const char cubeGS[] =
+    "layout(triangles) in;\n"
+    "layout(triangle_strip, max_vertices = 18) out;\n"
+    "void main()\n"
+    "{\n"
+    "    for (int face = 0; face < 6; face++) {\n"
+    "        for (int i = 0; i < 3; i++) {\n"
+    "            gl_Layer = face;\n"
+    "            gl_Position = gl_in[i].gl_Position;\n"
+    "            EmitVertex();\n"
+    "        }\n"
+    "        EndPrimitive();\n"
+    "    }\n"
+    "}\n";
+
+static GLuint depthFramebuffer(QOpenGLExtraFunctions* gl, GLenum target, GLuint tex, bool stencil, bool layered)
+{
+    GLuint fbo;
+    gl->glGenFramebuffers(1, &fbo);
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    GLenum attachment = stencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+    if (layered)
+        gl->glFramebufferTexture(GL_FRAMEBUFFER, attachment, tex, 0);
+    else
+        gl->glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, target, tex, 0);
+    GLenum drawBuffer = GL_NONE;
+    gl->glDrawBuffers(1, &drawBuffer);
+    gl->glReadBuffer(GL_NONE);
+    if (gl->glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        fprintf(stderr, "framebuffer object is incomplete\n");
+    return fbo;
+}
+
+void benchmarkDepth(Bench& bench)
+{
+    QOpenGLExtraFunctions* gl = bench.gl;
+    const int layers = 8;
+    const int gridSize = 128;
+    const double triangles = 2.0 * gridSize * gridSize * layers;
+    const struct { const char* name; GLenum format; bool stencil; } formats[] = {
+        { "DEPTH16", GL_DEPTH_COMPONENT16, false },
+        { "DEPTH24", GL_DEPTH_COMPONENT24, false },
+        { "DEPTH32F", GL_DEPTH_COMPONENT32F, false },
+        { "DEPTH24_STENCIL8", GL_DEPTH24_STENCIL8, true },
+        { "DEPTH32F_STENCIL8", GL_DEPTH32F_STENCIL8, true }
+    };
+    const int sizes[] = { 1024, 2048, 4096 };
+
+    GLuint prg = bench.program(casterVS, casterFS);
+    if (!prg) {
+        bench.skip("cannot build shader program");
+        return;
+    }
+    GLuint buffers[2];
+    GLsizei indexCount = bench.gridMesh(gridSize, buffers);
+    gl->glUseProgram(prg);
+    GLint zStartLoc = gl->glGetUniformLocation(prg, "zStart");
+    GLint zStepLoc = gl->glGetUniformLocation(prg, "zStep");
+    gl->glEnable(GL_DEPTH_TEST);
+    gl->glDepthFunc(GL_LESS);
+    gl->glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    auto drawCasters = [&]() {
+        gl->glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr, layers);
+    };
+    const struct { const char* name; float zStart, zStep; } orders[] = {
+        { "front to back", -0.9f, 0.2f },
+        { "back to front", 0.9f, -0.2f }
+    };
+
+    for (const auto& f : formats) {
+        GLbitfield clearBits = GL_DEPTH_BUFFER_BIT | (f.stencil ? GL_STENCIL_BUFFER_BIT : 0);
+        for (int size : sizes) {
+            GLuint tex = bench.texture(f.format, size, size);
+            GLuint fbo = depthFramebuffer(gl, GL_TEXTURE_2D, tex, f.stencil, false);
+            gl->glViewport(0, 0, size, size);
+            for (const auto& o : orders) {
+                gl->glUniform1f(zStartLoc, o.zStart);
+                gl->glUniform1f(zStepLoc, o.zStep);
+                Result& r = bench.measure("depth", QString("%1 %2 %3x%3").arg(f.name, o.name).arg(size),
+                        [&]() {
+                            gl->glClear(clearBits);
+                            drawCasters();
+                        });
+                r.addRate("triangles", triangles / 1e6, "MTriangles/s");
+                r.addRate("depth-tested pixels", double(layers) * size * size / 1e9, "GPixel/s");
+            }
+            gl->glDeleteFramebuffers(1, &fbo);
+            gl->glDeleteTextures(1, &tex);
+        }
+    }
+
+    // Cube map shadows. Each face sees the same casters, front to back.
+    // Sizes are limited to 4096 to bound the memory use.
+    GLint maxCubeSize = 0;
+    gl->glGetIntegerv(GL_MAX_CUBE_MAP_TEXTURE_SIZE, &maxCubeSize);
+    if (maxCubeSize > 4096)
+        bench.skip(QString("cube maps larger than 4096x4096 (maximum is %1x%1)").arg(maxCubeSize));
+    bool layeredSupported = bench.atLeast(42, 32);
+    if (!layeredSupported)
+        bench.skip("layered cube map rendering: requires OpenGL ES 3.2");
+    GLuint layeredPrg = layeredSupported ? bench.program(casterVS, casterFS, cubeGS) : 0;
+    if (layeredSupported && !layeredPrg)
+        bench.skip("layered cube map rendering: cannot build shader program");
+    for (int size = 256; size <= std::min(maxCubeSize, 4096); size *= 2) {
+        GLuint tex;
+        gl->glGenTextures(1, &tex);
+        gl->glBindTexture(GL_TEXTURE_CUBE_MAP, tex);
+        gl->glTexStorage2D(GL_TEXTURE_CUBE_MAP, 1, GL_DEPTH_COMPONENT24, size, size);
+        gl->glViewport(0, 0, size, size);
+        GLuint faceFbos[6];
+        for (int face = 0; face < 6; face++)
+            faceFbos[face] = depthFramebuffer(gl, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, tex, false, false);
+        gl->glUseProgram(prg);
+        gl->glUniform1f(zStartLoc, -0.9f);
+        gl->glUniform1f(zStepLoc, 0.2f);
+        Result& r0 = bench.measure("depth", QString("cube DEPTH24 6 passes %1x%1").arg(size),
+                [&]() {
+                    for (int face = 0; face < 6; face++) {
+                        gl->glBindFramebuffer(GL_FRAMEBUFFER, faceFbos[face]);
+                        gl->glClear(GL_DEPTH_BUFFER_BIT);
+                        drawCasters();
+                    }
+                });
+        r0.addRate("triangles", 6.0 * triangles / 1e6, "MTriangles/s");
+        r0.addRate("depth-tested pixels", 6.0 * layers * size * size / 1e9, "GPixel/s");
+        double passesSeconds = r0.seconds;
+        gl->glDeleteFramebuffers(6, faceFbos);
+        if (layeredPrg) {
+            GLuint fbo = depthFramebuffer(gl, GL_TEXTURE_CUBE_MAP, tex, false, true);
+            gl->glUseProgram(layeredPrg);
+            gl->glUniform1f(gl->glGetUniformLocation(layeredPrg, "zStart"), -0.9f);
+            gl->glUniform1f(gl->glGetUniformLocation(layeredPrg, "zStep"), 0.2f);
+            Result& r1 = bench.measure("depth", QString("cube DEPTH24 layered geometry shader %1x%1").arg(size),
+                    [&]() {
+                        gl->glClear(GL_DEPTH_BUFFER_BIT);
+                        drawCasters();
+                    });
+            r1.addRate("triangles", 6.0 * triangles / 1e6, "MTriangles/s");
+            r1.addRate("depth-tested pixels", 6.0 * layers * size * size / 1e9, "GPixel/s");
+            r1.add("cost over 6 passes", (r1.seconds - passesSeconds) * 1e3, "ms");
+            gl->glDeleteFramebuffers(1, &fbo);
+        }
+        gl->glDeleteTextures(1, &tex);
+    }
+
+    gl->glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    gl->glDisable(GL_DEPTH_TEST);
+    gl->glDisableVertexAttribArray(0);
+    gl->glBindBuffer(GL_ARRAY_BUFFER, 0);
+    gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    gl->glDeleteBuffers(2, buffers);
+    gl->glDeleteProgram(layeredPrg);
+    gl->glDeleteProgram(prg);
+}
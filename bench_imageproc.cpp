@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <vector>
+
+#include "benchmark.hpp"
+
+/* Image processing kernels on an RGBA16F image, implemented with compute
+ * shaders that access the image via imageLoad/imageStore, via texelFetch and
+ * imageStore, or as a shader storage buffer of packed half floats, and with an
+ * equivalent fragment shader pass. Each kernel is a function process(p) that
+ * reads the source via load(p). */
+
+static const char blurKernel[] =
+    "const float weights[5] = float[5](0.227027, 0.1945946, 0.1216216, 0.054054, 0.016216);\n"
+    "vec4 process(ivec2 p)\n"
+    "{\n"
+    "    vec4 s = load(p) * weights[0];\n"
+    "    for (int i = 1; i < 5; i++)\n"
+    "        s += (load(p + ivec2(i, 0)) + load(p - ivec2(i, 0))) * weights[i];\n"
+    "    return s;\n"
+    "}\n";
+
+static const char convolutionKernel[] =
+    "uniform float weights[25];\n"
+    "vec4 process(ivec2 p)\n"
+    "{\n"
+    "    vec4 s = vec4(0.0);\n"
+    "    for (int y = -2; y <= 2; y++)\n"
+    "        for (int x = -2; x <= 2; x++)\n"
+    "            s += load(p + ivec2(x, y)) * weights[(y + 2) * 5 + x + 2];\n"
+    "    return s;\n"
+    "}\n";
+
+static const char tonemapKernel[] =
+    "uniform float exposure;\n"
+    "vec4 process(ivec2 p)\n"
+    "{\n"
+    "    vec3 c = load(p).rgb * exposure;\n"
+    "    c = c / (c + vec3(1.0));\n"
+    "    return vec4(pow(c, vec3(1.0 / 2.2)), 1.0);\n"
+    "}\n";
+
+static const char imageAccess[] =
+    "layout(rgba16f, binding = 0) readonly uniform highp image2D srcImage;\n"
+    "layout(rgba16f, binding = 1) writeonly uniform highp image2D dstImage;\n"
+    "uniform ivec2 size;\n"
+    "vec4 load(ivec2 p)\n"
+    "{\n"
+    "    return imageLoad(srcImage, clamp(p, ivec2(0), size - 1));\n"
+    "}\n"
+    "void store(ivec2 p, vec4 v)\n"
+    "{\n"
+    "    imageStore(dstImage, p, v);\n"
+    "}\n";
+
+static const char samplerAccess[] =
+    "uniform highp sampler2D srcTex;\n"
+    "layout(rgba16f, binding = 1) writeonly uniform highp image2D dstImage;\n"
+    "uniform ivec2 size;\n"
+    "vec4 load(ivec2 p)\n"
+    "{\n"
+    "    return texelFetch(srcTex, clamp(p, ivec2(0), size - 1), 0);\n"
+    "}\n"
+    "void store(ivec2 p, vec4 v)\n"
+    "{\n"
+    "    imageStore(dstImage, p, v);\n"
+    "}\n";
+
+static const char bufferAccess[] =
+    "layout(std430, binding = 0) readonly buffer Src { uvec2 src[]; };\n"
+    "layout(std430, binding = 1) writeonly buffer Dst { uvec2 dst[]; };\n"
+    "uniform ivec2 size;\n"
+    "vec4 load(ivec2 p)\n"
+    "{\n"
+    "    p = clamp(p, ivec2(0), size - 1);\n"
+    "    uvec2 v = src[p.y * size.x + p.x];\n"
+    "    return vec4(unpackHalf2x16(v.x), unpackHalf2x16(v.y));\n"
+    "}\n"
+    "void store(ivec2 p, vec4 v)\n"
+    "{\n"
+    "    dst[p.y * size.x + p.x] = uvec2(packHalf2x16(v.xy), packHalf2x16(v.zw));\n"
+    "}\n";
+
+static const char computeMain[] =
+    "layout(local_size_x = 16, local_size_y = 16) in;\n"
+    "void main()\n"
+    "{\n"
+    "    ivec2 p = ivec2(gl_GlobalInvocationID.xy);\n"
+    "    if (all(lessThan(p, size)))\n"
+    "        store(p, process(p));\n"
+    "}\n";
+
+static const char fragmentShader[] =
+    "uniform highp sampler2D srcTex;\n"
+    "uniform ivec2 size;\n"
+    "layout(location = 0) out vec4 fcolor;\n"
+    "vec4 load(ivec2 p)\n"
+    "{\n"
+    "    return texelFetch(srcTex, clamp(p, ivec2(0), size - 1), 0);\n"
+    "}\n"
+    "%KERNEL%"
+    "void main()\n"
+    "{\n"
+    "    fcolor = process(ivec2(gl_FragCoord.xy));\n"
+    "}\n";
+
+void benchmarkImageProcessing(Bench& bench)
+{
+    QOpenGLExtraFunctions* gl = bench.gl;
+    const struct { const char* name; const char* source; } kernels[] = {
+        { "blur", blurKernel },
+        { "convolution", convolutionKernel },
+        { "tonemap", tonemapKernel }
+    };
+    enum { Fragment, Image, Sampler, Buffer };
+    const struct { const char* name; const char* access; } approaches[] = {
+        { "fragment shader", nullptr },
+        { "imageLoad/imageStore", imageAccess },
+        { "texelFetch/imageStore", samplerAccess },
+        { "SSBO", bufferAccess }
+    };
+    const int sizes[][2] = { { 1920, 1080 }, { 3840, 2160 } };
+    float weights[25];
+    for (int i = 0; i < 25; i++)
+        weights[i] = (i == 12 ? 2.0f : -1.0f / 24.0f);
+
+    bool compute = bench.atLeast(43, 31);
+    if (!compute)
+        bench.skip("compute shaders: require OpenGL 4.3 or OpenGL ES 3.1");
+    bool fragment = !bench.isGLES() || bench.hasExtension("GL_EXT_color_buffer_half_float")
+        || bench.hasExtension("GL_EXT_color_buffer_float");
+    if (!fragment)
+        bench.skip("fragment shaders: require rendering to RGBA16F");
+    gl->glActiveTexture(GL_TEXTURE0);
+    for (const auto& s : sizes) {
+        int w = s[0], h = s[1];
+        double bytes = 2.0 * w * h * 8; // one read and one write of each RGBA16F pixel
+        std::vector<unsigned short> data(4 * w * h, 0x3800); // 0.5 in half float
+        GLuint srcTex = bench.texture(GL_RGBA16F, w, h);
+        gl->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, GL_RGBA, GL_HALF_FLOAT, data.data());
+        GLuint dstTex = bench.texture(GL_RGBA16F, w, h);
+        GLuint fbo = fragment ? bench.framebuffer(dstTex) : 0;
+        gl->glViewport(0, 0, w, h);
+        GLuint buffers[2];
+        gl->glGenBuffers(2, buffers);
+        gl->glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[0]);
+        gl->glBufferData(GL_SHADER_STORAGE_BUFFER, data.size() * sizeof(unsigned short), data.data(), GL_STATIC_DRAW);
+        gl->glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[1]);
+        gl->glBufferData(GL_SHADER_STORAGE_BUFFER, data.size() * sizeof(unsigned short), nullptr, GL_DYNAMIC_COPY);
+        gl->glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        gl->glBindTexture(GL_TEXTURE_2D, srcTex);
+
+        for (const auto& k : kernels) {
+            // the fragment shader pass comes first and is the reference
+            double fragmentSeconds = 0.0;
+            for (int a = Fragment; a <= Buffer; a++) {
+                if ((a == Fragment && !fragment) || (a != Fragment && !compute))
+                    continue;
+                QString name = QString("%1 %2 %3x%4").arg(k.name, approaches[a].name).arg(w).arg(h);
+                GLuint prg = (a == Fragment
+                        ? bench.program(fullScreenTriangleVS, QByteArray(fragmentShader).replace("%KERNEL%", k.source))
+                        : bench.computeProgram(QByteArray(approaches[a].access) + k.source + computeMain));
+                if (!prg) {
+                    bench.skip(name + ": cannot build shader program");
+                    continue;
+                }
+                gl->glUseProgram(prg);
+                gl->glUniform2i(gl->glGetUniformLocation(prg, "size"), w, h);
+                gl->glUniform1i(gl->glGetUniformLocation(prg, "srcTex"), 0);
+                gl->glUniform1fv(gl->glGetUniformLocation(prg, "weights"), 25, weights);
+                gl->glUniform1f(gl->glGetUniformLocation(prg, "exposure"), 1.5f);
+                if (a == Image)
+                    gl->glBindImageTexture(0, srcTex, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA16F);
+                if (a == Image || a == Sampler)
+                    gl->glBindImageTexture(1, dstTex, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+                if (a == Buffer) {
+                    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffers[0]);
+                    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, buffers[1]);
+                }
+                Result& r = bench.measure("imageproc", name, [&]() {
+                        if (a == Fragment)
+                            gl->glDrawArrays(GL_TRIANGLES, 0, 3);
+                        else
+                            gl->glDispatchCompute((w + 15) / 16, (h + 15) / 16, 1);
+                    });
+                r.addRate("bandwidth (read + write)", bytes / 1e9, "GB/s");
+                if (a == Fragment)
+                    fragmentSeconds = r.seconds;
+                else if (fragmentSeconds > 0.0)
+                    r.add("cost over fragment shader", (r.seconds - fragmentSeconds) * 1e3, "ms");
+                if (a == Image || a == Sampler) {
+                    gl->glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA16F);
+                    gl->glBindImageTexture(1, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+                }
+                if (a == Buffer) {
+                    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+                    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+                }
+                gl->glDeleteProgram(prg);
+            }
+        }
+
+        gl->glDeleteBuffers(2, buffers);
+        gl->glDeleteFramebuffers(1, &fbo);
+        gl->glDeleteTextures(1, &dstTex);
+        gl->glDeleteTextures(1, &srcTex);
+    }
+}
@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cmath>
+#include <vector>
+
+#include "benchmark.hpp"
+
+/* Many copies of a small mesh (8 triangles), each with its own position,
+ * scale, and rotation (one vec4), e.g. for vegetation or crowds. The instance
+ * data comes from an instanced vertex attribute, from a shader storage buffer
+ * or a texture buffer indexed by gl_InstanceID, or from an instanced vertex
+ * attribute with one indirect draw command per batch of 1024 instances that
+ * selects the batch via its base instance, as after per-batch culling. */
+
+typedef void (QOPENGLF_APIENTRYP MultiDrawElementsIndirect)(GLenum mode, GLenum type,
+        const void* indirect, GLsizei drawcount, GLsizei stride);
+
+#ifndef GL_TEXTURE_BUFFER
+#define GL_TEXTURE_BUFFER 0x8C2A
+#endif
+#ifndef GL_MAX_TEXTURE_BUFFER_SIZE
+#define GL_MAX_TEXTURE_BUFFER_SIZE 0x8C2B
+#endif
+
+static const char placeFunction[] =
+    "layout(location = 0) in vec2 pos;\n"
+    "vec4 place(vec4 instance)\n"
+    "{\n"
+    "    float c = cos(instance.w);\n"
+    "    float s = sin(instance.w);\n"
+    "    return vec4(mat2(c, s, -s, c) * pos * instance.z + instance.xy, 0.0, 1.0);\n"
+    "}\n";
+
+static const char attributeVS[] =
+    "layout(location = 1) in vec4 instance;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position = place(instance);\n"
+    "}\n";
+
+static const char storageBufferVS[] =
+    "layout(std430, binding = 0) readonly buffer Instances { vec4 instances[]; };\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position = place(instances[gl_InstanceID]);\n"
+    "}\n";
+
+static const char textureBufferVS[] =
+    "uniform highp samplerBuffer instances;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position = place(texelFetch(instances, gl_InstanceID));\n"
+    "}\n";
+
+static const char instanceFS[] =
+    "layout(location = 0) out vec4 fcolor;\n"
+    "void main()\n"
+    "{\n"
+    "    fcolor = vec4(0.2, 0.6, 0.1, 1.0);\n"
+    "}\n";
+
+void benchmarkInstancing(Bench& bench)
+{
+    QOpenGLExtraFunctions* gl = bench.gl;
+    const int width = 1920;
+    const int height = 1080;
+    const int meshSize = 2;
+    const int batchSize = 1024;
+    const int counts[] = { 10000, 100000, 1000000, 10000000 };
+
+    GLint vertexBuffers = 0;
+    if (bench.atLeast(43, 31))
+        gl->glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &vertexBuffers);
+    if (vertexBuffers < 1)
+        bench.skip("storage buffers: require OpenGL 4.3 or OpenGL ES 3.1 with storage buffers in vertex shaders");
+    GLint maxTextureBufferSize = 0;
+    if (bench.atLeast(42, 32))
+        gl->glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTextureBufferSize);
+    else
+        bench.skip("texture buffers: require OpenGL ES 3.2");
+    MultiDrawElementsIndirect multiDrawElementsIndirect = nullptr;
+    if (!bench.isGLES() && bench.atLeast(43, 0))
+        multiDrawElementsIndirect = bench.getProc<MultiDrawElementsIndirect>("glMultiDrawElementsIndirect");
+    else if (bench.hasExtension("GL_EXT_multi_draw_indirect") && bench.hasExtension("GL_EXT_base_instance"))
+        multiDrawElementsIndirect = bench.getProc<MultiDrawElementsIndirect>("glMultiDrawElementsIndirectEXT");
+    else
+        bench.skip("base instance indirect draws: require OpenGL 4.3 or GL_EXT_multi_draw_indirect and GL_EXT_base_instance");
+
+    GLuint attributePrg = bench.program(QByteArray(placeFunction) + attributeVS, instanceFS);
+    GLuint storageBufferPrg = vertexBuffers > 0 ? bench.program(QByteArray(placeFunction) + storageBufferVS, instanceFS) : 0;
+    GLuint textureBufferPrg = maxTextureBufferSize > 0 ? bench.program(QByteArray(placeFunction) + textureBufferVS, instanceFS) : 0;
+    if (!attributePrg) {
+        gl->glDeleteProgram(storageBufferPrg);
+        gl->glDeleteProgram(textureBufferPrg);
+        bench.skip("cannot build shader programs");
+        return;
+    }
+    GLuint colorTex = bench.texture(GL_RGBA8, width, height);
+    GLuint fbo = bench.framebuffer(colorTex);
+    gl->glViewport(0, 0, width, height);
+    GLuint meshBuffers[2];
+    GLsizei indexCount = bench.gridMesh(meshSize, meshBuffers);
+    const double triangles = 2.0 * meshSize * meshSize;
+
+    for (int n : counts) {
+        std::vector<float> instances(4 * size_t(n));
+        for (int i = 0; i < n; i++) {
+            float* p = instances.data() + 4 * size_t(i);
+            double x = i * 0.6180339887, y = i * 0.7548776662;
+            p[0] = float(x - std::floor(x)) * 2.0f - 1.0f;
+            p[1] = float(y - std::floor(y)) * 2.0f - 1.0f;
+            p[2] = 0.002f;
+            p[3] = i * 0.1f;
+        }
+        GLuint instanceBuffer;
+        gl->glGenBuffers(1, &instanceBuffer);
+        gl->glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        gl->glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(float), instances.data(), GL_STATIC_DRAW);
+        gl->glBindBuffer(GL_ARRAY_BUFFER, 0);
+        auto name = [&](const char* method) { return QString("%1, %2 instances").arg(method).arg(n); };
+        auto addMetrics = [&](Result& r) {
+            r.addRate("instances", n / 1e6, "MInstances/s");
+            r.addRate("triangles", n * triangles / 1e6, "MTriangles/s");
+        };
+        auto drawInstanced = [&]() {
+            gl->glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr, n);
+        };
+
+        // Instanced vertex attribute
+        gl->glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        gl->glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 0, nullptr);
+        gl->glVertexAttribDivisor(1, 1);
+        gl->glEnableVertexAttribArray(1);
+        gl->glBindBuffer(GL_ARRAY_BUFFER, 0);
+        gl->glUseProgram(attributePrg);
+        Result& r0 = bench.measure("instancing", name("instanced arrays"), drawInstanced);
+        addMetrics(r0);
+        double attributeSeconds = r0.seconds;
+
+        // Base instance indirect draws with the same attribute
+        if (multiDrawElementsIndirect) {
+            int batches = (n + batchSize - 1) / batchSize;
+            std::vector<GLuint> commands;
+            for (int b = 0; b < batches; b++) {
+                GLuint command[5] = { GLuint(indexCount), GLuint(std::min(batchSize, n - b * batchSize)),
+                    0, 0, GLuint(b * batchSize) };
+                commands.insert(commands.end(), command, command + 5);
+            }
+            GLuint indirectBuffer;
+            gl->glGenBuffers(1, &indirectBuffer);
+            gl->glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+            gl->glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(GLuint), commands.data(), GL_STATIC_DRAW);
+            Result& r = bench.measure("instancing", name("base instance indirect"),
+                    [&]() { multiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, batches, 0); });
+            addMetrics(r);
+            r.add("cost over instanced arrays", (r.seconds - attributeSeconds) * 1e3, "ms");
+            gl->glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+            gl->glDeleteBuffers(1, &indirectBuffer);
+        }
+        gl->glDisableVertexAttribArray(1);
+        gl->glVertexAttribDivisor(1, 0);
+
+        // Storage buffer indexed by gl_InstanceID
+        if (storageBufferPrg) {
+            gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, instanceBuffer);
+            gl->glUseProgram(storageBufferPrg);
+            Result& r = bench.measure("instancing", name("storage buffer"), drawInstanced);
+            addMetrics(r);
+            r.add("cost over instanced arrays", (r.seconds - attributeSeconds) * 1e3, "ms");
+            gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+        }
+
+        // Texture buffer indexed by gl_InstanceID
+        if (textureBufferPrg && n > maxTextureBufferSize) {
+            bench.skip(name("texture buffer") + QString(": GL_MAX_TEXTURE_BUFFER_SIZE is %1").arg(maxTextureBufferSize));
+        } else if (textureBufferPrg) {
+            GLuint tex;
+            gl->glGenTextures(1, &tex);
+            gl->glBindTexture(GL_TEXTURE_BUFFER, tex);
+            gl->glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, instanceBuffer);
+            gl->glUseProgram(textureBufferPrg);
+            gl->glUniform1i(gl->glGetUniformLocation(textureBufferPrg, "instances"), 0);
+            Result& r = bench.measure("instancing", name("texture buffer"), drawInstanced);
+            addMetrics(r);
+            r.add("cost over instanced arrays", (r.seconds - attributeSeconds) * 1e3, "ms");
+            gl->glBindTexture(GL_TEXTURE_BUFFER, 0);
+            gl->glDeleteTextures(1, &tex);
+        }
+
+        gl->glDeleteBuffers(1, &instanceBuffer);
+    }
+
+    gl->glDisableVertexAttribArray(0);
+    gl->glBindBuffer(GL_ARRAY_BUFFER, 0);
+    gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    gl->glDeleteBuffers(2, meshBuffers);
+    gl->glDeleteFramebuffers(1, &fbo);
+    gl->glDeleteTextures(1, &colorTex);
+    gl->glDeleteProgram(textureBufferPrg);
+    gl->glDeleteProgram(storageBufferPrg);
+    gl->glDeleteProgram(attributePrg);
+}
@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <vector>
+
+#include "benchmark.hpp"
+
+/* Layered rendering, e.g. of environment probes: the same scene is drawn into
+ * each face of a cube map or each layer of a 2D array texture, with one pass
+ * per layer, with a geometry shader that loops over the layers, with an
+ * instanced geometry shader (one invocation per layer), or with gl_Layer set
+ * in the vertex shader (ARB_shader_viewport_layer_array or
+ * AMD_vertex_shader_layer), one instance per layer and object. Each layer
+ * sees the scene from a different angle. */
+
+static const char passVS[] =
+    "layout(location = 0) in vec2 pos;\n"
+    "uniform int layer;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position = transform(pos, layer, gl_InstanceID);\n"
+    "}\n";
+
+static const char loopGS[] =
+    "layout(triangles) in;\n"
+    "layout(triangle_strip, max_vertices = %VERTICES%) out;\n"
+    "in vec2 vpos[];\n"
+    "flat in int vobject[];\n"
+    "void main()\n"
+    "{\n"
+    "    for (int layer = 0; layer < %LAYERS%; layer++) {\n"
+    "        for (int i = 0; i < 3; i++) {\n"
+    "            gl_Layer = layer;\n"
+    "            gl_Position = transform(vpos[i], layer, vobject[i]);\n"
+    "            EmitVertex();\n"
+    "        }\n"
+    "        EndPrimitive();\n"
+    "    }\n"
+    "}\n";
+
+static const char instancedGS[] =
+    "layout(triangles, invocations = %LAYERS%) in;\n"
+    "layout(triangle_strip, max_vertices = 3) out;\n"
+    "in vec2 vpos[];\n"
+    "flat in int vobject[];\n"
+    "void main()\n"
+    "{\n"
+    "    for (int i = 0; i < 3; i++) {\n"
+    "        gl_Layer = gl_InvocationID;\n"
+    "        gl_Position = transform(vpos[i], gl_InvocationID, vobject[i]);\n"
+    "        EmitVertex();\n"
+    "    }\n"
+    "    EndPrimitive();\n"
+    "}\n";
+
+static const char layerVS[] =
+    "layout(location = 0) in vec2 pos;\n"
+    "void main()\n"
+    "{\n"
+    "    int layer = gl_InstanceID % %LAYERS%;\n"
+    "    gl_Layer = layer;\n"
+    "    gl_Position = transform(pos, layer, gl_InstanceID / %LAYERS%);\n"
+    "}\n";
+
+static const char layeredFS[] =
+    "layout(location = 0) out vec4 fcolor;\n"
+    "void main()\n"
+    "{\n"
+    "    fcolor = vec4(gl_FragCoord.xy / 1024.0, gl_FragCoord.z, 1.0);\n"
+    "}\n";
+
+static QByteArray layeredSource(const char* source, int layers, const QByteArray& prefix = QByteArray())
+{
+    return prefix + "const float viewAngle = 0.5;\n" + QByteArray(transformFunction) + QByteArray(source)
+        .replace("%VERTICES%", QByteArray::number(3 * layers))
+        .replace("%LAYERS%", QByteArray::number(layers));
+}
+
+void benchmarkLayered(Bench& bench)
+{
+    QOpenGLExtraFunctions* gl = bench.gl;
+    const int objects = 4;
+    const int gridSize = 32;
+    const int sizes[] = { 256, 512, 1024 };
+    const struct { const char* name; GLenum target; int layers; } targets[] = {
+        { "cube map", GL_TEXTURE_CUBE_MAP, 6 },
+        { "2D array of 24 layers", GL_TEXTURE_2D_ARRAY, 24 }
+    };
+
+    bool haveGS = bench.atLeast(42, 32);
+    if (!haveGS)
+        bench.skip("geometry shaders: require OpenGL ES 3.2");
+    QByteArray vsLayerExtension;
+    if (bench.hasExtension("GL_ARB_shader_viewport_layer_array"))
+        vsLayerExtension = "#extension GL_ARB_shader_viewport_layer_array : require\n";
+    else if (bench.hasExtension("GL_AMD_vertex_shader_layer"))
+        vsLayerExtension = "#extension GL_AMD_vertex_shader_layer : require\n";
+    else
+        bench.skip("gl_Layer in vertex shaders: requires GL_ARB_shader_viewport_layer_array or GL_AMD_vertex_shader_layer");
+
+    GLuint buffers[2];
+    GLsizei indexCount = bench.gridMesh(gridSize, buffers);
+    const double triangles = 2.0 * gridSize * gridSize * objects;
+    gl->glEnable(GL_DEPTH_TEST);
+
+    for (const auto& t : targets) {
+        GLuint passPrg = bench.program(layeredSource(passVS, t.layers), layeredFS);
+        GLuint loopPrg = haveGS ? bench.program(passThroughVS, layeredFS, layeredSource(loopGS, t.layers)) : 0;
+        GLuint instancedPrg = haveGS ? bench.program(passThroughVS, layeredFS, layeredSource(instancedGS, t.layers)) : 0;
+        GLuint vsLayerPrg = vsLayerExtension.isEmpty() ? 0
+            : bench.program(layeredSource(layerVS, t.layers, vsLayerExtension), layeredFS);
+        if (!passPrg) {
+            gl->glDeleteProgram(vsLayerPrg);
+            gl->glDeleteProgram(instancedPrg);
+            gl->glDeleteProgram(loopPrg);
+            bench.skip(QString("%1: cannot build shader program").arg(t.name));
+            continue;
+        }
+        GLint layerLoc = gl->glGetUniformLocation(passPrg, "layer");
+        for (int size : sizes) {
+            GLuint tex[2];
+            gl->glGenTextures(2, tex);
+            for (int i = 0; i < 2; i++) {
+                GLenum format = (i == 0 ? GL_RGBA8 : GL_DEPTH_COMPONENT24);
+                gl->glBindTexture(t.target, tex[i]);
+                if (t.target == GL_TEXTURE_CUBE_MAP)
+                    gl->glTexStorage2D(t.target, 1, format, size, size);
+                else
+                    gl->glTexStorage3D(t.target, 1, format, size, size, t.layers);
+            }
+            gl->glViewport(0, 0, size, size);
+            GLenum drawBuffer = GL_COLOR_ATTACHMENT0;
+
+            // One framebuffer per layer
+            std::vector<GLuint> passFbos(t.layers);
+            gl->glGenFramebuffers(t.layers, passFbos.data());
+            for (int l = 0; l < t.layers; l++) {
+                gl->glBindFramebuffer(GL_FRAMEBUFFER, passFbos[l]);
+                if (t.target == GL_TEXTURE_CUBE_MAP) {
+                    gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + l, tex[0], 0);
+                    gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + l, tex[1], 0);
+                } else {
+                    gl->glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, tex[0], 0, l);
+                    gl->glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, tex[1], 0, l);
+                }
+                gl->glDrawBuffers(1, &drawBuffer);
+            }
+            gl->glUseProgram(passPrg);
+            auto name = [&](const char* method) { return QString("%1 %2 %3x%3").arg(t.name, method).arg(size); };
+            Result& r0 = bench.measure("layered", name("separate passes"),
+                    [&]() {
+                        for (int l = 0; l < t.layers; l++) {
+                            gl->glBindFramebuffer(GL_FRAMEBUFFER, passFbos[l]);
+                            gl->glUniform1i(layerLoc, l);
+                            gl->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                            gl->glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr, objects);
+                        }
+                    });
+            r0.addRate("triangles", t.layers * triangles / 1e6, "MTriangles/s");
+            double passesSeconds = r0.seconds;
+            gl->glDeleteFramebuffers(t.layers, passFbos.data());
+
+            // One layered framebuffer
+            GLuint fbo = 0;
+            if (haveGS) {
+                gl->glGenFramebuffers(1, &fbo);
+                gl->glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+                gl->glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, tex[0], 0);
+                gl->glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, tex[1], 0);
+                gl->glDrawBuffers(1, &drawBuffer);
+                if (gl->glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                    fprintf(stderr, "framebuffer object is incomplete\n");
+            }
+            const struct { GLuint prg; const char* name; int instances; } layeredCases[] = {
+                { loopPrg, "geometry shader loop", objects },
+                { instancedPrg, "geometry shader instancing", objects },
+                { vsLayerPrg, "vertex shader gl_Layer", objects * t.layers }
+            };
+            for (const auto& c : layeredCases) {
+                if (!fbo || !c.prg)
+                    continue;
+                gl->glUseProgram(c.prg);
+                Result& r = bench.measure("layered", name(c.name),
+                        [&]() {
+                            gl->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                            gl->glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr, c.instances);
+                        });
+                r.addRate("triangles", t.layers * triangles / 1e6, "MTriangles/s");
+                r.add("cost over separate passes", (r.seconds - passesSeconds) * 1e3, "ms");
+            }
+            gl->glDeleteFramebuffers(1, &fbo);
+            gl->glDeleteTextures(2, tex);
+        }
+        gl->glDeleteProgram(vsLayerPrg);
+        gl->glDeleteProgram(instancedPrg);
+        gl->glDeleteProgram(loopPrg);
+        gl->glDeleteProgram(passPrg);
+    }
+
+    gl->glDisable(GL_DEPTH_TEST);
+    gl->glDisableVertexAttribArray(0);
+    gl->glBindBuffer(GL_ARRAY_BUFFER, 0);
+    gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    gl->glDeleteBuffers(2, buffers);
+}
@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include "benchmark.hpp"
+
+/* Mipmap generation for dynamic textures: glGenerateMipmap, a chain of
+ * fragment shader passes, and a compute shader that generates all levels in
+ * a single dispatch. */
+
+static const char downsampleFS[] =
+    "uniform highp sampler2D src;\n"
+    "uniform vec2 texelSize;\n"
+    "layout(location = 0) out vec4 fcolor;\n"
+    "void main()\n"
+    "{\n"
+    "    // The center of a destination pixel lies between four source texels,\n"
+    "    // so that linear filtering averages them\n"
+    "    fcolor = textureLod(src, gl_FragCoord.xy * texelSize, 0.0);\n"
+    "}\n";
+
+/* GLSL for one stage of the single-pass downsampler: a work group of 16x16
+ * invocations reduces a 64x64 tile of its input, provided by the given fetch
+ * function, to one texel, writing up to 6 levels starting at mip<first>. The
+ * result of the last level is left in v of invocation (0,0). */
+static QByteArray reduceTile(const QByteArray& fetch, int first, int levels, const QByteArray& condition)
+{
+    auto mip = [=](int k) { return "mip" + QByteArray::number(first + k - 1); };
+    QByteArray s =
+        "    sum = vec4(0.0);\n"
+        "    for (int j = 0; j < 2; j++) {\n"
+        "        for (int i = 0; i < 2; i++) {\n"
+        "            ivec2 o = base + 2 * t + ivec2(i, j);\n"
+        "            vec4 w = 0.25 * (" + fetch + "(2 * o) + " + fetch + "(2 * o + ivec2(1, 0))\n"
+        "                    + " + fetch + "(2 * o + ivec2(0, 1)) + " + fetch + "(2 * o + ivec2(1, 1)));\n"
+        "            if (" + condition + ") STORE(" + mip(1) + ", o, w);\n"
+        "            sum += w;\n"
+        "        }\n"
+        "    }\n"
+        "    v = 0.25 * sum;\n";
+    if (levels >= 2)
+        s += "    if (" + condition + ") STORE(" + mip(2) + ", (base >> 1) + t, v);\n"
+            "    s[t.y * 16 + t.x] = v;\n";
+    for (int k = 3; k <= levels; k++) {
+        QByteArray n = QByteArray::number(32 >> (k - 1));
+        s += "    barrier();\n"
+            "    if (all(lessThan(t, ivec2(" + n + ")))) {\n"
+            "        ivec2 q = 2 * t;\n"
+            "        v = 0.25 * (s[q.y * 16 + q.x] + s[q.y * 16 + q.x + 1] + s[(q.y + 1) * 16 + q.x] + s[(q.y + 1) * 16 + q.x + 1]);\n"
+            "        if (" + condition + ") STORE(" + mip(k) + ", (base >> " + QByteArray::number(k - 1) + ") + t, v);\n"
+            "    }\n"
+            "    barrier();\n"
+            "    if (all(lessThan(t, ivec2(" + n + "))))\n"
+            "        s[t.y * 16 + t.x] = v;\n";
+    }
+    return s;
+}
+
+/* The single-pass downsampler for a texture with the given number of levels
+ * (at least 7, i.e. 64x64): each work group reduces one 64x64 tile of level 0
+ * to levels 1-6 and stores its level 6 texel in a buffer. The last work group
+ * to finish then reduces these texels to the remaining levels. Since barrier()
+ * must not be used in control flow, all work groups execute the second stage,
+ * but only the last one fetches and stores data. */
+static QByteArray singlePassCS(const char* format, int levels)
+{
+    QByteArray s =
+        "#define STORE(img, p, v) if (all(lessThan(p, imageSize(img)))) imageStore(img, p, v)\n"
+        "layout(local_size_x = 16, local_size_y = 16) in;\n"
+        "uniform highp sampler2D src;\n";
+    for (int l = 1; l < levels; l++)
+        s += "layout(" + QByteArray(format) + ", binding = " + QByteArray::number(l - 1) + ") "
+            "writeonly uniform highp image2D mip" + QByteArray::number(l) + ";\n";
+    s += "layout(std430, binding = 0) coherent buffer Tiles { uint counter; vec4 tiles[]; };\n"
+        "shared vec4 s[256];\n"
+        "shared bool last;\n"
+        "vec4 fetchTexture(ivec2 p)\n"
+        "{\n"
+        "    return texelFetch(src, p, 0);\n"
+        "}\n"
+        "vec4 fetchTiles(ivec2 p)\n"
+        "{\n"
+        "    ivec2 n = ivec2(gl_NumWorkGroups.xy);\n"
+        "    return (last && all(lessThan(p, n))) ? tiles[p.y * n.x + p.x] : vec4(0.0);\n"
+        "}\n"
+        "void main()\n"
+        "{\n"
+        "    ivec2 t = ivec2(gl_LocalInvocationID.xy);\n"
+        "    ivec2 base = ivec2(gl_WorkGroupID.xy) * 32;\n"
+        "    vec4 sum, v;\n";
+    s += reduceTile("fetchTexture", 1, 6, "true");
+    s += "    if (all(equal(t, ivec2(0)))) {\n"
+        "        tiles[gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x] = v;\n"
+        "        memoryBarrierBuffer();\n"
+        "        last = (atomicAdd(counter, 1u) == gl_NumWorkGroups.x * gl_NumWorkGroups.y - 1u);\n"
+        "    }\n"
+        "    barrier();\n"
+        "    base = ivec2(0);\n";
+    s += reduceTile("fetchTiles", 7, levels - 7, "last");
+    s += "    if (last && all(equal(t, ivec2(0))))\n"
+        "        counter = 0u;\n"
+        "}\n";
+    return s;
+}
+
+void benchmarkMipmap(Bench& bench)
+{
+    QOpenGLExtraFunctions* gl = bench.gl;
+    const struct { GLenum format; int bytes; const char* name; const char* imageFormat; } formats[] = {
+        { GL_RGBA8, 4, "RGBA8", "rgba8" },
+        { GL_RGBA16F, 8, "RGBA16F", "rgba16f" },
+        { GL_RGBA32F, 16, "RGBA32F", "rgba32f" }
+    };
+    const int sizes[] = { 1024, 2048, 4096 };
+
+    GLuint fragmentPrg = bench.program(fullScreenTriangleVS, downsampleFS);
+    if (!fragmentPrg) {
+        bench.skip("cannot build shader program");
+        return;
+    }
+    gl->glUseProgram(fragmentPrg);
+    gl->glUniform1i(gl->glGetUniformLocation(fragmentPrg, "src"), 0);
+    GLint texelSizeLoc = gl->glGetUniformLocation(fragmentPrg, "texelSize");
+
+    GLint maxImages = 0;
+    bool compute = bench.atLeast(43, 31);
+    if (compute) {
+        GLint maxImageUnits;
+        gl->glGetIntegerv(GL_MAX_COMPUTE_IMAGE_UNIFORMS, &maxImages);
+        gl->glGetIntegerv(GL_MAX_IMAGE_UNITS, &maxImageUnits);
+        maxImages = std::min(maxImages, maxImageUnits);
+    } else {
+        bench.skip("compute single pass: requires OpenGL 4.3 or OpenGL ES 3.1");
+    }
+
+    bool haveHalfFloat = !bench.isGLES() || bench.hasExtension("GL_EXT_color_buffer_half_float")
+        || bench.hasExtension("GL_EXT_color_buffer_float");
+    bool haveFloat = !bench.isGLES()
+        || (bench.hasExtension("GL_EXT_color_buffer_float") && bench.hasExtension("GL_OES_texture_float_linear"));
+    if (!haveHalfFloat)
+        bench.skip("RGBA16F: requires rendering to RGBA16F");
+    if (!haveFloat)
+        bench.skip("RGBA32F: requires GL_EXT_color_buffer_float and GL_OES_texture_float_linear");
+
+    gl->glActiveTexture(GL_TEXTURE0);
+    for (const auto& f : formats) {
+        if ((f.format == GL_RGBA16F && !haveHalfFloat) || (f.format == GL_RGBA32F && !haveFloat))
+            continue;
+        for (int size : sizes) {
+            QString suffix = QString("%1 %2x%2").arg(f.name).arg(size);
+            int levels = 1;
+            while ((size >> levels) > 0)
+                levels++;
+            double bytes = 0.0; // read and written by one chain
+            for (int l = 1; l < levels; l++)
+                bytes += 5.0 * (size >> l) * (size >> l) * f.bytes;
+            GLuint tex = bench.texture(f.format, size, size, levels);
+
+            Result& r0 = bench.measure("mipmap", "glGenerateMipmap " + suffix,
+                    [&]() { gl->glGenerateMipmap(GL_TEXTURE_2D); });
+            r0.addRate("bandwidth (read + write)", bytes / 1e9, "GB/s");
+
+            // Fragment chain: render each level from the previous one, which is
+            // the only level accessible for sampling to avoid a feedback loop
+            std::vector<GLuint> fbos(levels - 1);
+            gl->glGenFramebuffers(levels - 1, fbos.data());
+            for (int l = 1; l < levels; l++) {
+                gl->glBindFramebuffer(GL_FRAMEBUFFER, fbos[l - 1]);
+                gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex, l);
+            }
+            gl->glUseProgram(fragmentPrg);
+            Result& r1 = bench.measure("mipmap", "fragment chain " + suffix, [&]() {
+                    for (int l = 1; l < levels; l++) {
+                        int s = size >> l;
+                        gl->glBindFramebuffer(GL_FRAMEBUFFER, fbos[l - 1]);
+                        gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, l - 1);
+                        gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, l - 1);
+                        gl->glViewport(0, 0, s, s);
+                        gl->glUniform2f(texelSizeLoc, 1.0f / s, 1.0f / s);
+                        gl->glDrawArrays(GL_TRIANGLES, 0, 3);
+                    }
+                });
+            r1.addRate("bandwidth (read + write)", bytes / 1e9, "GB/s");
+            gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+            gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+            gl->glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            gl->glDeleteFramebuffers(levels - 1, fbos.data());
+
+            // Compute single pass
+            if (compute && maxImages < levels - 1) {
+                bench.skip(QString("compute single pass %1: requires %2 image units").arg(suffix).arg(levels - 1));
+            } else if (compute) {
+                GLuint computePrg = bench.computeProgram(singlePassCS(f.imageFormat, levels));
+                if (!computePrg) {
+                    bench.skip("compute single pass: cannot build shader program");
+                    compute = false;
+                } else {
+                    int tiles = size / 64;
+                    std::vector<float> zero(4 + 4 * tiles * tiles, 0.0f);
+                    GLuint buf;
+                    gl->glGenBuffers(1, &buf);
+                    gl->glBindBuffer(GL_SHADER_STORAGE_BUFFER, buf);
+                    gl->glBufferData(GL_SHADER_STORAGE_BUFFER, zero.size() * sizeof(float), zero.data(), GL_DYNAMIC_COPY);
+                    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buf);
+                    for (int l = 1; l < levels; l++)
+                        gl->glBindImageTexture(l - 1, tex, l, GL_FALSE, 0, GL_WRITE_ONLY, f.format);
+                    gl->glUseProgram(computePrg);
+                    gl->glUniform1i(gl->glGetUniformLocation(computePrg, "src"), 0);
+                    Result& r2 = bench.measure("mipmap", "compute single pass " + suffix, [&]() {
+                            gl->glDispatchCompute(tiles, tiles, 1);
+                            gl->glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT
+                                    | GL_TEXTURE_FETCH_BARRIER_BIT);
+                        });
+                    r2.addRate("bandwidth (read + write)", bytes / 1e9, "GB/s");
+                    for (int l = 1; l < levels; l++)
+                        gl->glBindImageTexture(l - 1, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, f.format);
+                    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+                    gl->glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+                    gl->glDeleteBuffers(1, &buf);
+                    gl->glDeleteProgram(computePrg);
+                }
+            }
+            gl->glDeleteTextures(1, &tex);
+        }
+    }
+    gl->glDeleteProgram(fragmentPrg);
+}
@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <vector>
+
+#include "benchmark.hpp"
+
+/* Rendering the same scene for N views of 1024x1024 each, as for stereo or
+ * multiple cameras: with one pass per view into the layers of a 2D array
+ * texture, with viewport arrays (gl_ViewportIndex set by an instanced
+ * geometry shader or, with ARB_shader_viewport_layer_array or
+ * AMD_vertex_shader_viewport_index, by the vertex shader) into a grid of
+ * viewports in one 2D texture, and with OVR_multiview into the layers of a
+ * 2D array texture. Each view sees the scene from a different angle. */
+
+#ifndef GL_MAX_VIEWPORTS
+#define GL_MAX_VIEWPORTS 0x825B
+#endif
+#ifndef GL_MAX_VIEWS_OVR
+#define GL_MAX_VIEWS_OVR 0x9631
+#endif
+
+typedef void (QOPENGLF_APIENTRYP ViewportArrayv)(GLuint first, GLsizei count, const GLfloat* v);
+typedef void (QOPENGLF_APIENTRYP FramebufferTextureMultiviewOVR)(GLenum target, GLenum attachment,
+        GLuint texture, GLint level, GLint baseViewIndex, GLsizei numViews);
+
+static const char passVS[] =
+    "layout(location = 0) in vec2 pos;\n"
+    "uniform int view;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position = transform(pos, view, gl_InstanceID);\n"
+    "}\n";
+
+static const char viewportGS[] =
+    "layout(triangles, invocations = %VIEWS%) in;\n"
+    "layout(triangle_strip, max_vertices = 3) out;\n"
+    "in vec2 vpos[];\n"
+    "flat in int vobject[];\n"
+    "void main()\n"
+    "{\n"
+    "    for (int i = 0; i < 3; i++) {\n"
+    "        gl_ViewportIndex = gl_InvocationID;\n"
+    "        gl_Position = transform(vpos[i], gl_InvocationID, vobject[i]);\n"
+    "        EmitVertex();\n"
+    "    }\n"
+    "    EndPrimitive();\n"
+    "}\n";
+
+static const char viewportVS[] =
+    "layout(location = 0) in vec2 pos;\n"
+    "void main()\n"
+    "{\n"
+    "    int view = gl_InstanceID % %VIEWS%;\n"
+    "    gl_ViewportIndex = view;\n"
+    "    gl_Position = transform(pos, view, gl_InstanceID / %VIEWS%);\n"
+    "}\n";
+
+static const char multiviewVS[] =
+    "layout(num_views = %VIEWS%) in;\n"
+    "layout(location = 0) in vec2 pos;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position = transform(pos, int(gl_ViewID_OVR), gl_InstanceID);\n"
+    "}\n";
+
+static const char viewFS[] =
+    "layout(location = 0) out vec4 fcolor;\n"
+    "void main()\n"
+    "{\n"
+    "    fcolor = vec4(gl_FragCoord.xy / 1024.0, gl_FragCoord.z, 1.0);\n"
+    "}\n";
+
+static QByteArray viewSource(const char* source, int views, const QByteArray& extension = QByteArray())
+{
+    return extension + "const float viewAngle = 0.1;\n" + QByteArray(transformFunction)
+        + QByteArray(source).replace("%VIEWS%", QByteArray::number(views));
+}
+
+static GLuint viewTexture(QOpenGLExtraFunctions* gl, GLenum target, GLenum format, int width, int height, int layers)
+{
+    GLuint tex;
+    gl->glGenTextures(1, &tex);
+    gl->glBindTexture(target, tex);
+    if (target == GL_TEXTURE_2D_ARRAY)
+        gl->glTexStorage3D(target, 1, format, width, height, layers);
+    else
+        gl->glTexStorage2D(target, 1, format, width, height);
+    return tex;
+}
+
+void benchmarkMultiview(Bench& bench)
+{
+    QOpenGLExtraFunctions* gl = bench.gl;
+    const int viewSize = 1024;
+    const int objects = 4;
+    const int gridSize = 64;
+    const double triangles = 2.0 * gridSize * gridSize * objects;
+
+    // Viewport arrays: OpenGL 4.1 (with geometry shaders), or OES_viewport_array
+    // with OpenGL ES 3.2
+    GLint maxViewports = 0;
+    ViewportArrayv viewportArrayv = nullptr;
+    QByteArray viewportExtension;
+    if (!bench.isGLES()) {
+        viewportArrayv = bench.getProc<ViewportArrayv>("glViewportArrayv");
+    } else if (bench.atLeast(0, 32) && bench.hasExtension("GL_OES_viewport_array")) {
+        viewportArrayv = bench.getProc<ViewportArrayv>("glViewportArrayvOES");
+        viewportExtension = "#extension GL_OES_viewport_array : require\n";
+    } else {
+        bench.skip("viewport arrays: require OpenGL ES 3.2 and GL_OES_viewport_array");
+    }
+    if (viewportArrayv)
+        gl->glGetIntegerv(GL_MAX_VIEWPORTS, &maxViewports);
+    QByteArray vsViewportExtension;
+    if (viewportArrayv) {
+        if (bench.hasExtension("GL_ARB_shader_viewport_layer_array"))
+            vsViewportExtension = "#extension GL_ARB_shader_viewport_layer_array : require\n";
+        else if (bench.hasExtension("GL_AMD_vertex_shader_viewport_index"))
+            vsViewportExtension = "#extension GL_AMD_vertex_shader_viewport_index : require\n";
+        else
+            bench.skip("gl_ViewportIndex in vertex shaders: requires GL_ARB_shader_viewport_layer_array or GL_AMD_vertex_shader_viewport_index");
+    }
+
+    GLint maxViews = 0;
+    FramebufferTextureMultiviewOVR framebufferTextureMultiview = nullptr;
+    if (bench.hasExtension("GL_OVR_multiview")) {
+        framebufferTextureMultiview = bench.getProc<FramebufferTextureMultiviewOVR>("glFramebufferTextureMultiviewOVR");
+        gl->glGetIntegerv(GL_MAX_VIEWS_OVR, &maxViews);
+    } else {
+        bench.skip("multiview: requires GL_OVR_multiview");
+    }
+
+    GLint maxTextureSize = 0;
+    gl->glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    GLuint buffers[2];
+    GLsizei indexCount = bench.gridMesh(gridSize, buffers);
+    gl->glEnable(GL_DEPTH_TEST);
+    GLenum drawBuffer = GL_COLOR_ATTACHMENT0;
+
+    for (int views : { 2, 4, 8 }) {
+        auto name = [&](const char* method) { return QString("%1, %2 views").arg(method).arg(views); };
+
+        // Separate passes into the layers of a 2D array texture
+        GLuint passPrg = bench.program(viewSource(passVS, views), viewFS);
+        if (!passPrg) {
+            bench.skip(name("separate passes") + ": cannot build shader program");
+            continue;
+        }
+        GLuint colorTex = viewTexture(gl, GL_TEXTURE_2D_ARRAY, GL_RGBA8, viewSize, viewSize, views);
+        GLuint depthTex = viewTexture(gl, GL_TEXTURE_2D_ARRAY, GL_DEPTH_COMPONENT24, viewSize, viewSize, views);
+        std::vector<GLuint> passFbos(views);
+        gl->glGenFramebuffers(views, passFbos.data());
+        for (int v = 0; v < views; v++) {
+            gl->glBindFramebuffer(GL_FRAMEBUFFER, passFbos[v]);
+            gl->glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, colorTex, 0, v);
+            gl->glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTex, 0, v);
+            gl->glDrawBuffers(1, &drawBuffer);
+        }
+        gl->glViewport(0, 0, viewSize, viewSize);
+        gl->glUseProgram(passPrg);
+        GLint viewLoc = gl->glGetUniformLocation(passPrg, "view");
+        Result& r0 = bench.measure("multiview", name("separate passes"),
+                [&]() {
+                    for (int v = 0; v < views; v++) {
+                        gl->glBindFramebuffer(GL_FRAMEBUFFER, passFbos[v]);
+                        gl->glUniform1i(viewLoc, v);
+                        gl->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                        gl->glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr, objects);
+                    }
+                });
+        r0.addRate("triangles", views * triangles / 1e6, "MTriangles/s");
+        double passesSeconds = r0.seconds;
+        gl->glDeleteFramebuffers(views, passFbos.data());
+        gl->glDeleteProgram(passPrg);
+
+        // Multiview into the same 2D array texture
+        if (framebufferTextureMultiview && views > maxViews) {
+            bench.skip(name("multiview") + QString(": GL_MAX_VIEWS_OVR is %1").arg(maxViews));
+        } else if (framebufferTextureMultiview) {
+            GLuint prg = bench.program(viewSource(multiviewVS, views, "#extension GL_OVR_multiview : require\n"), viewFS);
+            GLuint fbo;
+            gl->glGenFramebuffers(1, &fbo);
+            gl->glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+            framebufferTextureMultiview(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, colorTex, 0, 0, views);
+            framebufferTextureMultiview(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTex, 0, 0, views);
+            gl->glDrawBuffers(1, &drawBuffer);
+            if (!prg || gl->glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+                bench.skip(name("multiview") + ": cannot build shader program or framebuffer");
+            } else {
+                gl->glUseProgram(prg);
+                Result& r = bench.measure("multiview", name("multiview"),
+                        [&]() {
+                            gl->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                            gl->glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr, objects);
+                        });
+                r.addRate("triangles", views * triangles / 1e6, "MTriangles/s");
+                r.add("cost over separate passes", (r.seconds - passesSeconds) * 1e3, "ms");
+            }
+            gl->glDeleteFramebuffers(1, &fbo);
+            gl->glDeleteProgram(prg);
+        }
+        gl->glDeleteTextures(1, &depthTex);
+        gl->glDeleteTextures(1, &colorTex);
+
+        // Viewport arrays into a grid of viewports with two columns
+        int columns = 2;
+        int rows = views / columns;
+        if (viewportArrayv && (views > maxViewports || rows * viewSize > maxTextureSize)) {
+            bench.skip(name("viewport array") + QString(": GL_MAX_VIEWPORTS is %1, GL_MAX_TEXTURE_SIZE is %2")
+                    .arg(maxViewports).arg(maxTextureSize));
+        } else if (viewportArrayv) {
+            colorTex = viewTexture(gl, GL_TEXTURE_2D, GL_RGBA8, columns * viewSize, rows * viewSize, 1);
+            depthTex = viewTexture(gl, GL_TEXTURE_2D, GL_DEPTH_COMPONENT24, columns * viewSize, rows * viewSize, 1);
+            GLuint fbo = bench.framebuffer(colorTex, depthTex);
+            std::vector<GLfloat> viewports;
+            for (int v = 0; v < views; v++) {
+                GLfloat viewport[4] = { GLfloat(v % columns * viewSize), GLfloat(v / columns * viewSize),
+                    GLfloat(viewSize), GLfloat(viewSize) };
+                viewports.insert(viewports.end(), viewport, viewport + 4);
+            }
+            viewportArrayv(0, views, viewports.data());
+            const struct { const char* name; GLuint prg; int instances; } cases[] = {
+                { "viewport array geometry shader",
+                    bench.program(passThroughVS, viewFS, viewSource(viewportGS, views, viewportExtension)), objects },
+                { "viewport array vertex shader", vsViewportExtension.isEmpty() ? 0
+                    : bench.program(viewSource(viewportVS, views, vsViewportExtension), viewFS), objects * views }
+            };
+            for (const auto& c : cases) {
+                if (!c.prg)
+                    continue;
+                gl->glUseProgram(c.prg);
+                Result& r = bench.measure("multiview", name(c.name),
+                        [&]() {
+                            gl->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                            gl->glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr, c.instances);
+                        });
+                r.addRate("triangles", views * triangles / 1e6, "MTriangles/s");
+                r.add("cost over separate passes", (r.seconds - passesSeconds) * 1e3, "ms");
+                gl->glDeleteProgram(c.prg);
+            }
+            // glViewport resets all viewports
+            gl->glViewport(0, 0, viewSize, viewSize);
+            gl->glDeleteFramebuffers(1, &fbo);
+            gl->glDeleteTextures(1, &depthTex);
+            gl->glDeleteTextures(1, &colorTex);
+        }
+    }
+
+    gl->glDisable(GL_DEPTH_TEST);
+    gl->glDisableVertexAttribArray(0);
+    gl->glBindBuffer(GL_ARRAY_BUFFER, 0);
+    gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    gl->glDeleteBuffers(2, buffers);
+}
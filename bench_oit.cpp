@@ -0,0 +1,359 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "benchmark.hpp"
+
+/* Order-independent transparency: a number of overlapping full-screen layers
+ * in shuffled depth order (the depth complexity), resolved with weighted
+ * blended OIT, with per-pixel linked lists (an atomic counter, a head pointer
+ * buffer, and a node buffer with room for all fragments), and with depth
+ * peeling (one pass per layer, so that the result is exact). Each technique
+ * produces the final image in an RGBA8 texture. The reported memory is that
+ * of the buffers the technique needs in addition to that texture. */
+
+static const char layersVS[] =
+    "uniform int layers;\n"
+    "out vec4 vcolor;\n"
+    "void main()\n"
+    "{\n"
+    "    vec2 p = vec2(float((gl_VertexID & 1) << 2) - 1.0, float((gl_VertexID & 2) << 1) - 1.0);\n"
+    "    int k = (gl_InstanceID * 7) % layers;\n"
+    "    float z = (float(k) + 0.5) / float(layers) * 1.6 - 0.8;\n"
+    "    vcolor = vec4(0.5 + 0.5 * cos(float(k) + vec3(0.0, 2.0, 4.0)), 0.3);\n"
+    "    gl_Position = vec4(p, z, 1.0);\n"
+    "}\n";
+
+static const char layerColorFunction[] =
+    "in vec4 vcolor;\n"
+    "vec4 layerColor()\n"
+    "{\n"
+    "    return vec4(vcolor.rgb * (0.75 + 0.25 * sin(gl_FragCoord.x * 0.05)), vcolor.a);\n"
+    "}\n";
+
+static const char weightedFS[] =
+    "layout(location = 0) out vec4 accum;\n"
+    "layout(location = 1) out vec4 revealage;\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 c = layerColor();\n"
+    "    float w = clamp(c.a * max(1e-2, 3e3 * pow(1.0 - gl_FragCoord.z, 3.0)), 1e-2, 3e3);\n"
+    "    accum = vec4(c.rgb * c.a, c.a) * w;\n"
+    "    revealage = vec4(c.a);\n"
+    "}\n";
+
+static const char weightedResolveFS[] =
+    "uniform highp sampler2D accumTex;\n"
+    "uniform highp sampler2D revealageTex;\n"
+    "layout(location = 0) out vec4 fcolor;\n"
+    "void main()\n"
+    "{\n"
+    "    ivec2 p = ivec2(gl_FragCoord.xy);\n"
+    "    vec4 a = texelFetch(accumTex, p, 0);\n"
+    "    float r = texelFetch(revealageTex, p, 0).r;\n"
+    "    fcolor = vec4(a.rgb / max(a.a, 1e-5) * (1.0 - r), 1.0);\n"
+    "}\n";
+
+static const char listBuffers[] =
+    "struct Node { uint color; float depth; uint next; };\n"
+    "layout(std430, binding = 0) buffer Heads { uint heads[]; };\n"
+    "layout(std430, binding = 1) buffer Nodes { Node nodes[]; };\n"
+    "uniform int width;\n";
+
+static const char listClearFS[] =
+    "void main()\n"
+    "{\n"
+    "    heads[int(gl_FragCoord.y) * width + int(gl_FragCoord.x)] = 0xffffffffu;\n"
+    "}\n";
+
+static const char listBuildFS[] =
+    "layout(binding = 0, offset = 0) uniform atomic_uint nodeCounter;\n"
+    "uniform uint capacity;\n"
+    "void main()\n"
+    "{\n"
+    "    uint i = atomicCounterIncrement(nodeCounter);\n"
+    "    if (i < capacity) {\n"
+    "        uint next = atomicExchange(heads[int(gl_FragCoord.y) * width + int(gl_FragCoord.x)], i);\n"
+    "        nodes[i] = Node(packUnorm4x8(layerColor()), gl_FragCoord.z, next);\n"
+    "    }\n"
+    "}\n";
+
+static const char listResolveFS[] =
+    "layout(location = 0) out vec4 fcolor;\n"
+    "const int maxFragments = 32;\n"
+    "void main()\n"
+    "{\n"
+    "    uint colors[maxFragments];\n"
+    "    float depths[maxFragments];\n"
+    "    int count = 0;\n"
+    "    uint i = heads[int(gl_FragCoord.y) * width + int(gl_FragCoord.x)];\n"
+    "    while (i != 0xffffffffu && count < maxFragments) {\n"
+    "        colors[count] = nodes[i].color;\n"
+    "        depths[count] = nodes[i].depth;\n"
+    "        count++;\n"
+    "        i = nodes[i].next;\n"
+    "    }\n"
+    "    // insertion sort from far to near\n"
+    "    for (int j = 1; j < count; j++) {\n"
+    "        uint c = colors[j];\n"
+    "        float d = depths[j];\n"
+    "        int k = j - 1;\n"
+    "        while (k >= 0 && depths[k] < d) {\n"
+    "            colors[k + 1] = colors[k];\n"
+    "            depths[k + 1] = depths[k];\n"
+    "            k--;\n"
+    "        }\n"
+    "        colors[k + 1] = c;\n"
+    "        depths[k + 1] = d;\n"
+    "    }\n"
+    "    vec3 result = vec3(0.0);\n"
+    "    for (int j = 0; j < count; j++) {\n"
+    "        vec4 c = unpackUnorm4x8(colors[j]);\n"
+    "        result = mix(result, c.rgb, c.a);\n"
+    "    }\n"
+    "    fcolor = vec4(result, 1.0);\n"
+    "}\n";
+
+static const char peelFS[] =
+    "uniform highp sampler2D prevDepth;\n"
+    "uniform bool firstPass;\n"
+    "layout(location = 0) out vec4 fcolor;\n"
+    "void main()\n"
+    "{\n"
+    "    if (!firstPass && gl_FragCoord.z <= texelFetch(prevDepth, ivec2(gl_FragCoord.xy), 0).r)\n"
+    "        discard;\n"
+    "    vec4 c = layerColor();\n"
+    "    fcolor = vec4(c.rgb * c.a, c.a);\n"
+    "}\n";
+
+static const char textureFS[] =
+    "uniform highp sampler2D tex;\n"
+    "layout(location = 0) out vec4 fcolor;\n"
+    "void main()\n"
+    "{\n"
+    "    fcolor = texelFetch(tex, ivec2(gl_FragCoord.xy), 0);\n"
+    "}\n";
+
+static GLuint nearestTexture(Bench& bench, GLenum format, int width, int height)
+{
+    GLuint tex = bench.texture(format, width, height);
+    bench.gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    bench.gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    return tex;
+}
+
+void benchmarkOIT(Bench& bench)
+{
+    QOpenGLExtraFunctions* gl = bench.gl;
+    const int sizes[][2] = { { 960, 540 }, { 1280, 720 }, { 1920, 1080 } };
+    const double MiB = 1024.0 * 1024.0;
+
+    bool haveWeighted = bench.atLeast(42, 32)
+        && (!bench.isGLES() || bench.hasExtension("GL_EXT_color_buffer_half_float")
+                || bench.hasExtension("GL_EXT_color_buffer_float"));
+    if (!haveWeighted)
+        bench.skip("weighted blended: requires OpenGL ES 3.2 and rendering to RGBA16F");
+    GLint fragmentBuffers = 0, fragmentCounters = 0, maxBlockSize = 0;
+    if (bench.atLeast(43, 31)) {
+        gl->glGetIntegerv(GL_MAX_FRAGMENT_SHADER_STORAGE_BLOCKS, &fragmentBuffers);
+        gl->glGetIntegerv(GL_MAX_FRAGMENT_ATOMIC_COUNTERS, &fragmentCounters);
+        gl->glGetIntegerv(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &maxBlockSize);
+    }
+    bool haveLists = fragmentBuffers >= 2 && fragmentCounters >= 1;
+    if (!haveLists)
+        bench.skip("linked lists: require storage buffers and atomic counters in fragment shaders");
+
+    QByteArray vs = layersVS;
+    QByteArray listHeader = QByteArray(listBuffers) + layerColorFunction;
+    GLuint weightedPrg = haveWeighted ? bench.program(vs, QByteArray(layerColorFunction) + weightedFS) : 0;
+    GLuint weightedResolvePrg = haveWeighted ? bench.program(fullScreenTriangleVS, weightedResolveFS) : 0;
+    GLuint listClearPrg = haveLists ? bench.program(fullScreenTriangleVS, QByteArray(listBuffers) + listClearFS) : 0;
+    GLuint listBuildPrg = haveLists ? bench.program(vs, listHeader + listBuildFS) : 0;
+    GLuint listResolvePrg = haveLists ? bench.program(fullScreenTriangleVS, QByteArray(listBuffers) + listResolveFS) : 0;
+    GLuint peelPrg = bench.program(vs, QByteArray(layerColorFunction) + peelFS);
+    GLuint texturePrg = bench.program(fullScreenTriangleVS, textureFS);
+    GLuint counterBuffer = 0;
+    if (haveLists)
+        gl->glGenBuffers(1, &counterBuffer);
+    const GLuint zero = 0;
+
+    for (const auto& s : sizes) {
+        int w = s[0], h = s[1];
+        GLuint resultTex = bench.texture(GL_RGBA8, w, h);
+        GLuint resultFbo = bench.framebuffer(resultTex);
+        gl->glViewport(0, 0, w, h);
+        for (int layers : { 4, 8, 16 }) {
+            auto name = [&](const char* technique) {
+                return QString("%1, %2 layers %3x%4").arg(technique).arg(layers).arg(w).arg(h);
+            };
+            auto addMetrics = [&](Result& r, double bytes) {
+                r.addRate("fragments", double(layers) * w * h / 1e9, "GFragment/s");
+                r.add("memory", bytes / MiB, "MiB");
+            };
+            for (GLuint prg : { weightedPrg, listBuildPrg, peelPrg }) {
+                if (prg) {
+                    gl->glUseProgram(prg);
+                    gl->glUniform1i(gl->glGetUniformLocation(prg, "layers"), layers);
+                }
+            }
+
+            if (weightedPrg && weightedResolvePrg) {
+                GLuint accumTex = nearestTexture(bench, GL_RGBA16F, w, h);
+                GLuint revealageTex = nearestTexture(bench, GL_R8, w, h);
+                GLuint fbo = bench.framebuffer(accumTex);
+                gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, revealageTex, 0);
+                GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+                gl->glDrawBuffers(2, drawBuffers);
+                gl->glUseProgram(weightedResolvePrg);
+                gl->glUniform1i(gl->glGetUniformLocation(weightedResolvePrg, "accumTex"), 0);
+                gl->glUniform1i(gl->glGetUniformLocation(weightedResolvePrg, "revealageTex"), 1);
+                gl->glActiveTexture(GL_TEXTURE1);
+                gl->glBindTexture(GL_TEXTURE_2D, revealageTex);
+                gl->glActiveTexture(GL_TEXTURE0);
+                gl->glBindTexture(GL_TEXTURE_2D, accumTex);
+                const GLfloat clearAccum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+                const GLfloat clearRevealage[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+                Result& r = bench.measure("oit", name("weighted blended"),
+                        [&]() {
+                            gl->glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+                            gl->glClearBufferfv(GL_COLOR, 0, clearAccum);
+                            gl->glClearBufferfv(GL_COLOR, 1, clearRevealage);
+                            gl->glEnable(GL_BLEND);
+                            gl->glBlendFunci(0, GL_ONE, GL_ONE);
+                            gl->glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+                            gl->glUseProgram(weightedPrg);
+                            gl->glDrawArraysInstanced(GL_TRIANGLES, 0, 3, layers);
+                            gl->glDisable(GL_BLEND);
+                            gl->glBindFramebuffer(GL_FRAMEBUFFER, resultFbo);
+                            gl->glUseProgram(weightedResolvePrg);
+                            gl->glDrawArrays(GL_TRIANGLES, 0, 3);
+                        });
+                addMetrics(r, double(w) * h * (8 + 1));
+                gl->glBlendFunc(GL_ONE, GL_ZERO);
+                gl->glDeleteFramebuffers(1, &fbo);
+                gl->glDeleteTextures(1, &revealageTex);
+                gl->glDeleteTextures(1, &accumTex);
+            }
+
+            GLuint capacity = GLuint(w) * h * layers;
+            const GLsizeiptr nodeSize = 12;
+            if (listBuildPrg && listClearPrg && listResolvePrg && capacity * nodeSize > GLuint(maxBlockSize)) {
+                bench.skip(name("linked lists") + QString(": node buffer exceeds GL_MAX_SHADER_STORAGE_BLOCK_SIZE (%1 MiB)")
+                        .arg(maxBlockSize / MiB));
+            } else if (listBuildPrg && listClearPrg && listResolvePrg) {
+                GLuint buffers[2];
+                gl->glGenBuffers(2, buffers);
+                gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffers[0]);
+                gl->glBufferData(GL_SHADER_STORAGE_BUFFER, GLsizeiptr(w) * h * 4, nullptr, GL_DYNAMIC_COPY);
+                gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, buffers[1]);
+                gl->glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * nodeSize, nullptr, GL_DYNAMIC_COPY);
+                gl->glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 0, counterBuffer);
+                gl->glBufferData(GL_ATOMIC_COUNTER_BUFFER, sizeof(GLuint), &zero, GL_DYNAMIC_DRAW);
+                for (GLuint prg : { listClearPrg, listBuildPrg, listResolvePrg }) {
+                    gl->glUseProgram(prg);
+                    gl->glUniform1i(gl->glGetUniformLocation(prg, "width"), w);
+                }
+                gl->glUseProgram(listBuildPrg);
+                gl->glUniform1ui(gl->glGetUniformLocation(listBuildPrg, "capacity"), capacity);
+                Result& r = bench.measure("oit", name("linked lists"),
+                        [&]() {
+                            gl->glBindFramebuffer(GL_FRAMEBUFFER, resultFbo);
+                            gl->glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+                            gl->glBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint), &zero);
+                            gl->glUseProgram(listClearPrg);
+                            gl->glDrawArrays(GL_TRIANGLES, 0, 3);
+                            gl->glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+                            gl->glUseProgram(listBuildPrg);
+                            gl->glDrawArraysInstanced(GL_TRIANGLES, 0, 3, layers);
+                            gl->glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT);
+                            gl->glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+                            gl->glUseProgram(listResolvePrg);
+                            gl->glDrawArrays(GL_TRIANGLES, 0, 3);
+                            gl->glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+                        });
+                addMetrics(r, double(w) * h * 4 + double(capacity) * nodeSize + sizeof(GLuint));
+                gl->glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 0, 0);
+                gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+                gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+                gl->glDeleteBuffers(2, buffers);
+            }
+
+            if (peelPrg && texturePrg) {
+                GLuint depthTex[2] = {
+                    nearestTexture(bench, GL_DEPTH_COMPONENT32F, w, h),
+                    nearestTexture(bench, GL_DEPTH_COMPONENT32F, w, h)
+                };
+                GLuint peelTex = nearestTexture(bench, GL_RGBA8, w, h);
+                GLuint peelFbos[2] = {
+                    bench.framebuffer(peelTex, depthTex[0]),
+                    bench.framebuffer(peelTex, depthTex[1])
+                };
+                gl->glUseProgram(peelPrg);
+                gl->glUniform1i(gl->glGetUniformLocation(peelPrg, "prevDepth"), 0);
+                GLint firstPassLoc = gl->glGetUniformLocation(peelPrg, "firstPass");
+                gl->glUseProgram(texturePrg);
+                gl->glUniform1i(gl->glGetUniformLocation(texturePrg, "tex"), 0);
+                Result& r = bench.measure("oit", name("depth peeling"),
+                        [&]() {
+                            gl->glBindFramebuffer(GL_FRAMEBUFFER, resultFbo);
+                            gl->glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+                            gl->glClear(GL_COLOR_BUFFER_BIT);
+                            for (int pass = 0; pass < layers; pass++) {
+                                // peel the nearest layer behind the previous one
+                                gl->glBindFramebuffer(GL_FRAMEBUFFER, peelFbos[pass % 2]);
+                                gl->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                                gl->glEnable(GL_DEPTH_TEST);
+                                gl->glUseProgram(peelPrg);
+                                gl->glUniform1i(firstPassLoc, pass == 0);
+                                gl->glBindTexture(GL_TEXTURE_2D, depthTex[(pass + 1) % 2]);
+                                gl->glDrawArraysInstanced(GL_TRIANGLES, 0, 3, layers);
+                                gl->glDisable(GL_DEPTH_TEST);
+                                // and blend it under the result
+                                gl->glBindFramebuffer(GL_FRAMEBUFFER, resultFbo);
+                                gl->glEnable(GL_BLEND);
+                                gl->glBlendFunc(GL_ONE_MINUS_DST_ALPHA, GL_ONE);
+                                gl->glUseProgram(texturePrg);
+                                gl->glBindTexture(GL_TEXTURE_2D, peelTex);
+                                gl->glDrawArrays(GL_TRIANGLES, 0, 3);
+                                gl->glDisable(GL_BLEND);
+                            }
+                        });
+                addMetrics(r, double(w) * h * (4 + 4 + 4));
+                gl->glBlendFunc(GL_ONE, GL_ZERO);
+                gl->glDeleteFramebuffers(2, peelFbos);
+                gl->glDeleteTextures(1, &peelTex);
+                gl->glDeleteTextures(2, depthTex);
+            }
+        }
+        gl->glDeleteFramebuffers(1, &resultFbo);
+        gl->glDeleteTextures(1, &resultTex);
+    }
+
+    gl->glDeleteBuffers(1, &counterBuffer);
+    gl->glDeleteProgram(texturePrg);
+    gl->glDeleteProgram(peelPrg);
+    gl->glDeleteProgram(listResolvePrg);
+    gl->glDeleteProgram(listBuildPrg);
+    gl->glDeleteProgram(listClearPrg);
+    gl->glDeleteProgram(weightedResolvePrg);
+    gl->glDeleteProgram(weightedPrg);
+}
@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "benchmark.hpp"
+
+/* Overdraw and the effectiveness of early depth tests: full-screen layers with
+ * a costly fragment shader, drawn front to back, back to front, and back to
+ * front after a depth prepass. The shader either is plain, writes
+ * gl_FragDepth, or may discard fragments, each of which can prevent early
+ * depth tests. After each measurement, one more frame is drawn with queries
+ * that count the fragment shader invocations (pipeline statistics) and the
+ * samples that pass the depth test (occlusion query), where available. */
+
+#ifndef GL_FRAGMENT_SHADER_INVOCATIONS
+#define GL_FRAGMENT_SHADER_INVOCATIONS 0x82F4
+#endif
+#ifndef GL_SAMPLES_PASSED
+#define GL_SAMPLES_PASSED 0x8914
+#endif
+
+typedef void (QOPENGLF_APIENTRYP GetQueryObjectui64v)(GLuint id, GLenum pname, GLuint64* params);
+
+static const char layerVS[] =
+    "uniform float zStart;\n"
+    "uniform float zStep;\n"
+    "void main()\n"
+    "{\n"
+    "    vec2 p = vec2(float((gl_VertexID & 1) << 2) - 1.0, float((gl_VertexID & 2) << 1) - 1.0);\n"
+    "    gl_Position = vec4(p, zStart + zStep * float(gl_InstanceID), 1.0);\n"
+    "}\n";
+
+enum { Plain, DepthWrite, Discard };
+
+static QByteArray overdrawFS(int variant, bool shade)
+{
+    QByteArray fs =
+        "uniform float discardBelow;\n"
+        "layout(location = 0) out vec4 fcolor;\n"
+        "vec4 shade()\n"
+        "{\n"
+        "    vec4 c = vec4(gl_FragCoord.xy / 1024.0, gl_FragCoord.z, 1.0);\n"
+        "    for (int i = 0; i < 32; i++)\n"
+        "        c = sin(c * 1.1 + vec4(0.3));\n"
+        "    return c;\n"
+        "}\n"
+        "void main()\n"
+        "{\n";
+    // discardBelow is negative, so nothing is actually discarded
+    if (variant == Discard)
+        fs += "    if (gl_FragCoord.x < discardBelow)\n"
+              "        discard;\n";
+    if (variant == DepthWrite)
+        fs += "    gl_FragDepth = gl_FragCoord.z;\n";
+    fs += shade ? "    fcolor = shade();\n" : "    fcolor = vec4(0.0);\n";
+    fs += "}\n";
+    return fs;
+}
+
+void benchmarkOverdraw(Bench& bench)
+{
+    QOpenGLExtraFunctions* gl = bench.gl;
+    const int width = 1920;
+    const int height = 1080;
+    const int layers = 8;
+    const double pixels = double(width) * height;
+    const char* variantNames[] = { "plain shader", "depth-writing shader", "discard shader" };
+    enum { FrontToBack, BackToFront, Prepass };
+    const char* orderNames[] = { "front to back", "back to front", "depth prepass, back to front" };
+
+    bool haveStatistics = !bench.isGLES()
+        && (bench.atLeast(46, 0) || bench.hasExtension("GL_ARB_pipeline_statistics_query"));
+    bool haveOcclusion = !bench.isGLES(); // OpenGL ES only has boolean occlusion queries
+    auto getQueryObjectui64v = bench.getProc<GetQueryObjectui64v>("glGetQueryObjectui64v");
+    if (!haveStatistics)
+        bench.skip("fragment shader invocation counts: require OpenGL 4.6 or GL_ARB_pipeline_statistics_query");
+    if (!haveOcclusion)
+        bench.skip("depth test sample counts: require OpenGL");
+    GLuint queries[2];
+    gl->glGenQueries(2, queries);
+
+    GLuint colorTex = bench.texture(GL_RGBA8, width, height);
+    GLuint depthTex = bench.texture(GL_DEPTH_COMPONENT24, width, height);
+    GLuint fbo = bench.framebuffer(colorTex, depthTex);
+    gl->glViewport(0, 0, width, height);
+    gl->glEnable(GL_DEPTH_TEST);
+
+    for (int v = Plain; v <= Discard; v++) {
+        GLuint prg = bench.program(layerVS, overdrawFS(v, true));
+        GLuint prepassPrg = bench.program(layerVS, overdrawFS(v, false));
+        if (!prg || !prepassPrg) {
+            bench.skip(QString("%1: cannot build shader programs").arg(variantNames[v]));
+            gl->glDeleteProgram(prg);
+            gl->glDeleteProgram(prepassPrg);
+            continue;
+        }
+        for (int o = FrontToBack; o <= Prepass; o++) {
+            for (GLuint p : { prg, prepassPrg }) {
+                gl->glUseProgram(p);
+                gl->glUniform1f(gl->glGetUniformLocation(p, "zStart"), o == FrontToBack ? -0.9f : 0.9f);
+                gl->glUniform1f(gl->glGetUniformLocation(p, "zStep"), o == FrontToBack ? 0.2f : -0.2f);
+                gl->glUniform1f(gl->glGetUniformLocation(p, "discardBelow"), -1.0f);
+            }
+            auto frame = [&]() {
+                gl->glClear(GL_DEPTH_BUFFER_BIT);
+                gl->glDepthFunc(GL_LESS);
+                if (o == Prepass) {
+                    gl->glUseProgram(prepassPrg);
+                    gl->glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+                    gl->glDrawArraysInstanced(GL_TRIANGLES, 0, 3, layers);
+                    gl->glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+                    gl->glDepthFunc(GL_LEQUAL);
+                    gl->glDepthMask(GL_FALSE);
+                }
+                gl->glUseProgram(prg);
+                gl->glDrawArraysInstanced(GL_TRIANGLES, 0, 3, layers);
+                gl->glDepthMask(GL_TRUE);
+            };
+            Result& r = bench.measure("overdraw", QString("%1, %2").arg(variantNames[v], orderNames[o]), frame);
+            r.addRate("effective fill rate", pixels / 1e9, "GPixel/s");
+            if (haveStatistics)
+                gl->glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS, queries[0]);
+            if (haveOcclusion)
+                gl->glBeginQuery(GL_SAMPLES_PASSED, queries[1]);
+            frame();
+            if (haveOcclusion)
+                gl->glEndQuery(GL_SAMPLES_PASSED);
+            if (haveStatistics)
+                gl->glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS);
+            if (haveStatistics) {
+                GLuint64 invocations = 0;
+                getQueryObjectui64v(queries[0], GL_QUERY_RESULT, &invocations);
+                r.add("fragment shader invocations per pixel", invocations / pixels, "");
+                r.addRate("fragment shading rate", invocations / 1e9, "GFragment/s");
+            }
+            if (haveOcclusion) {
+                GLuint64 samples = 0;
+                getQueryObjectui64v(queries[1], GL_QUERY_RESULT, &samples);
+                r.add("samples passing the depth test per pixel", samples / pixels, "");
+            }
+        }
+        gl->glDeleteProgram(prepassPrg);
+        gl->glDeleteProgram(prg);
+    }
+
+    gl->glDisable(GL_DEPTH_TEST);
+    gl->glDepthFunc(GL_LESS);
+    gl->glDeleteFramebuffers(1, &fbo);
+    gl->glDeleteTextures(1, &depthTex);
+    gl->glDeleteTextures(1, &colorTex);
+    gl->glDeleteQueries(2, queries);
+}
@@ -0,0 +1,333 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include <QElapsedTimer>
+
+#include "benchmark.hpp"
+
+/* Cost of queries as used for occlusion culling: a 32x32 grid of small
+ * objects, half of them hidden behind an occluder, each drawn with an
+ * occlusion or timer query around it. Further cases measure the latency until
+ * query results are available, and compare culling the objects via CPU
+ * readback of the query results with conditional rendering. Besides the time
+ * per frame, each case reports the CPU time of submitting the GL calls and,
+ * with timer queries, the GPU time of the last frame. */
+
+#ifndef GL_SAMPLES_PASSED
+#define GL_SAMPLES_PASSED 0x8914
+#endif
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED 0x88BF
+#endif
+#ifndef GL_TIMESTAMP
+#define GL_TIMESTAMP 0x8E28
+#endif
+#ifndef GL_ANY_SAMPLES_PASSED_CONSERVATIVE
+#define GL_ANY_SAMPLES_PASSED_CONSERVATIVE 0x8D6A
+#endif
+#ifndef GL_QUERY_WAIT
+#define GL_QUERY_WAIT 0x8E13
+#define GL_QUERY_NO_WAIT 0x8E14
+#endif
+
+typedef void (QOPENGLF_APIENTRYP QueryCounter)(GLuint id, GLenum target);
+typedef void (QOPENGLF_APIENTRYP GetQueryObjectui64v)(GLuint id, GLenum pname, GLuint64* params);
+typedef void (QOPENGLF_APIENTRYP BeginConditionalRender)(GLuint id, GLenum mode);
+typedef void (QOPENGLF_APIENTRYP EndConditionalRender)();
+
+static const char objectVS[] =
+    "uniform vec3 offset;\n"
+    "uniform vec2 scale;\n"
+    "void main()\n"
+    "{\n"
+    "    int v = gl_VertexID % 6;\n"
+    "    vec2 c = vec2(v == 1 || v == 2 || v == 4 ? 1.0 : -1.0, v == 2 || v == 4 || v == 5 ? 1.0 : -1.0);\n"
+    "    gl_Position = vec4(offset.xy + c * scale, offset.z, 1.0);\n"
+    "}\n";
+
+static const char objectFS[] =
+    "uniform int work;\n"
+    "layout(location = 0) out vec4 fcolor;\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 c = vec4(gl_FragCoord.xy / 1024.0, gl_FragCoord.z, 1.0);\n"
+    "    for (int i = 0; i < work; i++)\n"
+    "        c = sin(c * 1.1 + vec4(0.3));\n"
+    "    fcolor = c;\n"
+    "}\n";
+
+void benchmarkQuery(Bench& bench)
+{
+    QOpenGLExtraFunctions* gl = bench.gl;
+    const int size = 1024;
+    const int gridSize = 32;
+    const int n = gridSize * gridSize;
+    const int objectLayers = 16;  // each culled object is drawn as 16 overlapping quads
+    const int objectWork = 16;    // with a costly fragment shader
+
+    QueryCounter queryCounter = nullptr;
+    GetQueryObjectui64v getQueryObjectui64v = nullptr;
+    bool haveTimer = false;
+    if (!bench.isGLES()) {
+        queryCounter = bench.getProc<QueryCounter>("glQueryCounter");
+        getQueryObjectui64v = bench.getProc<GetQueryObjectui64v>("glGetQueryObjectui64v");
+        haveTimer = true;
+    } else if (bench.hasExtension("GL_EXT_disjoint_timer_query")) {
+        queryCounter = bench.getProc<QueryCounter>("glQueryCounterEXT");
+        getQueryObjectui64v = bench.getProc<GetQueryObjectui64v>("glGetQueryObjectui64vEXT");
+        haveTimer = true;
+    } else {
+        bench.skip("timer queries and GPU times: require GL_EXT_disjoint_timer_query");
+    }
+    bool haveConservative = bench.atLeast(43, 30) || bench.hasExtension("GL_ARB_ES3_compatibility");
+    if (!haveConservative)
+        bench.skip("GL_ANY_SAMPLES_PASSED_CONSERVATIVE: requires OpenGL 4.3 or GL_ARB_ES3_compatibility");
+    BeginConditionalRender beginConditionalRender = nullptr;
+    EndConditionalRender endConditionalRender = nullptr;
+    if (!bench.isGLES()) {
+        beginConditionalRender = bench.getProc<BeginConditionalRender>("glBeginConditionalRender");
+        endConditionalRender = bench.getProc<EndConditionalRender>("glEndConditionalRender");
+    } else if (bench.hasExtension("GL_NV_conditional_render")) {
+        beginConditionalRender = bench.getProc<BeginConditionalRender>("glBeginConditionalRenderNV");
+        endConditionalRender = bench.getProc<EndConditionalRender>("glEndConditionalRenderNV");
+    } else {
+        bench.skip("conditional rendering: requires GL_NV_conditional_render");
+    }
+
+    GLuint prg = bench.program(objectVS, objectFS);
+    if (!prg) {
+        bench.skip("cannot build shader program");
+        return;
+    }
+    GLuint colorTex = bench.texture(GL_RGBA8, size, size);
+    GLuint depthTex = bench.texture(GL_DEPTH_COMPONENT24, size, size);
+    GLuint fbo = bench.framebuffer(colorTex, depthTex);
+    gl->glViewport(0, 0, size, size);
+    gl->glEnable(GL_DEPTH_TEST);
+    gl->glDepthFunc(GL_LEQUAL);
+    gl->glUseProgram(prg);
+    GLint offsetLoc = gl->glGetUniformLocation(prg, "offset");
+    GLint scaleLoc = gl->glGetUniformLocation(prg, "scale");
+    GLint workLoc = gl->glGetUniformLocation(prg, "work");
+    // A query object keeps the target it was first used with
+    std::vector<GLuint> queries(n);
+    gl->glGenQueries(n, queries.data());
+    auto newQueries = [&]() {
+        gl->glDeleteQueries(n, queries.data());
+        gl->glGenQueries(n, queries.data());
+    };
+
+    // The occluder covers the left half of the viewport
+    auto beginFrame = [&]() {
+        gl->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        gl->glUniform1i(workLoc, 0);
+        gl->glUniform3f(offsetLoc, -0.5f, 0.0f, -0.5f);
+        gl->glUniform2f(scaleLoc, 0.5f, 1.0f);
+        gl->glDrawArrays(GL_TRIANGLES, 0, 6);
+        gl->glUniform2f(scaleLoc, 0.8f / gridSize, 0.8f / gridSize);
+    };
+    // CPU time of the submission of a frame, averaged over all its
+    // iterations, and GPU time of the last frame of a measurement
+    GLuint frameTimestamps[2];
+    gl->glGenQueries(2, frameTimestamps);
+    QElapsedTimer cpuTimer;
+    double cpuSeconds = 0.0;
+    long long cpuFrames = 0;
+    auto frame = [&](const std::function<void ()>& submit) {
+        if (haveTimer)
+            queryCounter(frameTimestamps[0], GL_TIMESTAMP);
+        cpuTimer.start();
+        submit();
+        cpuSeconds += cpuTimer.nsecsElapsed() / 1e9;
+        cpuFrames++;
+        if (haveTimer)
+            queryCounter(frameTimestamps[1], GL_TIMESTAMP);
+    };
+    struct FrameTimes { double cpu; double gpu; };
+    auto addFrameTimes = [&](Result& r) {
+        FrameTimes t = { cpuSeconds / std::max(cpuFrames, 1LL), 0.0 };
+        cpuSeconds = 0.0;
+        cpuFrames = 0;
+        r.add("CPU time per frame", t.cpu * 1e3, "ms");
+        if (haveTimer) {
+            GLuint64 t0 = 0, t1 = 0;
+            getQueryObjectui64v(frameTimestamps[0], GL_QUERY_RESULT, &t0);
+            getQueryObjectui64v(frameTimestamps[1], GL_QUERY_RESULT, &t1);
+            t.gpu = (t1 > t0 ? t1 - t0 : 0) / 1e9;
+            r.add("GPU time per frame", t.gpu * 1e3, "ms");
+        }
+        return t;
+    };
+    auto setObject = [&](int i) {
+        gl->glUniform3f(offsetLoc, (i % gridSize + 0.5f) * 2.0f / gridSize - 1.0f,
+                (i / gridSize + 0.5f) * 2.0f / gridSize - 1.0f, 0.5f);
+    };
+    auto drawProxies = [&](GLenum target) {
+        for (int i = 0; i < n; i++) {
+            setObject(i);
+            if (target)
+                gl->glBeginQuery(target, queries[i]);
+            gl->glDrawArrays(GL_TRIANGLES, 0, 6);
+            if (target)
+                gl->glEndQuery(target);
+        }
+    };
+
+    // Query overhead
+    Result& r0 = bench.measure("query", QString("%1 draws, no queries").arg(n),
+            [&]() { frame([&]() { beginFrame(); drawProxies(0); }); });
+    r0.addRate("draw calls", n, "1/s");
+    double drawSeconds = r0.seconds;
+    FrameTimes drawTimes = addFrameTimes(r0);
+    auto addQueryCosts = [&](Result& r) {
+        FrameTimes t = addFrameTimes(r);
+        r.addRate("queries", n, "1/s");
+        r.add("cost per query", (r.seconds - drawSeconds) / n * 1e6, "us");
+        r.add("CPU cost per query", (t.cpu - drawTimes.cpu) / n * 1e6, "us");
+        if (haveTimer)
+            r.add("GPU cost per query", (t.gpu - drawTimes.gpu) / n * 1e6, "us");
+    };
+    struct { const char* name; GLenum target; bool available; } occlusionQueries[] = {
+        { "GL_SAMPLES_PASSED", GL_SAMPLES_PASSED, !bench.isGLES() },
+        { "GL_ANY_SAMPLES_PASSED", GL_ANY_SAMPLES_PASSED, true },
+        { "GL_ANY_SAMPLES_PASSED_CONSERVATIVE", GL_ANY_SAMPLES_PASSED_CONSERVATIVE, haveConservative },
+        { "GL_TIME_ELAPSED", GL_TIME_ELAPSED, haveTimer }
+    };
+    for (const auto& q : occlusionQueries) {
+        if (!q.available)
+            continue;
+        newQueries();
+        Result& r = bench.measure("query", QString("%1 draws, %2 queries").arg(n).arg(q.name),
+                [&]() { frame([&]() { beginFrame(); drawProxies(q.target); }); });
+        addQueryCosts(r);
+    }
+    if (haveTimer) {
+        newQueries();
+        Result& r = bench.measure("query", QString("%1 draws, GL_TIMESTAMP queries").arg(n),
+                [&]() {
+                    frame([&]() {
+                        beginFrame();
+                        for (int i = 0; i < n; i++) {
+                            setObject(i);
+                            gl->glDrawArrays(GL_TRIANGLES, 0, 6);
+                            queryCounter(queries[i], GL_TIMESTAMP);
+                        }
+                    });
+                });
+        addQueryCosts(r);
+    }
+
+    // Latency until the results are available: the time the CPU waits
+    // after submitting and flushing a frame
+    newQueries();
+    QElapsedTimer waitTimer;
+    double waitSeconds = 0.0;
+    long long waits = 0;
+    Result& r1 = bench.measure("query", QString("%1 draws, GL_ANY_SAMPLES_PASSED queries, wait for results").arg(n),
+            [&]() {
+                frame([&]() { beginFrame(); drawProxies(GL_ANY_SAMPLES_PASSED); });
+                gl->glFlush();
+                waitTimer.start();
+                GLuint available = GL_FALSE;
+                while (!available)
+                    gl->glGetQueryObjectuiv(queries[n - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+                waitSeconds += waitTimer.nsecsElapsed() / 1e9;
+                waits++;
+            });
+    addFrameTimes(r1);
+    r1.add("result latency", waitSeconds / waits * 1e3, "ms");
+
+    // Occlusion culling of costly objects: the proxies are the objects'
+    // bounding quads, drawn without color and depth writes
+    auto drawObject = [&](int i) {
+        setObject(i);
+        gl->glDrawArrays(GL_TRIANGLES, 0, 6 * objectLayers);
+    };
+    auto beginObjects = [&]() {
+        gl->glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        gl->glDepthMask(GL_TRUE);
+        gl->glUniform1i(workLoc, objectWork);
+    };
+    auto cullingFrame = [&]() {
+        beginFrame();
+        gl->glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        gl->glDepthMask(GL_FALSE);
+        drawProxies(GL_ANY_SAMPLES_PASSED);
+        beginObjects();
+    };
+    Result& r2 = bench.measure("query", QString("occlusion culling: none, %1 objects").arg(n),
+            [&]() {
+                frame([&]() {
+                    beginFrame();
+                    beginObjects();
+                    for (int i = 0; i < n; i++)
+                        drawObject(i);
+                });
+            });
+    double unculledSeconds = r2.seconds;
+    addFrameTimes(r2);
+    Result& r3 = bench.measure("query", QString("occlusion culling: CPU readback, %1 objects").arg(n),
+            [&]() {
+                frame([&]() {
+                    cullingFrame();
+                    for (int i = 0; i < n; i++) {
+                        GLuint visible = GL_FALSE;
+                        gl->glGetQueryObjectuiv(queries[i], GL_QUERY_RESULT, &visible);
+                        if (visible)
+                            drawObject(i);
+                    }
+                });
+            });
+    addFrameTimes(r3);
+    r3.add("cost over no culling", (r3.seconds - unculledSeconds) * 1e3, "ms");
+    if (beginConditionalRender) {
+        for (GLenum mode : { GL_QUERY_WAIT, GL_QUERY_NO_WAIT }) {
+            Result& r = bench.measure("query", QString("occlusion culling: conditional rendering %1, %2 objects")
+                    .arg(mode == GL_QUERY_WAIT ? "GL_QUERY_WAIT" : "GL_QUERY_NO_WAIT").arg(n),
+                    [&]() {
+                        frame([&]() {
+                            cullingFrame();
+                            for (int i = 0; i < n; i++) {
+                                beginConditionalRender(queries[i], mode);
+                                drawObject(i);
+                                endConditionalRender();
+                            }
+                        });
+                    });
+            addFrameTimes(r);
+            r.add("cost over no culling", (r.seconds - unculledSeconds) * 1e3, "ms");
+        }
+    }
+
+    gl->glDisable(GL_DEPTH_TEST);
+    gl->glDepthFunc(GL_LESS);
+    gl->glDeleteQueries(2, frameTimestamps);
+    gl->glDeleteQueries(n, queries.data());
+    gl->glDeleteFramebuffers(1, &fbo);
+    gl->glDeleteTextures(1, &depthTex);
+    gl->glDeleteTextures(1, &colorTex);
+    gl->glDeleteProgram(prg);
+}
@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "benchmark.hpp"
+
+/* Terrain tiles of t x t quads, instanced to roughly one million triangles
+ * per draw, as triangle lists and as one triangle strip per row. The strips
+ * are separated by degenerate triangles, by the fixed restart index (the
+ * maximum value of the index type), or by a custom index set with
+ * glPrimitiveRestartIndex (OpenGL only). Each is measured with every index
+ * type that can address the vertices of a tile. */
+
+typedef void (QOPENGLF_APIENTRYP PrimitiveRestartIndex)(GLuint index);
+
+#ifndef GL_PRIMITIVE_RESTART
+#define GL_PRIMITIVE_RESTART 0x8F9D
+#endif
+#ifndef GL_PRIMITIVE_RESTART_FIXED_INDEX
+#define GL_PRIMITIVE_RESTART_FIXED_INDEX 0x8D69
+#endif
+
+static const char tileVS[] =
+    "layout(location = 0) in vec2 pos;\n"
+    "uniform int tilesPerRow;\n"
+    "void main()\n"
+    "{\n"
+    "    vec2 tile = vec2(gl_InstanceID % tilesPerRow, gl_InstanceID / tilesPerRow);\n"
+    "    gl_Position = vec4((tile + pos) * (2.0 / float(tilesPerRow)) - 1.0, 0.0, 1.0);\n"
+    "}\n";
+
+static const char tileFS[] =
+    "layout(location = 0) out vec4 fcolor;\n"
+    "void main()\n"
+    "{\n"
+    "    fcolor = vec4(0.4, 0.3, 0.2, 1.0);\n"
+    "}\n";
+
+static std::vector<unsigned char> packIndices(const std::vector<GLuint>& indices, GLenum type)
+{
+    size_t size = (type == GL_UNSIGNED_BYTE ? 1 : type == GL_UNSIGNED_SHORT ? 2 : 4);
+    std::vector<unsigned char> data(indices.size() * size);
+    for (size_t i = 0; i < indices.size(); i++) {
+        if (type == GL_UNSIGNED_BYTE) {
+            data[i] = indices[i];
+        } else if (type == GL_UNSIGNED_SHORT) {
+            GLushort index = indices[i];
+            std::memcpy(data.data() + 2 * i, &index, 2);
+        } else {
+            std::memcpy(data.data() + 4 * i, &indices[i], 4);
+        }
+    }
+    return data;
+}
+
+void benchmarkPrimitiveRestart(Bench& bench)
+{
+    QOpenGLExtraFunctions* gl = bench.gl;
+    const int size = 1024;
+    const double trianglesPerDraw = 1 << 20;
+    const int tileSizes[] = { 14, 126, 254 };
+    const struct { GLenum type; const char* name; GLuint maxIndex; } indexTypes[] = {
+        { GL_UNSIGNED_BYTE,  "8 bit",  0xff },
+        { GL_UNSIGNED_SHORT, "16 bit", 0xffff },
+        { GL_UNSIGNED_INT,   "32 bit", 0xffffffff }
+    };
+
+    // OpenGL ES 3.0 always restarts at the fixed index
+    bool fixedIndex = bench.atLeast(43, 30);
+    if (!fixedIndex)
+        bench.skip("fixed index restart: requires OpenGL 4.3");
+    PrimitiveRestartIndex primitiveRestartIndex = nullptr;
+    if (!bench.isGLES())
+        primitiveRestartIndex = bench.getProc<PrimitiveRestartIndex>("glPrimitiveRestartIndex");
+    else
+        bench.skip("restart index: not available in OpenGL ES");
+
+    GLuint prg = bench.program(tileVS, tileFS);
+    if (!prg) {
+        bench.skip("cannot build shader program");
+        return;
+    }
+    GLuint colorTex = bench.texture(GL_RGBA8, size, size);
+    GLuint fbo = bench.framebuffer(colorTex);
+    gl->glViewport(0, 0, size, size);
+    gl->glUseProgram(prg);
+    GLuint buffers[2];
+    gl->glGenBuffers(2, buffers);
+    gl->glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+    gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+    gl->glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+    gl->glEnableVertexAttribArray(0);
+
+    for (int t : tileSizes) {
+        GLuint vertexCount = (t + 1) * (t + 1);
+        std::vector<float> vertices;
+        vertices.reserve(2 * vertexCount);
+        for (int y = 0; y <= t; y++) {
+            for (int x = 0; x <= t; x++) {
+                vertices.push_back(x / float(t));
+                vertices.push_back(y / float(t));
+            }
+        }
+        gl->glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+        double tileTriangles = 2.0 * t * t;
+        int instances = std::ceil(trianglesPerDraw / tileTriangles);
+        int tilesPerRow = std::ceil(std::sqrt(double(instances)));
+        gl->glUniform1i(gl->glGetUniformLocation(prg, "tilesPerRow"), tilesPerRow);
+        double triangles = instances * tileTriangles;
+
+        // Index lists that do not depend on the index type, except for the restart index
+        std::vector<GLuint> list;
+        for (int y = 0; y < t; y++) {
+            for (int x = 0; x < t; x++) {
+                GLuint i = y * (t + 1) + x;
+                GLuint quad[6] = { i, i + 1, i + t + 2, i, i + t + 2, i + t + 1 };
+                list.insert(list.end(), quad, quad + 6);
+            }
+        }
+        auto strips = [&](bool degenerate, GLuint restartIndex) {
+            std::vector<GLuint> indices;
+            for (int y = 0; y < t; y++) {
+                if (y > 0) {
+                    if (degenerate) {
+                        indices.push_back(indices.back());
+                        indices.push_back((y + 1) * (t + 1));
+                    } else {
+                        indices.push_back(restartIndex);
+                    }
+                }
+                for (int x = 0; x <= t; x++) {
+                    indices.push_back((y + 1) * (t + 1) + x);
+                    indices.push_back(y * (t + 1) + x);
+                }
+            }
+            return indices;
+        };
+
+        for (const auto& it : indexTypes) {
+            if (vertexCount > it.maxIndex)
+                continue;
+            auto name = [&](const char* method) {
+                return QString("%1, %2, %3x%3 tiles").arg(method).arg(it.name).arg(t);
+            };
+            auto measure = [&](const char* method, GLenum mode, const std::vector<GLuint>& indices) -> Result& {
+                std::vector<unsigned char> data = packIndices(indices, it.type);
+                gl->glBufferData(GL_ELEMENT_ARRAY_BUFFER, data.size(), data.data(), GL_STATIC_DRAW);
+                Result& r = bench.measure("restart", name(method), [&]() {
+                        gl->glDrawElementsInstanced(mode, indices.size(), it.type, nullptr, instances);
+                        });
+                r.addRate("triangles", triangles / 1e6, "MTriangles/s");
+                r.add("indices per triangle", indices.size() / tileTriangles, "");
+                return r;
+            };
+
+            double listSeconds = measure("list", GL_TRIANGLES, list).seconds;
+            Result& r0 = measure("strips, degenerate triangles", GL_TRIANGLE_STRIP, strips(true, 0));
+            r0.add("cost over list", (r0.seconds - listSeconds) * 1e3, "ms");
+            if (fixedIndex) {
+                if (!bench.isGLES())
+                    gl->glEnable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+                Result& r = measure("strips, fixed restart index", GL_TRIANGLE_STRIP, strips(false, it.maxIndex));
+                r.add("cost over list", (r.seconds - listSeconds) * 1e3, "ms");
+                if (!bench.isGLES())
+                    gl->glDisable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+            }
+            if (primitiveRestartIndex) {
+                // An index that is not the maximum of the type: the first unused one
+                primitiveRestartIndex(vertexCount);
+                gl->glEnable(GL_PRIMITIVE_RESTART);
+                Result& r = measure("strips, custom restart index", GL_TRIANGLE_STRIP, strips(false, vertexCount));
+                r.add("cost over list", (r.seconds - listSeconds) * 1e3, "ms");
+                gl->glDisable(GL_PRIMITIVE_RESTART);
+            }
+        }
+    }
+
+    gl->glDisableVertexAttribArray(0);
+    gl->glBindBuffer(GL_ARRAY_BUFFER, 0);
+    gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    gl->glDeleteBuffers(2, buffers);
+    gl->glDeleteFramebuffers(1, &fbo);
+    gl->glDeleteTextures(1, &colorTex);
+    gl->glDeleteProgram(prg);
+}
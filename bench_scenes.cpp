@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "benchmark.hpp"
+
+/* Representative scenes. They are meant to be combined with probes such as
+ * --pipeline-statistics, which explain the measured times in terms of work
+ * done by the individual pipeline stages. */
+
+static const char layerVS[] =
+    "uniform float zStart;\n"
+    "uniform float zStep;\n"
+    "void main()\n"
+    "{\n"
+    "    vec2 p = vec2(float((gl_VertexID & 1) << 2) - 1.0, float((gl_VertexID & 2) << 1) - 1.0);\n"
+    "    gl_Position = vec4(p, zStart + zStep * float(gl_InstanceID), 1.0);\n"
+    "}\n";
+
+/* With mirror, the left half of the grid is mirrored to the right half and
+ * thus becomes back-facing */
+static const char gridVS[] =
+    "layout(location = 0) in vec2 pos;\n"
+    "uniform vec2 scale;\n"
+    "uniform bool mirror;\n"
+    "void main()\n"
+    "{\n"
+    "    vec2 p = pos;\n"
+    "    if (mirror)\n"
+    "        p.x = abs(p.x) * 2.0 - 1.0;\n"
+    "    gl_Position = vec4(p * scale, 0.0, 1.0);\n"
+    "}\n";
+
+static const char sceneFS[] =
+    "layout(location = 0) out vec4 fcolor;\n"
+    "void main()\n"
+    "{\n"
+    "    fcolor = vec4(gl_FragCoord.xy / 4096.0, gl_FragCoord.z, 1.0);\n"
+    "}\n";
+
+void benchmarkScenes(Bench& bench)
+{
+    QOpenGLExtraFunctions* gl = bench.gl;
+    const int width = 1920;
+    const int height = 1080;
+    const int layers = 8;
+    const int gridSize = 256;
+
+    GLuint layerPrg = bench.program(layerVS, sceneFS);
+    GLuint gridPrg = bench.program(gridVS, sceneFS);
+    if (!layerPrg || !gridPrg) {
+        gl->glDeleteProgram(layerPrg);
+        gl->glDeleteProgram(gridPrg);
+        bench.skip("cannot build shader programs");
+        return;
+    }
+    GLuint colorTex = bench.texture(GL_RGBA8, width, height);
+    GLuint depthTex = bench.texture(GL_DEPTH_COMPONENT24, width, height);
+    GLuint fbo = bench.framebuffer(colorTex, depthTex);
+    gl->glViewport(0, 0, width, height);
+
+    gl->glUseProgram(layerPrg);
+    GLint zStartLoc = gl->glGetUniformLocation(layerPrg, "zStart");
+    GLint zStepLoc = gl->glGetUniformLocation(layerPrg, "zStep");
+    gl->glUniform1f(zStartLoc, 0.0f);
+    gl->glUniform1f(zStepLoc, 0.0f);
+    bench.measure("scenes", "full-screen triangle",
+            [&]() { gl->glDrawArrays(GL_TRIANGLES, 0, 3); });
+    bench.measure("scenes", QString("%1 full-screen layers").arg(layers),
+            [&]() { gl->glDrawArraysInstanced(GL_TRIANGLES, 0, 3, layers); });
+    gl->glEnable(GL_DEPTH_TEST);
+    gl->glUniform1f(zStartLoc, -0.9f);
+    gl->glUniform1f(zStepLoc, 0.2f);
+    bench.measure("scenes", QString("%1 layers with depth test, front to back").arg(layers),
+            [&]() {
+                gl->glClear(GL_DEPTH_BUFFER_BIT);
+                gl->glDrawArraysInstanced(GL_TRIANGLES, 0, 3, layers);
+            });
+    gl->glUniform1f(zStartLoc, 0.9f);
+    gl->glUniform1f(zStepLoc, -0.2f);
+    bench.measure("scenes", QString("%1 layers with depth test, back to front").arg(layers),
+            [&]() {
+                gl->glClear(GL_DEPTH_BUFFER_BIT);
+                gl->glDrawArraysInstanced(GL_TRIANGLES, 0, 3, layers);
+            });
+    gl->glDisable(GL_DEPTH_TEST);
+
+    GLuint buffers[2];
+    GLsizei indexCount = bench.gridMesh(gridSize, buffers);
+    gl->glUseProgram(gridPrg);
+    GLint scaleLoc = gl->glGetUniformLocation(gridPrg, "scale");
+    GLint mirrorLoc = gl->glGetUniformLocation(gridPrg, "mirror");
+    gl->glUniform2f(scaleLoc, 1.0f, 1.0f);
+    gl->glUniform1i(mirrorLoc, 0);
+    QString gridName = QString("grid of %1 triangles").arg(2 * gridSize * gridSize);
+    bench.measure("scenes", gridName,
+            [&]() { gl->glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr); });
+    gl->glEnable(GL_CULL_FACE);
+    gl->glUniform1i(mirrorLoc, 1);
+    bench.measure("scenes", gridName + ", half back-facing",
+            [&]() { gl->glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr); });
+    gl->glDisable(GL_CULL_FACE);
+    gl->glUniform1i(mirrorLoc, 0);
+    gl->glUniform2f(scaleLoc, 2.0f, 2.0f);
+    bench.measure("scenes", gridName + ", 3/4 outside the viewport",
+            [&]() { gl->glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr); });
+    gl->glDisableVertexAttribArray(0);
+    gl->glBindBuffer(GL_ARRAY_BUFFER, 0);
+    gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    gl->glDeleteBuffers(2, buffers);
+
+    if (bench.atLeast(43, 31)) {
+        GLuint computePrg = bench.computeProgram(
+                "layout(local_size_x = 64) in;\n"
+                "layout(std430, binding = 0) buffer Data { float data[]; };\n"
+                "void main()\n"
+                "{\n"
+                "    data[gl_GlobalInvocationID.x] = float(gl_GlobalInvocationID.x);\n"
+                "}\n");
+        if (computePrg) {
+            GLuint buf;
+            gl->glGenBuffers(1, &buf);
+            gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buf);
+            gl->glBufferData(GL_SHADER_STORAGE_BUFFER, 1024 * 64 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+            gl->glUseProgram(computePrg);
+            bench.measure("scenes", "compute dispatch of 1024 groups of 64",
+                    [&]() { gl->glDispatchCompute(1024, 1, 1); });
+            gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+            gl->glDeleteBuffers(1, &buf);
+            gl->glDeleteProgram(computePrg);
+        }
+    }
+
+    gl->glDeleteFramebuffers(1, &fbo);
+    gl->glDeleteTextures(1, &depthTex);
+    gl->glDeleteTextures(1, &colorTex);
+    gl->glDeleteProgram(gridPrg);
+    gl->glDeleteProgram(layerPrg);
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <vector>
+
+#include "benchmark.hpp"
+
+/* glTexSubImage2D of 1024x1024 texels from client memory with format and type
+ * combinations that may require a conversion by the driver, and with unpack
+ * state (alignment, row length, skipped pixels) and destination offsets as
+ * used for externally produced images with arbitrary pitch. Each group starts
+ * with a reference upload without conversion from tightly packed data; cases
+ * that take more than twice as long per texel as their reference get a note
+ * that flags them as slow paths. */
+
+#ifndef GL_BGRA
+#define GL_BGRA 0x80E1
+#endif
+#ifndef GL_UNSIGNED_INT_8_8_8_8_REV
+#define GL_UNSIGNED_INT_8_8_8_8_REV 0x8367
+#endif
+
+void benchmarkTextureUpload(Bench& bench)
+{
+    QOpenGLExtraFunctions* gl = bench.gl;
+    const int size = 1024;
+    const int textureSize = size + 64;
+    const double slowPathThreshold = 0.5;
+
+    // Source data with valid values for all types, large enough for a row
+    // length of twice the width
+    const size_t components = 2 * size * textureSize * 4;
+    std::vector<unsigned char> bytes(components);
+    std::vector<float> floats(components);
+    std::vector<GLushort> halves(components);
+    for (size_t i = 0; i < components; i++) {
+        bytes[i] = i * 7;
+        floats[i] = (i % 256) / 255.0f;
+        halves[i] = 0x3000 + i % 0x0c00; // normalized values in [0.125,1)
+    }
+
+    struct Reference { QString name; double texelRate; };
+    auto measure = [&](const QString& name, GLenum format, GLenum type, double bytesPerTexel,
+            int x, int y, int w, int h, const Reference* reference) -> double {
+        const void* data = (type == GL_FLOAT ? static_cast<const void*>(floats.data())
+                : type == GL_HALF_FLOAT ? static_cast<const void*>(halves.data())
+                : static_cast<const void*>(bytes.data()));
+        Result& r = bench.measure("texupload", name,
+                [&]() { gl->glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, format, type, data); });
+        double texels = double(w) * h;
+        r.addRate("bandwidth", texels * bytesPerTexel / 1e9, "GB/s");
+        r.addRate("texels", texels / 1e9, "GTexel/s");
+        double texelRate = texels / r.seconds;
+        if (reference) {
+            double relative = texelRate / reference->texelRate;
+            r.add("speed relative to reference", relative, "");
+            if (relative < slowPathThreshold)
+                r.notes.append(QString("slow path: %1 times the time per texel of %2")
+                        .arg(1.0 / relative, 0, 'f', 1).arg(reference->name));
+        }
+        return texelRate;
+    };
+
+    // Format and type combinations per internal format; the first one of
+    // each group is the reference
+    const struct {
+        GLenum internalFormat; const char* internalName;
+        GLenum format; GLenum type; const char* sourceName; double bytesPerTexel;
+        bool glOnly;
+    } conversions[] = {
+        { GL_RGBA8,   "RGBA8",   GL_RGBA, GL_UNSIGNED_BYTE,              "RGBA/UNSIGNED_BYTE",               4,  false },
+        { GL_RGBA8,   "RGBA8",   GL_BGRA, GL_UNSIGNED_BYTE,              "BGRA/UNSIGNED_BYTE",               4,  true },
+        { GL_RGBA8,   "RGBA8",   GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV,   "BGRA/UNSIGNED_INT_8_8_8_8_REV",    4,  true },
+        { GL_RGBA8,   "RGBA8",   GL_RGB,  GL_UNSIGNED_BYTE,              "RGB/UNSIGNED_BYTE",                3,  true },
+        { GL_RGBA8,   "RGBA8",   GL_RGBA, GL_FLOAT,                      "RGBA/FLOAT",                       16, true },
+        { GL_RGBA16F, "RGBA16F", GL_RGBA, GL_HALF_FLOAT,                 "RGBA/HALF_FLOAT",                  8,  false },
+        { GL_RGBA16F, "RGBA16F", GL_RGBA, GL_FLOAT,                      "RGBA/FLOAT",                       16, false },
+        { GL_RGBA32F, "RGBA32F", GL_RGBA, GL_FLOAT,                      "RGBA/FLOAT",                       16, false },
+        { GL_RGBA32F, "RGBA32F", GL_RGBA, GL_HALF_FLOAT,                 "RGBA/HALF_FLOAT",                  8,  true },
+    };
+    if (bench.isGLES())
+        bench.skip("format conversions that OpenGL ES does not allow (BGRA, RGB to RGBA, FLOAT to RGBA8, HALF_FLOAT to RGBA32F)");
+    Reference reference;
+    Reference rgba8Reference;
+    GLuint tex = 0;
+    for (size_t i = 0; i < sizeof(conversions) / sizeof(conversions[0]); i++) {
+        const auto& c = conversions[i];
+        bool first = (i == 0 || conversions[i - 1].internalFormat != c.internalFormat);
+        if (first) {
+            gl->glDeleteTextures(1, &tex);
+            tex = bench.texture(c.internalFormat, textureSize, textureSize);
+        }
+        if (c.glOnly && bench.isGLES())
+            continue;
+        QString name = QString("%1 from %2, %3x%3").arg(c.internalName).arg(c.sourceName).arg(size);
+        double texelRate = measure(name, c.format, c.type, c.bytesPerTexel, 0, 0, size, size, first ? nullptr : &reference);
+        if (first)
+            reference = { name, texelRate };
+        if (i == 0)
+            rgba8Reference = reference;
+    }
+    gl->glDeleteTextures(1, &tex);
+
+    // Source pitch and offset, and destination offset, relative to the
+    // tightly packed RGBA8 upload
+    tex = bench.texture(GL_RGBA8, textureSize, textureSize);
+    const int rowLengths[] = { size + 1, size + 64, 2 * size };
+    for (int rowLength : rowLengths) {
+        gl->glPixelStorei(GL_UNPACK_ROW_LENGTH, rowLength);
+        measure(QString("RGBA8, row length %1, %2x%2").arg(rowLength).arg(size),
+                GL_RGBA, GL_UNSIGNED_BYTE, 4, 0, 0, size, size, &rgba8Reference);
+    }
+    gl->glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    gl->glPixelStorei(GL_UNPACK_SKIP_PIXELS, 1);
+    measure(QString("RGBA8, skip 1 pixel, %1x%1").arg(size),
+            GL_RGBA, GL_UNSIGNED_BYTE, 4, 0, 0, size, size, &rgba8Reference);
+    gl->glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    const int offsets[][2] = { { 1, 0 }, { 1, 1 }, { 64, 64 } };
+    for (const auto& o : offsets) {
+        measure(QString("RGBA8, offset %1,%2, %3x%3").arg(o[0]).arg(o[1]).arg(size),
+                GL_RGBA, GL_UNSIGNED_BYTE, 4, o[0], o[1], size, size, &rgba8Reference);
+    }
+    gl->glDeleteTextures(1, &tex);
+
+    // Unpack alignment for 3-byte texels: rows of 1023 texels are only
+    // tightly packed with an alignment of 1
+    tex = bench.texture(GL_RGB8, textureSize, textureSize);
+    QString rgb8Name = QString("RGB8, alignment 4, %1x%1").arg(size);
+    Reference rgb8Reference = { rgb8Name, measure(rgb8Name, GL_RGB, GL_UNSIGNED_BYTE, 3, 0, 0, size, size, nullptr) };
+    const int alignments[] = { 1, 2, 4, 8 };
+    for (int alignment : alignments) {
+        gl->glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+        measure(QString("RGB8, alignment %1, %2x%2").arg(alignment).arg(size - 1),
+                GL_RGB, GL_UNSIGNED_BYTE, 3, 0, 0, size - 1, size - 1, &rgb8Reference);
+    }
+    gl->glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    gl->glDeleteTextures(1, &tex);
+}
@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <vector>
+
+#include "benchmark.hpp"
+
+/* A particle update (position and velocity, 32 bytes each) as transform
+ * feedback with interleaved and with separate capture, and as an equivalent
+ * compute shader that reads and writes shader storage buffers. Each case
+ * reads the particles from one buffer and writes them to another. */
+
+static const char updateFunction[] =
+    "uniform float dt;\n"
+    "void update(inout vec4 pos, inout vec4 vel)\n"
+    "{\n"
+    "    vel.xyz += vec3(0.0, -9.81, 0.0) * dt;\n"
+    "    pos.xyz += vel.xyz * dt;\n"
+    "    if (pos.y < 0.0) {\n"
+    "        pos.y = -pos.y;\n"
+    "        vel.y = -0.8 * vel.y;\n"
+    "    }\n"
+    "    pos.w -= dt;\n" // remaining lifetime
+    "}\n";
+
+static const char feedbackVS[] =
+    "layout(location = 0) in vec4 pos;\n"
+    "layout(location = 1) in vec4 vel;\n"
+    "out vec4 outPos;\n"
+    "out vec4 outVel;\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 p = pos;\n"
+    "    vec4 v = vel;\n"
+    "    update(p, v);\n"
+    "    outPos = p;\n"
+    "    outVel = v;\n"
+    "    gl_Position = p;\n"
+    "}\n";
+
+static const char feedbackFS[] =
+    "layout(location = 0) out vec4 fcolor;\n"
+    "void main()\n"
+    "{\n"
+    "    fcolor = vec4(1.0);\n"
+    "}\n";
+
+static const char particleCS[] =
+    "layout(local_size_x = 256) in;\n"
+    "struct Particle { vec4 pos; vec4 vel; };\n"
+    "layout(std430, binding = 0) readonly buffer Src { Particle src[]; };\n"
+    "layout(std430, binding = 1) writeonly buffer Dst { Particle dst[]; };\n"
+    "uniform uint count;\n"
+    "void main()\n"
+    "{\n"
+    "    uint i = gl_GlobalInvocationID.x;\n"
+    "    if (i < count) {\n"
+    "        Particle p = src[i];\n"
+    "        update(p.pos, p.vel);\n"
+    "        dst[i] = p;\n"
+    "    }\n"
+    "}\n";
+
+static GLuint feedbackProgram(Bench& bench, GLenum bufferMode)
+{
+    QOpenGLExtraFunctions* gl = bench.gl;
+    GLuint vs = bench.shader(GL_VERTEX_SHADER, QByteArray(updateFunction) + feedbackVS);
+    GLuint fs = bench.shader(GL_FRAGMENT_SHADER, feedbackFS);
+    GLuint prg = 0;
+    if (vs && fs) {
+        prg = gl->glCreateProgram();
+        gl->glAttachShader(prg, vs);
+        gl->glAttachShader(prg, fs);
+        const char* varyings[] = { "outPos", "outVel" };
+        gl->glTransformFeedbackVaryings(prg, 2, varyings, bufferMode);
+        prg = bench.link(prg);
+    }
+    gl->glDeleteShader(vs);
+    gl->glDeleteShader(fs);
+    return prg;
+}
+
+void benchmarkTransformFeedback(Bench& bench)
+{
+    QOpenGLExtraFunctions* gl = bench.gl;
+    const float dt = 0.01f;
+    const GLsizeiptr particleSize = 8 * sizeof(float);
+
+    GLuint interleavedPrg = feedbackProgram(bench, GL_INTERLEAVED_ATTRIBS);
+    GLuint separatePrg = feedbackProgram(bench, GL_SEPARATE_ATTRIBS);
+    GLuint computePrg = 0;
+    if (bench.atLeast(43, 31))
+        computePrg = bench.computeProgram(QByteArray(updateFunction) + particleCS);
+    else
+        bench.skip("compute shaders: require OpenGL 4.3 or OpenGL ES 3.1");
+    if (!interleavedPrg || !separatePrg) {
+        gl->glDeleteProgram(interleavedPrg);
+        gl->glDeleteProgram(separatePrg);
+        gl->glDeleteProgram(computePrg);
+        bench.skip("cannot build shader programs");
+        return;
+    }
+    for (GLuint prg : { interleavedPrg, separatePrg, computePrg }) {
+        if (prg) {
+            gl->glUseProgram(prg);
+            gl->glUniform1f(gl->glGetUniformLocation(prg, "dt"), dt);
+        }
+    }
+    // draws need a complete framebuffer even with rasterizer discard
+    GLuint colorTex = bench.texture(GL_RGBA8, 64, 64);
+    GLuint fbo = bench.framebuffer(colorTex);
+    gl->glEnable(GL_RASTERIZER_DISCARD);
+
+    for (int n : { 262144, 1048576, 4194304 }) {
+        std::vector<float> particles(8 * size_t(n));
+        for (int i = 0; i < n; i++) {
+            float* p = particles.data() + 8 * size_t(i);
+            p[0] = (i % 1024) / 1024.0f;
+            p[1] = (i / 1024 % 1024) / 1024.0f;
+            p[2] = (i / 1048576) / 4.0f;
+            p[3] = 10.0f;
+            p[4] = p[2] - 0.5f;
+            p[5] = p[0] * 2.0f;
+            p[6] = p[1] - 0.5f;
+            p[7] = 0.0f;
+        }
+        GLuint buffers[3];
+        gl->glGenBuffers(3, buffers);
+        gl->glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+        gl->glBufferData(GL_ARRAY_BUFFER, n * particleSize, particles.data(), GL_STATIC_DRAW);
+        gl->glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, particleSize, nullptr);
+        gl->glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, particleSize, reinterpret_cast<void*>(4 * sizeof(float)));
+        gl->glEnableVertexAttribArray(0);
+        gl->glEnableVertexAttribArray(1);
+        // buffers[1] holds all output, or the positions in separate mode;
+        // buffers[2] holds the velocities in separate mode
+        gl->glBindBuffer(GL_ARRAY_BUFFER, buffers[1]);
+        gl->glBufferData(GL_ARRAY_BUFFER, n * particleSize, nullptr, GL_DYNAMIC_COPY);
+        gl->glBindBuffer(GL_ARRAY_BUFFER, buffers[2]);
+        gl->glBufferData(GL_ARRAY_BUFFER, n * particleSize / 2, nullptr, GL_DYNAMIC_COPY);
+        gl->glBindBuffer(GL_ARRAY_BUFFER, 0);
+        auto addMetrics = [&](Result& r) {
+            r.addRate("particles", n / 1e6, "MParticles/s");
+            r.addRate("bandwidth (read + write)", 2.0 * n * particleSize / 1e9, "GB/s");
+        };
+
+        gl->glUseProgram(interleavedPrg);
+        gl->glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffers[1]);
+        Result& r0 = bench.measure("xfb", QString("transform feedback interleaved, %1 particles").arg(n),
+                [&]() {
+                    gl->glBeginTransformFeedback(GL_POINTS);
+                    gl->glDrawArrays(GL_POINTS, 0, n);
+                    gl->glEndTransformFeedback();
+                });
+        addMetrics(r0);
+        double interleavedSeconds = r0.seconds;
+
+        gl->glUseProgram(separatePrg);
+        gl->glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffers[1], 0, n * particleSize / 2);
+        gl->glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 1, buffers[2]);
+        Result& r1 = bench.measure("xfb", QString("transform feedback separate, %1 particles").arg(n),
+                [&]() {
+                    gl->glBeginTransformFeedback(GL_POINTS);
+                    gl->glDrawArrays(GL_POINTS, 0, n);
+                    gl->glEndTransformFeedback();
+                });
+        addMetrics(r1);
+        r1.add("cost over interleaved", (r1.seconds - interleavedSeconds) * 1e3, "ms");
+        gl->glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+        gl->glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 1, 0);
+
+        if (computePrg) {
+            gl->glUseProgram(computePrg);
+            gl->glUniform1ui(gl->glGetUniformLocation(computePrg, "count"), n);
+            gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffers[0]);
+            gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, buffers[1]);
+            Result& r2 = bench.measure("xfb", QString("compute shader SSBO, %1 particles").arg(n),
+                    [&]() { gl->glDispatchCompute((n + 255) / 256, 1, 1); });
+            addMetrics(r2);
+            r2.add("cost over interleaved", (r2.seconds - interleavedSeconds) * 1e3, "ms");
+            gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+            gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+        }
+
+        gl->glDisableVertexAttribArray(0);
+        gl->glDisableVertexAttribArray(1);
+        gl->glDeleteBuffers(3, buffers);
+    }
+
+    gl->glDisable(GL_RASTERIZER_DISCARD);
+    gl->glDeleteFramebuffers(1, &fbo);
+    gl->glDeleteTextures(1, &colorTex);
+    gl->glDeleteProgram(computePrg);
+    gl->glDeleteProgram(separatePrg);
+    gl->glDeleteProgram(interleavedPrg);
+}
@@ -0,0 +1,411 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#include <QElapsedTimer>
+#include <QStringList>
+
+#include "benchmark.hpp"
+
+static const struct {
+    const char* name;
+    const char* description;
+    void (*run)(Bench&);
+} benchmarks[] = {
+    { "fill", "Fill rate: full-screen triangles with a trivial fragment shader", benchmarkFill },
+    { "draw", "Draw call and triangle throughput", benchmarkDraw },
+    { "upload", "Buffer and texture upload bandwidth", benchmarkUpload },
+    { "compute", "Compute shader ALU throughput", benchmarkCompute },
+    { "state", "Cost of state changes between small draws", benchmarkState },
+    { "uniform", "Cost of uniform updates between small draws", benchmarkUniform },
+    { "scenes", "Representative scenes: overdraw, depth test, culling, clipping, compute", benchmarkScenes },
+    { "copy", "Clear, blit, and copy bandwidth for textures and buffers", benchmarkCopy },
+    { "mipmap", "Mipmap generation: glGenerateMipmap, fragment shader chain, single-pass compute", benchmarkMipmap },
+    { "barrier", "Cost of memory and texture barriers between dependent passes", benchmarkBarrier },
+    { "imageproc", "Blur, convolution, tonemap: image load/store, texel fetch, SSBO, fragment shader", benchmarkImageProcessing },
+    { "depth", "Depth-only and shadow map rendering: depth formats, ordering, cube maps", benchmarkDepth },
+    { "overdraw", "Overdraw and early depth tests: draw order, depth prepass, depth writes, discard", benchmarkOverdraw },
+    { "layered", "Layered rendering: separate passes, geometry shader, vertex shader gl_Layer", benchmarkLayered },
+    { "multiview", "Rendering multiple views: separate passes, viewport arrays, OVR_multiview", benchmarkMultiview },
+    { "xfb", "Transform feedback capture, interleaved and separate, versus compute shaders", benchmarkTransformFeedback },
+    { "query", "Occlusion and timer query overhead, result latency, conditional rendering", benchmarkQuery },
+    { "oit", "Order-independent transparency: weighted blended, linked lists, depth peeling", benchmarkOIT },
+    { "instancing", "Instancing of small meshes: instanced arrays, storage and texture buffers, indirect", benchmarkInstancing },
+    { "restart", "Triangle lists vs. strips with degenerate triangles or primitive restart", benchmarkPrimitiveRestart },
+    { "texupload", "Texture upload formats, conversions and unpack state, with slow paths flagged", benchmarkTextureUpload },
+};
+
+const char fullScreenTriangleVS[] =
+    "void main()\n"
+    "{\n"
+    "    vec2 p = vec2(float((gl_VertexID & 1) << 2) - 1.0, float((gl_VertexID & 2) << 1) - 1.0);\n"
+    "    gl_Position = vec4(p, 0.0, 1.0);\n"
+    "}\n";
+
+const char transformFunction[] =
+    "vec4 transform(vec2 pos, int view, int object)\n"
+    "{\n"
+    "    float a = viewAngle * float(view);\n"
+    "    vec2 p = mat2(cos(a), sin(a), -sin(a), cos(a)) * pos;\n"
+    "    return vec4(p * 0.7, 0.8 - 0.4 * float(object), 1.0);\n"
+    "}\n";
+
+const char passThroughVS[] =
+    "layout(location = 0) in vec2 pos;\n"
+    "out vec2 vpos;\n"
+    "flat out int vobject;\n"
+    "void main()\n"
+    "{\n"
+    "    vpos = pos;\n"
+    "    vobject = gl_InstanceID;\n"
+    "}\n";
+
+void Result::add(const QString& name, double value, const QString& unit)
+{
+    metrics.append({ name, value, unit });
+}
+
+void Result::addRate(const QString& name, double amountPerIteration, const QString& unit)
+{
+    add(name, seconds > 0.0 ? amountPerIteration / seconds : 0.0, unit);
+}
+
+Bench::Bench(QOpenGLContext* context) :
+    _pending(false), _probing(false), _vao(0),
+    context(context), gl(context->extraFunctions()),
+    minTime(0.25)
+{
+    // Core profiles and OpenGL ES require a bound vertex array object for drawing
+    gl->glGenVertexArrays(1, &_vao);
+    gl->glBindVertexArray(_vao);
+}
+
+Bench::~Bench()
+{
+    flush();
+    gl->glBindVertexArray(0);
+    gl->glDeleteVertexArrays(1, &_vao);
+}
+
+bool Bench::isGLES() const
+{
+    return context->isOpenGLES();
+}
+
+bool Bench::atLeast(int glVersion, int glesVersion) const
+{
+    int version = 10 * context->format().majorVersion() + context->format().minorVersion();
+    return version >= (isGLES() ? glesVersion : glVersion);
+}
+
+bool Bench::hasExtension(const char* extension) const
+{
+    return context->hasExtension(extension);
+}
+
+void Bench::flush()
+{
+    if (!_pending)
+        return;
+    const Result& r = _results.last();
+    printf("    %-48s %12.6f ms\n", qPrintable(r.name), r.seconds * 1e3);
+    for (const Metric& m : r.metrics)
+        printf("      %-46s %12.6g %s\n", qPrintable(m.name), m.value, qPrintable(m.unit));
+    for (const QString& note : r.notes)
+        printf("      %s\n", qPrintable(note));
+    fflush(stdout);
+    _pending = false;
+}
+
+void Bench::begin(const QString& benchmark)
+{
+    flush();
+    printf("Benchmark %s:\n", qPrintable(benchmark));
+    fflush(stdout);
+}
+
+void Bench::skip(const QString& reason)
+{
+    flush();
+    printf("    skipped: %s\n", qPrintable(reason));
+    fflush(stdout);
+}
+
+Result& Bench::measure(const QString& benchmark, const QString& name, const std::function<void ()>& iteration)
+{
+    QElapsedTimer timer;
+    flush();
+
+    // Warm up, then find an iteration count that takes roughly minTime
+    iteration();
+    gl->glFinish();
+    long long n = 1;
+    for (;;) {
+        timer.start();
+        for (long long i = 0; i < n; i++)
+            iteration();
+        gl->glFinish();
+        double t = timer.nsecsElapsed() / 1e9;
+        if (t >= minTime / 8.0 || n >= (1LL << 40)) {
+            n = std::max(1LL, static_cast<long long>(std::ceil(n * minTime / std::max(t, 1e-9))));
+            break;
+        }
+        n *= 2;
+    }
+
+    // Measure
+    startProbes();
+    timer.start();
+    for (long long i = 0; i < n; i++)
+        iteration();
+    gl->glFinish();
+    qint64 ns = timer.nsecsElapsed();
+    return addResult(benchmark, name, n, ns / 1e9 / n);
+}
+
+void Bench::startProbes()
+{
+    for (Probe* probe : probes)
+        probe->begin();
+    _probing = true;
+}
+
+Result& Bench::addResult(const QString& benchmark, const QString& name, long long iterations, double seconds)
+{
+    flush();
+    Result r;
+    r.benchmark = benchmark;
+    r.name = name;
+    r.iterations = iterations;
+    r.seconds = seconds;
+    if (_probing) {
+        for (int i = probes.size() - 1; i >= 0; i--)
+            probes[i]->end(r);
+        _probing = false;
+    }
+    GLenum err = gl->glGetError();
+    if (err != GL_NO_ERROR)
+        fprintf(stderr, "%s / %s: OpenGL error 0x%04x\n", qPrintable(benchmark), qPrintable(name), err);
+    _results.append(r);
+    _pending = true;
+    return _results.last();
+}
+
+QByteArray Bench::glslHeader() const
+{
+    int major = context->format().majorVersion();
+    int minor = context->format().minorVersion();
+    if (isGLES()) {
+        return "#version " + QByteArray::number(major * 100 + minor * 10) + " es\n"
+            "precision highp float;\n"
+            "precision highp int;\n"
+            "precision highp sampler2D;\n";
+    } else {
+        return "#version " + QByteArray::number(major * 100 + minor * 10) + " core\n";
+    }
+}
+
+GLuint Bench::shader(GLenum type, const QByteArray& source)
+{
+    // #extension directives at the start of the source must directly follow
+    // the #version line, before the precision statements of the header
+    QByteArray header = glslHeader();
+    QByteArray body = source;
+    qsizetype versionEnd = header.indexOf('\n') + 1;
+    while (body.startsWith("#extension")) {
+        qsizetype lineEnd = body.indexOf('\n') + 1;
+        if (lineEnd == 0) // last line without newline
+            lineEnd = body.size();
+        QByteArray line = body.left(lineEnd);
+        if (!line.endsWith('\n'))
+            line += '\n';
+        header = header.left(versionEnd) + line + header.mid(versionEnd);
+        versionEnd += line.size();
+        body = body.mid(lineEnd);
+    }
+    QByteArray fullSource = header + body;
+    const char* src = fullSource.constData();
+    GLuint s = gl->glCreateShader(type);
+    gl->glShaderSource(s, 1, &src, nullptr);
+    gl->glCompileShader(s);
+    GLint status = GL_FALSE;
+    gl->glGetShaderiv(s, GL_COMPILE_STATUS, &status);
+    if (status != GL_TRUE) {
+        GLint logSize = 0;
+        gl->glGetShaderiv(s, GL_INFO_LOG_LENGTH, &logSize);
+        QByteArray log(std::max(logSize, 1), '\0');
+        gl->glGetShaderInfoLog(s, logSize, nullptr, log.data());
+        fprintf(stderr, "shader compilation failed:\n%s\n", log.constData());
+        gl->glDeleteShader(s);
+        return 0;
+    }
+    return s;
+}
+
+GLuint Bench::link(GLuint program)
+{
+    gl->glLinkProgram(program);
+    GLint status = GL_FALSE;
+    gl->glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE) {
+        GLint logSize = 0;
+        gl->glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logSize);
+        QByteArray log(std::max(logSize, 1), '\0');
+        gl->glGetProgramInfoLog(program, logSize, nullptr, log.data());
+        fprintf(stderr, "program linking failed:\n%s\n", log.constData());
+        gl->glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+GLuint Bench::program(const QByteArray& vs, const QByteArray& fs, const QByteArray& gs)
+{
+    GLuint shaders[3] = {
+        shader(GL_VERTEX_SHADER, vs),
+        shader(GL_FRAGMENT_SHADER, fs),
+        gs.isEmpty() ? 0 : shader(GL_GEOMETRY_SHADER, gs)
+    };
+    GLuint prg = 0;
+    if (shaders[0] && shaders[1] && (gs.isEmpty() || shaders[2])) {
+        prg = gl->glCreateProgram();
+        for (GLuint s : shaders)
+            if (s)
+                gl->glAttachShader(prg, s);
+        prg = link(prg);
+    }
+    for (GLuint s : shaders)
+        if (s)
+            gl->glDeleteShader(s);
+    return prg;
+}
+
+GLuint Bench::computeProgram(const QByteArray& cs)
+{
+    GLuint s = shader(GL_COMPUTE_SHADER, cs);
+    if (!s)
+        return 0;
+    GLuint prg = gl->glCreateProgram();
+    gl->glAttachShader(prg, s);
+    prg = link(prg);
+    gl->glDeleteShader(s);
+    return prg;
+}
+
+GLuint Bench::texture(GLenum internalFormat, int width, int height, int levels)
+{
+    GLuint tex;
+    gl->glGenTextures(1, &tex);
+    gl->glBindTexture(GL_TEXTURE_2D, tex);
+    gl->glTexStorage2D(GL_TEXTURE_2D, levels, internalFormat, width, height);
+    gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return tex;
+}
+
+GLsizei Bench::gridMesh(int n, GLuint buffers[2])
+{
+    std::vector<float> vertices;
+    vertices.reserve(2 * (n + 1) * (n + 1));
+    for (int y = 0; y <= n; y++) {
+        for (int x = 0; x <= n; x++) {
+            vertices.push_back(x * 2.0f / n - 1.0f);
+            vertices.push_back(y * 2.0f / n - 1.0f);
+        }
+    }
+    std::vector<GLuint> indices;
+    indices.reserve(6 * n * n);
+    for (int y = 0; y < n; y++) {
+        for (int x = 0; x < n; x++) {
+            GLuint i = y * (n + 1) + x;
+            GLuint quad[6] = { i, i + 1, i + n + 2, i, i + n + 2, i + n + 1 };
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+    gl->glGenBuffers(2, buffers);
+    gl->glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+    gl->glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+    gl->glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+    gl->glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+    gl->glEnableVertexAttribArray(0);
+    return indices.size();
+}
+
+GLuint Bench::framebuffer(GLuint colorTexture, GLuint depthTexture)
+{
+    GLuint fbo;
+    gl->glGenFramebuffers(1, &fbo);
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    if (colorTexture)
+        gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+    if (depthTexture)
+        gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+    GLenum drawBuffer = colorTexture ? GL_COLOR_ATTACHMENT0 : GL_NONE;
+    gl->glDrawBuffers(1, &drawBuffer);
+    if (gl->glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        fprintf(stderr, "framebuffer object is incomplete\n");
+    return fbo;
+}
+
+void listBenchmarks()
+{
+    for (const auto& b : benchmarks)
+        printf("  %-20s %s\n", b.name, b.description);
+}
+
+bool runBenchmarks(Bench& bench, const QStringList& names)
+{
+    QStringList selected;
+    for (const QString& name : names) {
+        for (const QString& n : name.split(',', Qt::SkipEmptyParts)) {
+            bool known = (n == "all");
+            for (const auto& b : benchmarks)
+                if (n == b.name)
+                    known = true;
+            if (!known) {
+                fprintf(stderr, "unknown benchmark %s\n", qPrintable(n));
+                return false;
+            }
+            selected.append(n);
+        }
+    }
+    if (!bench.atLeast(42, 30)) {
+        fprintf(stderr, "benchmarks require OpenGL 4.2 or OpenGL ES 3.0\n");
+        return false;
+    }
+    for (const auto& b : benchmarks) {
+        if (selected.contains("all") || selected.contains(b.name)) {
+            bench.begin(b.name);
+            b.run(bench);
+            bench.flush();
+            bench.gl->glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            bench.gl->glUseProgram(0);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include <functional>
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+
+/* A named value measured or derived by a benchmark or a probe */
+struct Metric
+{
+    QString name;
+    double value;
+    QString unit;
+};
+
+/* The result of one measurement */
+class Result
+{
+public:
+    QString benchmark;          // name of the benchmark, e.g. "fill"
+    QString name;               // name of the measured case, e.g. "RGBA8 1920x1080"
+    long long iterations;       // number of measured iterations
+    double seconds;             // seconds per iteration
+    QList<Metric> metrics;      // additional metrics
+    QStringList notes;          // additional text, e.g. driver messages
+
+    Result() : iterations(0), seconds(0.0) {}
+
+    // Add a metric
+    void add(const QString& name, double value, const QString& unit);
+    // Add a metric that is the given amount per iteration divided by time
+    void addRate(const QString& name, double amountPerIteration, const QString& unit);
+};
+
+/* A probe collects additional metrics around each measurement.
+ * It is called directly before and after the measured iterations,
+ * outside of the timed region. */
+class Probe
+{
+public:
+    virtual ~Probe() {}
+    virtual void begin() = 0;
+    virtual void end(Result& result) = 0;
+};
+
+/* The benchmark environment: context access, measurement, and helpers */
+class Bench
+{
+private:
+    QList<Result> _results;
+    bool _pending;
+    bool _probing;
+    GLuint _vao;
+
+public:
+    QOpenGLContext* context;
+    QOpenGLExtraFunctions* gl;
+    double minTime;             // minimum duration of a measurement in seconds
+    QList<Probe*> probes;
+
+    Bench(QOpenGLContext* context);
+    ~Bench();
+
+    // Version and extension checks
+    bool isGLES() const;
+    bool atLeast(int glVersion, int glesVersion) const; // e.g. atLeast(43, 31)
+    bool hasExtension(const char* extension) const;
+    // Get a function that QOpenGLExtraFunctions does not provide
+    template<typename T> T getProc(const char* name) const;
+
+    // Print a benchmark header / a note that a case or benchmark was skipped
+    void begin(const QString& benchmark);
+    void skip(const QString& reason);
+    // Print the pending result, if any
+    void flush();
+
+    // Measure the time per call of iteration(), with probes active.
+    // The returned result is printed when the next measurement starts or the
+    // benchmark ends, so that derived metrics can be added to it.
+    Result& measure(const QString& benchmark, const QString& name, const std::function<void ()>& iteration);
+    // For work that measure() cannot repeat, e.g. a sequence of different
+    // frames: optionally start the probes, run and time the work, then add
+    // the result. This stops the probes, which report per iteration.
+    void startProbes();
+    Result& addResult(const QString& benchmark, const QString& name, long long iterations, double seconds);
+
+    // All results measured so far
+    const QList<Result>& results() const { return _results; }
+
+    // Shader helpers. Sources must not contain a #version line; a suitable one
+    // is added, and #extension directives at the start of a source are moved
+    // directly after it. These return 0 on failure and print the log to stderr.
+    QByteArray glslHeader() const;
+    GLuint shader(GLenum type, const QByteArray& source);
+    GLuint link(GLuint program);
+    GLuint program(const QByteArray& vs, const QByteArray& fs, const QByteArray& gs = QByteArray());
+    GLuint computeProgram(const QByteArray& cs);
+
+    // Create a 2D texture with immutable storage
+    GLuint texture(GLenum internalFormat, int width, int height, int levels = 1);
+    // Create a vertex and an index buffer for a grid of n x n quads covering
+    // [-1,1]^2, bind them, and set up vertex attribute 0 for the 2D positions.
+    // Returns the number of indices (GL_UNSIGNED_INT) for GL_TRIANGLES.
+    GLsizei gridMesh(int n, GLuint buffers[2]);
+    // Create a framebuffer object with the given color texture attached (or none)
+    GLuint framebuffer(GLuint colorTexture, GLuint depthTexture = 0);
+};
+
+/* A vertex shader that covers the viewport with one triangle (3 vertices) */
+extern const char fullScreenTriangleVS[];
+/* A GLSL function vec4 transform(vec2 pos, int view, int object) for drawing
+ * into several layers or views: it rotates pos by viewAngle * view, where
+ * viewAngle is a float constant that the shader must declare first, and gives
+ * each object its own depth */
+extern const char transformFunction[];
+/* A vertex shader that passes pos and gl_InstanceID on to a geometry shader
+ * as vpos and vobject */
+extern const char passThroughVS[];
+
+void benchmarkFill(Bench& bench);
+void benchmarkDraw(Bench& bench);
+void benchmarkUpload(Bench& bench);
+void benchmarkCompute(Bench& bench);
+void benchmarkState(Bench& bench);
+void benchmarkUniform(Bench& bench);
+void benchmarkScenes(Bench& bench);
+void benchmarkCopy(Bench& bench);
+void benchmarkMipmap(Bench& bench);
+void benchmarkBarrier(Bench& bench);
+void benchmarkImageProcessing(Bench& bench);
+void benchmarkDepth(Bench& bench);
+void benchmarkOverdraw(Bench& bench);
+void benchmarkLayered(Bench& bench);
+void benchmarkMultiview(Bench& bench);
+void benchmarkTransformFeedback(Bench& bench);
+void benchmarkQuery(Bench& bench);
+void benchmarkOIT(Bench& bench);
+void benchmarkInstancing(Bench& bench);
+void benchmarkPrimitiveRestart(Bench& bench);
+void benchmarkTextureUpload(Bench& bench);
+
+/* Print the list of available benchmarks */
+void listBenchmarks();
+
+/* Run the benchmarks with the given names ("all" selects all) */
+bool runBenchmarks(Bench& bench, const QStringList& names);
+
+template<typename T> T Bench::getProc(const char* name) const
+{
+    return reinterpret_cast<T>(context->getProcAddress(name));
+}
+
+#endif
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "debugmessages.hpp"
+
+static const char* sourceName(QOpenGLDebugMessage::Source source)
+{
+    switch (source) {
+    case QOpenGLDebugMessage::APISource:
+        return "API";
+    case QOpenGLDebugMessage::WindowSystemSource:
+        return "window system";
+    case QOpenGLDebugMessage::ShaderCompilerSource:
+        return "shader compiler";
+    case QOpenGLDebugMessage::ThirdPartySource:
+        return "third party";
+    case QOpenGLDebugMessage::ApplicationSource:
+        return "application";
+    default:
+        return "other";
+    }
+}
+
+bool DebugMessageProbe::initialize()
+{
+    if (!_logger.initialize())
+        return false;
+    QObject::connect(&_logger, &QOpenGLDebugLogger::messageLogged, [this](const QOpenGLDebugMessage& message) {
+        QString key = QString("%1 0x%2: %3").arg(sourceName(message.source()))
+            .arg(message.id(), 0, 16).arg(message.message().trimmed());
+        _messages[key]++;
+    });
+    _logger.disableMessages();
+    _logger.enableMessages(QOpenGLDebugMessage::AnySource, QOpenGLDebugMessage::PerformanceType);
+    _logger.startLogging(QOpenGLDebugLogger::SynchronousLogging);
+    return true;
+}
+
+void DebugMessageProbe::begin()
+{
+}
+
+void DebugMessageProbe::end(Result& result)
+{
+    for (auto it = _messages.cbegin(); it != _messages.cend(); ++it)
+        result.notes.append(QString("performance message (%1x) %2").arg(it.value()).arg(it.key()));
+    _messages.clear();
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef DEBUGMESSAGES_HPP
+#define DEBUGMESSAGES_HPP
+
+#include <QMap>
+#include <QOpenGLDebugLogger>
+
+#include "benchmark.hpp"
+
+/* A probe that collects the performance messages (GL_DEBUG_TYPE_PERFORMANCE)
+ * that the driver reports via KHR_debug, e.g. about shader recompiles, slow
+ * upload paths, or stalls. Messages are attributed to the measurement during
+ * or before which they were logged, so that messages caused by setup and
+ * warm-up are included. Identical messages are reported once with a count.
+ * Drivers may only generate messages for debug contexts. */
+class DebugMessageProbe : public Probe
+{
+private:
+    QOpenGLDebugLogger _logger;
+    QMap<QString, int> _messages;
+
+public:
+    // Start logging in the current context. Returns false if KHR_debug is
+    // not available.
+    bool initialize();
+
+    void begin() override;
+    void end(Result& result) override;
+};
+
+#endif
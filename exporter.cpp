@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstdio>
+#include <functional>
+#include <memory>
+
+#include <QGuiApplication>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QLocalServer>
+#include <QLocalSocket>
+
+#include "glinf.hpp"
+#include "exporter.hpp"
+
+static const struct {
+    GLenum pname;
+    const char* name;
+} exportedLimits[] = {
+    { GL_MAX_TEXTURE_SIZE, "GL_MAX_TEXTURE_SIZE" },
+    { GL_MAX_3D_TEXTURE_SIZE, "GL_MAX_3D_TEXTURE_SIZE" },
+    { GL_MAX_CUBE_MAP_TEXTURE_SIZE, "GL_MAX_CUBE_MAP_TEXTURE_SIZE" },
+    { GL_MAX_ARRAY_TEXTURE_LAYERS, "GL_MAX_ARRAY_TEXTURE_LAYERS" },
+    { GL_MAX_FRAMEBUFFER_WIDTH, "GL_MAX_FRAMEBUFFER_WIDTH" },
+    { GL_MAX_FRAMEBUFFER_HEIGHT, "GL_MAX_FRAMEBUFFER_HEIGHT" },
+    { GL_MAX_COLOR_ATTACHMENTS, "GL_MAX_COLOR_ATTACHMENTS" },
+    { GL_MAX_DRAW_BUFFERS, "GL_MAX_DRAW_BUFFERS" },
+    { GL_MAX_VIEWPORTS, "GL_MAX_VIEWPORTS" },
+    { GL_MAX_VIEWS_OVR, "GL_MAX_VIEWS_OVR" },
+    { GL_MAX_VERTEX_ATTRIBS, "GL_MAX_VERTEX_ATTRIBS" },
+    { GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, "GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS" },
+    { GL_MAX_COMPUTE_UNIFORM_COMPONENTS, "GL_MAX_COMPUTE_UNIFORM_COMPONENTS" },
+    { GL_MAX_SHADER_STORAGE_BLOCK_SIZE, "GL_MAX_SHADER_STORAGE_BLOCK_SIZE" },
+    { GL_MAX_UNIFORM_BLOCK_SIZE, "GL_MAX_UNIFORM_BLOCK_SIZE" },
+    { GL_MAX_SAMPLES, "GL_MAX_SAMPLES" }
+};
+
+static QByteArray escapeLabel(const char* value)
+{
+    QByteArray r;
+    for (const char* p = value; p && *p; p++) {
+        if (*p == '\\')
+            r += "\\\\";
+        else if (*p == '"')
+            r += "\\\"";
+        else if (*p == '\n')
+            r += "\\n";
+        else
+            r += *p;
+    }
+    return r;
+}
+
+static void addMetric(QByteArray& out, const char* name, const char* type, const char* help)
+{
+    out += QByteArray("# HELP ") + name + ' ' + help + '\n';
+    out += QByteArray("# TYPE ") + name + ' ' + type + '\n';
+}
+
+static void addSample(QByteArray& out, const char* name, const QByteArray& labels, double value)
+{
+    out += name;
+    if (!labels.isEmpty())
+        out += '{' + labels + '}';
+    out += ' ' + QByteArray::number(value, 'g', 17) + '\n';
+}
+
+static QByteArray metrics(QOpenGLContext* context, QOffscreenSurface* surface,
+        const QString& contextString, unsigned long long scrapes)
+{
+    QByteArray out;
+    if (!context->makeCurrent(surface)) {
+        addMetric(out, "glinf_up", "gauge", "Whether the OpenGL context is usable.");
+        addSample(out, "glinf_up", QByteArray(), 0);
+        return out;
+    }
+    QOpenGLExtraFunctions* gl = context->extraFunctions();
+
+    addMetric(out, "glinf_up", "gauge", "Whether the OpenGL context is usable.");
+    addSample(out, "glinf_up", QByteArray(), 1);
+    addMetric(out, "glinf_scrapes_total", "counter", "Number of scrapes served.");
+    addSample(out, "glinf_scrapes_total", QByteArray(), scrapes);
+
+    addMetric(out, "glinf_context_info", "gauge", "Information about the OpenGL context.");
+    addSample(out, "glinf_context_info",
+            "context=\"" + escapeLabel(qPrintable(contextString)) + "\","
+            + "version=\"" + escapeLabel(getS(gl, GL_VERSION)) + "\","
+            + "sl_version=\"" + escapeLabel(getS(gl, GL_SHADING_LANGUAGE_VERSION)) + "\","
+            + "vendor=\"" + escapeLabel(getS(gl, GL_VENDOR)) + "\","
+            + "renderer=\"" + escapeLabel(getS(gl, GL_RENDERER)) + "\"", 1);
+
+    addMetric(out, "glinf_limit", "gauge", "Implementation-defined limit.");
+    gl->glGetError(); // clear previous errors
+    for (const auto& limit : exportedLimits) {
+        GLint value = getI(gl, limit.pname);
+        // Not all limits exist in all context types; omit the unknown ones
+        if (gl->glGetError() == GL_INVALID_ENUM)
+            continue;
+        addSample(out, "glinf_limit", "name=\"" + QByteArray(limit.name) + "\"", value);
+    }
+
+    MemInfo m = getMemInfo(gl);
+    if (m.dedicated != 0) {
+        addMetric(out, "glinf_memory_dedicated_bytes", "gauge", "Dedicated video memory (NVX_gpu_memory_info).");
+        addSample(out, "glinf_memory_dedicated_bytes", QByteArray(), m.dedicated * 1024.0);
+        addMetric(out, "glinf_memory_total_available_bytes", "gauge", "Total available memory (NVX_gpu_memory_info).");
+        addSample(out, "glinf_memory_total_available_bytes", QByteArray(), m.totalAvailable * 1024.0);
+        addMetric(out, "glinf_memory_current_available_bytes", "gauge", "Currently available video memory (NVX_gpu_memory_info).");
+        addSample(out, "glinf_memory_current_available_bytes", QByteArray(), m.currentAvailable * 1024.0);
+        addMetric(out, "glinf_memory_evictions_total", "counter", "Number of evictions (NVX_gpu_memory_info).");
+        addSample(out, "glinf_memory_evictions_total", QByteArray(), m.evictionCount);
+        addMetric(out, "glinf_memory_evicted_bytes_total", "counter", "Size of evicted memory (NVX_gpu_memory_info).");
+        addSample(out, "glinf_memory_evicted_bytes_total", QByteArray(), m.evicted * 1024.0);
+    } else if (m.textureFree[0] != 0) {
+        addMetric(out, "glinf_memory_free_bytes", "gauge", "Free memory per pool (ATI_meminfo).");
+        addSample(out, "glinf_memory_free_bytes", "pool=\"texture\"", m.textureFree[0] * 1024.0);
+        addSample(out, "glinf_memory_free_bytes", "pool=\"vbo\"", m.vboFree[0] * 1024.0);
+        addSample(out, "glinf_memory_free_bytes", "pool=\"renderbuffer\"", m.renderbufferFree[0] * 1024.0);
+        addMetric(out, "glinf_memory_largest_free_block_bytes", "gauge", "Largest free block per pool (ATI_meminfo).");
+        addSample(out, "glinf_memory_largest_free_block_bytes", "pool=\"texture\"", m.textureFree[1] * 1024.0);
+        addSample(out, "glinf_memory_largest_free_block_bytes", "pool=\"vbo\"", m.vboFree[1] * 1024.0);
+        addSample(out, "glinf_memory_largest_free_block_bytes", "pool=\"renderbuffer\"", m.renderbufferFree[1] * 1024.0);
+    }
+    return out;
+}
+
+/* Answer a single HTTP request on the given connection, then close it.
+ * The connection deletes itself once it is disconnected, whether by us or by
+ * the peer. */
+template<typename Socket>
+static void serve(Socket* connection, std::function<QByteArray ()> body)
+{
+    QObject::connect(connection, &Socket::disconnected, connection, &QObject::deleteLater);
+    auto request = std::make_shared<QByteArray>();
+    QObject::connect(connection, &QIODevice::readyRead, [=]() {
+        *request += connection->readAll();
+        if (request->indexOf("\r\n\r\n") < 0 && request->indexOf("\n\n") < 0) {
+            if (request->size() > 8192)
+                connection->close();
+            return;
+        }
+        QList<QByteArray> requestLine = request->left(request->indexOf('\n')).trimmed().split(' ');
+        QByteArray status = "200 OK";
+        QByteArray content;
+        if (requestLine.size() < 2 || requestLine[0] != "GET") {
+            status = "405 Method Not Allowed";
+        } else if (requestLine[1] != "/metrics" && requestLine[1] != "/") {
+            status = "404 Not Found";
+        } else {
+            content = body();
+        }
+        QByteArray response = "HTTP/1.0 " + status + "\r\n"
+            + "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+            + "Content-Length: " + QByteArray::number(int(content.size())) + "\r\n"
+            + "Connection: close\r\n"
+            + "\r\n"
+            + content;
+        connection->write(response);
+        // close() waits for the response to be written before disconnecting
+        connection->close();
+    });
+}
+
+int runExporter(QOpenGLContext* context, QOffscreenSurface* surface,
+        const QString& contextString, const QString& address)
+{
+    unsigned long long scrapes = 0;
+    auto body = [&]() { return metrics(context, surface, contextString, ++scrapes); };
+
+    if (address.startsWith("unix:")) {
+        QString path = address.mid(5);
+        QLocalServer* server = new QLocalServer;
+        QLocalServer::removeServer(path);
+        if (!server->listen(path)) {
+            fprintf(stderr, "cannot listen on %s: %s\n", qPrintable(path), qPrintable(server->errorString()));
+            return 1;
+        }
+        QObject::connect(server, &QLocalServer::newConnection, [=]() {
+            while (server->hasPendingConnections())
+                serve(server->nextPendingConnection(), body);
+        });
+        fprintf(stderr, "serving metrics on unix:%s\n", qPrintable(server->fullServerName()));
+    } else {
+        int colon = address.lastIndexOf(':');
+        QString host = (colon >= 0 ? address.left(colon) : QString("127.0.0.1"));
+        if (host.startsWith('[') && host.endsWith(']'))
+            host = host.mid(1, host.length() - 2);
+        bool ok;
+        unsigned int port = address.mid(colon + 1).toUInt(&ok);
+        QHostAddress hostAddress = (host == "localhost" ? QHostAddress(QHostAddress::LocalHost) : QHostAddress(host));
+        if (!ok || port > 65535) {
+            fprintf(stderr, "invalid exporter port\n");
+            return 1;
+        }
+        if (!hostAddress.isLoopback()) {
+            fprintf(stderr, "exporter host must be a loopback address\n");
+            return 1;
+        }
+        QTcpServer* server = new QTcpServer;
+        if (!server->listen(hostAddress, port)) {
+            fprintf(stderr, "cannot listen on %s: %s\n", qPrintable(address), qPrintable(server->errorString()));
+            return 1;
+        }
+        QObject::connect(server, &QTcpServer::newConnection, [=]() {
+            while (server->hasPendingConnections())
+                serve(server->nextPendingConnection(), body);
+        });
+        fprintf(stderr, "serving metrics on http://%s:%d/metrics\n",
+                qPrintable(hostAddress.toString()), int(server->serverPort()));
+    }
+    return QGuiApplication::exec();
+}
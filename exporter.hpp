@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef EXPORTER_HPP
+#define EXPORTER_HPP
+
+#include <QString>
+
+class QOpenGLContext;
+class QOffscreenSurface;
+
+/* Serve context information, selected limits and memory counters in the
+ * Prometheus text exposition format via HTTP on the given address until the
+ * process is terminated. The address is either [HOST:]PORT with HOST being a
+ * loopback address (default 127.0.0.1), or unix:PATH for a local socket.
+ * Memory counters are queried anew for each scrape.
+ * Returns the exit code for main(). */
+int runExporter(QOpenGLContext* context, QOffscreenSurface* surface,
+        const QString& contextString, const QString& address);
+
+#endif
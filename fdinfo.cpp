@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstdio>
+
+#include <QDir>
+#include <QFile>
+
+#include "fdinfo.hpp"
+
+static qulonglong parseMemory(const QByteArray& value, bool* ok)
+{
+    QList<QByteArray> parts = value.simplified().split(' ');
+    qulonglong v = parts[0].toULongLong(ok);
+    if (parts.size() > 1) {
+        if (parts[1] == "KiB")
+            v *= 1024;
+        else if (parts[1] == "MiB")
+            v *= 1024 * 1024;
+        else if (parts[1] == "GiB")
+            v *= 1024 * 1024 * 1024;
+        else
+            *ok = false;
+    }
+    return v;
+}
+
+static qulonglong parseFrequency(const QByteArray& value, bool* ok)
+{
+    QList<QByteArray> parts = value.simplified().split(' ');
+    qulonglong v = parts[0].toULongLong(ok);
+    if (parts.size() > 1) {
+        if (parts[1] == "KHz")
+            v *= 1000;
+        else if (parts[1] == "MHz")
+            v *= 1000 * 1000;
+        else if (parts[1] != "Hz")
+            *ok = false;
+    }
+    return v;
+}
+
+bool parseFdInfo(const QByteArray& text, DrmClient& client)
+{
+    static const char* memoryCategories[] = { "memory", "total", "shared", "resident", "purgeable", "active" };
+    client = DrmClient();
+    for (const QByteArray& line : text.split('\n')) {
+        int colon = line.indexOf(':');
+        if (colon < 0 || !line.startsWith("drm-"))
+            continue;
+        QByteArray key = line.left(colon).mid(4);
+        QByteArray value = line.mid(colon + 1).trimmed();
+        bool ok = true;
+        if (key == "driver") {
+            client.driver = value;
+        } else if (key == "pdev") {
+            client.pdev = value;
+        } else if (key == "client-id") {
+            client.clientId = value;
+        } else if (key.startsWith("engine-capacity-")) {
+            client.engineCapacity.insert(key.mid(16), value.toULongLong(&ok));
+        } else if (key.startsWith("engine-")) {
+            // the value is "<uint> ns"
+            client.engineTime.insert(key.mid(7), value.split(' ')[0].toULongLong(&ok));
+        } else if (key.startsWith("cycles-")) {
+            client.engineCycles.insert(key.mid(7), value.toULongLong(&ok));
+        } else if (key.startsWith("total-cycles-")) {
+            // must be checked before the memory category "total"
+            client.engineTotalCycles.insert(key.mid(13), value.toULongLong(&ok));
+        } else if (key.startsWith("maxfreq-")) {
+            client.engineMaxFreq.insert(key.mid(8), parseFrequency(value, &ok));
+        } else if (key.startsWith("curfreq-")) {
+            // not needed
+        } else {
+            for (const char* category : memoryCategories) {
+                QByteArray prefix = QByteArray(category) + '-';
+                if (key.startsWith(prefix)) {
+                    client.memory.insert(key, parseMemory(value, &ok));
+                    break;
+                }
+            }
+        }
+        if (!ok)
+            fprintf(stderr, "fdinfo: cannot parse line '%s'\n", line.constData());
+    }
+    return !client.driver.isEmpty();
+}
+
+QList<DrmClient> readFdInfo()
+{
+    QList<DrmClient> clients;
+    QDir dir("/proc/self/fdinfo");
+    for (const QString& entry : dir.entryList(QDir::Files)) {
+        QFile file(dir.filePath(entry));
+        if (!file.open(QIODevice::ReadOnly))
+            continue;
+        DrmClient client;
+        if (!parseFdInfo(file.readAll(), client))
+            continue;
+        bool duplicate = false;
+        for (const DrmClient& c : clients)
+            if (c.key() == client.key())
+                duplicate = true;
+        if (!duplicate)
+            clients.append(client);
+    }
+    return clients;
+}
+
+bool printFdInfo(const QString& fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        fprintf(stderr, "%s: %s\n", qPrintable(fileName), qPrintable(file.errorString()));
+        return false;
+    }
+    DrmClient client;
+    if (!parseFdInfo(file.readAll(), client)) {
+        fprintf(stderr, "%s: not a DRM client\n", qPrintable(fileName));
+        return false;
+    }
+    printf("Driver:     %s\n", qPrintable(client.driver));
+    printf("PCI device: %s\n", qPrintable(client.pdev));
+    printf("Client ID:  %s\n", qPrintable(client.clientId));
+    printf("Engines:\n");
+    for (auto it = client.engineTime.cbegin(); it != client.engineTime.cend(); ++it)
+        printf("    %-20s %20llu ns  capacity %llu\n", qPrintable(it.key()), it.value(),
+                client.engineCapacity.value(it.key(), 1));
+    for (auto it = client.engineCycles.cbegin(); it != client.engineCycles.cend(); ++it) {
+        printf("    %-20s %20llu cycles  capacity %llu", qPrintable(it.key()), it.value(),
+                client.engineCapacity.value(it.key(), 1));
+        if (client.engineTotalCycles.contains(it.key()))
+            printf("  total %llu", client.engineTotalCycles.value(it.key()));
+        if (client.engineMaxFreq.contains(it.key()))
+            printf("  maxfreq %llu Hz", client.engineMaxFreq.value(it.key()));
+        printf("\n");
+    }
+    printf("Memory:\n");
+    for (auto it = client.memory.cbegin(); it != client.memory.cend(); ++it)
+        printf("    %-20s %20llu bytes\n", qPrintable(it.key()), it.value());
+    return true;
+}
+
+void FdInfoProbe::begin()
+{
+    _clients = readFdInfo();
+    _timer.start();
+}
+
+void FdInfoProbe::end(Result& result)
+{
+    double ns = _timer.nsecsElapsed();
+    QList<DrmClient> clients = readFdInfo();
+    for (const DrmClient& c : clients) {
+        // Only name the client if there is more than one, e.g. with multiple GPUs
+        QString prefix = "drm ";
+        if (clients.size() > 1)
+            prefix += c.driver + ' ' + c.pdev + ' ';
+        const DrmClient* before = nullptr;
+        for (const DrmClient& b : _clients)
+            if (b.key() == c.key())
+                before = &b;
+        if (before) {
+            for (auto it = c.engineTime.cbegin(); it != c.engineTime.cend(); ++it) {
+                qulonglong t0 = before->engineTime.value(it.key(), it.value());
+                qulonglong capacity = c.engineCapacity.value(it.key(), 1);
+                double busy = (it.value() > t0 ? it.value() - t0 : 0) / (ns * capacity);
+                result.add(prefix + "engine " + it.key() + " busy", 100.0 * busy, "%");
+            }
+            // Engines that report cycles: relative to the total cycles of the
+            // engine if available (e.g. xe), otherwise to its maximum frequency
+            for (auto it = c.engineCycles.cbegin(); it != c.engineCycles.cend(); ++it) {
+                if (c.engineTime.contains(it.key()))
+                    continue;
+                qulonglong c0 = before->engineCycles.value(it.key(), it.value());
+                qulonglong capacity = c.engineCapacity.value(it.key(), 1);
+                double cycles = (it.value() > c0 ? it.value() - c0 : 0);
+                double total;
+                if (c.engineTotalCycles.contains(it.key())) {
+                    qulonglong t1 = c.engineTotalCycles.value(it.key());
+                    qulonglong t0 = before->engineTotalCycles.value(it.key(), t1);
+                    total = (t1 > t0 ? t1 - t0 : 0);
+                } else if (c.engineMaxFreq.contains(it.key())) {
+                    total = c.engineMaxFreq.value(it.key()) * ns / 1e9;
+                } else {
+                    continue;
+                }
+                if (total > 0.0)
+                    result.add(prefix + "engine " + it.key() + " busy", 100.0 * cycles / (total * capacity), "%");
+            }
+        }
+        for (auto it = c.memory.cbegin(); it != c.memory.cend(); ++it) {
+            if (it.key().startsWith("memory-") || it.key().startsWith("resident-") || it.key().startsWith("total-"))
+                result.add(prefix + it.key(), it.value() / (1024.0 * 1024.0), "MiB");
+        }
+    }
+}
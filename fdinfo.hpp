@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FDINFO_HPP
+#define FDINFO_HPP
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QList>
+#include <QMap>
+#include <QString>
+
+#include "benchmark.hpp"
+
+/* The DRM client usage statistics of one DRM file description, as reported by
+ * the kernel in /proc/<pid>/fdinfo/<fd>. See the kernel documentation
+ * Documentation/gpu/drm-usage-stats.rst for the format. */
+class DrmClient
+{
+public:
+    QString driver;                               // drm-driver
+    QString pdev;                                 // drm-pdev
+    QString clientId;                             // drm-client-id
+    QMap<QString, qulonglong> engineTime;         // drm-engine-<engine>, in ns
+    QMap<QString, qulonglong> engineCapacity;     // drm-engine-capacity-<engine>
+    QMap<QString, qulonglong> engineCycles;       // drm-cycles-<engine>
+    QMap<QString, qulonglong> engineTotalCycles;  // drm-total-cycles-<engine>
+    QMap<QString, qulonglong> engineMaxFreq;      // drm-maxfreq-<engine>, in Hz
+    QMap<QString, qulonglong> memory;             // drm-<category>-<region>, in bytes; key is "<category>-<region>"
+
+    // Identifies the client; several file descriptors can refer to the same one
+    QString key() const { return driver + ' ' + pdev + ' ' + clientId; }
+};
+
+/* Parse fdinfo text. Returns false if it does not describe a DRM client. */
+bool parseFdInfo(const QByteArray& text, DrmClient& client);
+
+/* Read the DRM clients of this process from /proc/self/fdinfo */
+QList<DrmClient> readFdInfo();
+
+/* Print a parsed fdinfo file, for checking the parser against recorded files */
+bool printFdInfo(const QString& fileName);
+
+/* A probe that reports per-engine busy percentages and memory residency */
+class FdInfoProbe : public Probe
+{
+private:
+    QList<DrmClient> _clients;
+    QElapsedTimer _timer;
+
+public:
+    void begin() override;
+    void end(Result& result) override;
+};
+
+#endif
@@ -31,12 +31,18 @@
 #include <QOpenGLExtraFunctions>
 #include <QSet>
 
-#ifndef GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX
-# define GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX 0x9047
-#endif
-#ifndef TEXTURE_FREE_MEMORY_ATI
-# define TEXTURE_FREE_MEMORY_ATI 0x87FC
-#endif
+#include "glinf.hpp"
+#include "exporter.hpp"
+#include "benchmark.hpp"
+#include "fdinfo.hpp"
+#include "perf.hpp"
+#include "alloc.hpp"
+#include "gpucounters.hpp"
+#include "pipelinestats.hpp"
+#include "debugmessages.hpp"
+#include "workload.hpp"
+#include "replay.hpp"
+#include "report.hpp"
 
 int getI(QOpenGLExtraFunctions* gl, GLenum p)
 {
@@ -50,6 +56,26 @@ const char* getS(QOpenGLExtraFunctions* gl, GLenum p)
     return reinterpret_cast<const char*>(gl->glGetString(p));
 }
 
+MemInfo getMemInfo(QOpenGLExtraFunctions* gl)
+{
+    MemInfo m = {};
+    gl->glGetIntegerv(GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX, &m.dedicated);
+    if (m.dedicated != 0) {
+        gl->glGetIntegerv(GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX, &m.totalAvailable);
+        gl->glGetIntegerv(GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &m.currentAvailable);
+        gl->glGetIntegerv(GPU_MEMORY_INFO_EVICTION_COUNT_NVX, &m.evictionCount);
+        gl->glGetIntegerv(GPU_MEMORY_INFO_EVICTED_MEMORY_NVX, &m.evicted);
+    } else {
+        gl->glGetIntegerv(TEXTURE_FREE_MEMORY_ATI, m.textureFree);
+        if (m.textureFree[0] != 0) {
+            gl->glGetIntegerv(VBO_FREE_MEMORY_ATI, m.vboFree);
+            gl->glGetIntegerv(RENDERBUFFER_FREE_MEMORY_ATI, m.renderbufferFree);
+        }
+    }
+    gl->glGetError(); // clear error state as the above might not be supported
+    return m;
+}
+
 int main(int argc, char* argv[])
 {
     QGuiApplication app(argc, argv);
@@ -62,9 +88,60 @@ int main(int argc, char* argv[])
             { { "t", "type" }, "Select context type: 'opengl' or 'opengles'.", "type" },
             { { "p", "profile" }, "Select context profile: 'core' or 'compat'.", "profile" },
             { { "v", "version" }, "Select context version: MAJOR.MINOR.", "version" },
-            { { "e", "extensions" }, "List supported extensions." }
+            { { "e", "extensions" }, "List supported extensions." },
+            { "exporter", "Keep running and serve metrics in Prometheus text format on ADDRESS: "
+                "[HOST:]PORT on a loopback interface, or unix:PATH for a local socket.", "address" },
+            { { "b", "benchmark" }, "Run benchmark NAME; may be given multiple times, "
+                "as a comma-separated list, or as 'all'.", "name" },
+            { "list-benchmarks", "List available benchmarks." },
+            { "benchmark-time", "Minimum duration of each measurement in seconds (default 0.25).", "seconds" },
+            { "fdinfo", "Report DRM engine utilization and memory residency from /proc/self/fdinfo for each measurement; "
+                "runs the 'scenes' benchmark unless -b is given." },
+            { "fdinfo-file", "Parse and print a recorded DRM fdinfo file, then exit.", "file" },
+            { "perf", "Report CPU performance counters for context creation and for each measurement (Linux only)." },
+            { "alloc", "Count heap allocations during context creation, limit queries, and each measurement (glibc only)." },
+            { "gpu-counters", "List vendor GPU performance counters (AMD_performance_monitor or INTEL_performance_query)." },
+            { "gpu-counter", "Sample vendor GPU performance counter GROUP/NAME, or all counters of GROUP, "
+                "for each measurement; may be given multiple times. Runs the 'scenes' benchmark unless -b is given.", "counter" },
+            { "pipeline-statistics", "Report pipeline statistics (vertex, primitive, and shader invocation counts, "
+                "overdraw, culling) for each measurement; runs the 'scenes' benchmark unless -b is given." },
+            { "debug-context", "Create a debug context and report the driver's performance messages (KHR_debug) "
+                "for each measurement; runs the 'scenes' benchmark unless -b is given." },
+            { "workload", "Run the workload described in FILE; may be given multiple times.", "file" },
+            { "replay", "Replay the trace recorded with glinf-interpose in FILE and report frame times; "
+                "may be given multiple times.", "file" },
+            { "replay-paced", "Replay traces with their recorded frame pacing instead of as fast as possible." },
+            { "json", "Write context information and benchmark results to FILE in JSON format.", "file" },
+            { "report", "Generate an HTML report from the JSON result files given as arguments, "
+                "comparing them to the first one, then exit." },
+            { { "o", "output" }, "Write the report to FILE instead of standard output.", "file" }
     });
+    parser.addPositionalArgument("files", "JSON result files for --report.", "[files...]");
     parser.process(app);
+    if (parser.isSet("list-benchmarks")) {
+        printf("Benchmarks:\n");
+        listBenchmarks();
+        return 0;
+    }
+    if (parser.isSet("fdinfo-file")) {
+        return printFdInfo(parser.value("fdinfo-file")) ? 0 : 1;
+    }
+    if (parser.isSet("report")) {
+        return writeReport(parser.positionalArguments(), parser.value("output")) ? 0 : 1;
+    }
+    double benchmarkTime = 0.25;
+    if (parser.isSet("alloc") && !allocCountingAvailable()) {
+        fprintf(stderr, "heap allocation counting is not available\n");
+        return 1;
+    }
+    if (parser.isSet("benchmark-time")) {
+        bool ok;
+        benchmarkTime = parser.value("benchmark-time").toDouble(&ok);
+        if (!ok || benchmarkTime <= 0.0) {
+            fprintf(stderr, "invalid benchmark time\n");
+            return 1;
+        }
+    }
     QSurfaceFormat format;
     if (parser.isSet("type")) {
         if (parser.value("type").compare("opengl", Qt::CaseInsensitive) == 0) {
@@ -88,6 +165,8 @@ int main(int argc, char* argv[])
             return 1;
         }
     }
+    if (parser.isSet("debug-context"))
+        format.setOption(QSurfaceFormat::DebugContext);
     int tryMajorMax = 4;
     int tryMinorMax = 9;
     int tryMajorMin = 3;
@@ -109,6 +188,11 @@ int main(int argc, char* argv[])
     }
 
     /* Initialize OpenGL context */
+    PerfCounters contextCreationCounters;
+    if (parser.isSet("perf") && !contextCreationCounters.start())
+        fprintf(stderr, "no CPU performance counters available\n");
+    if (parser.isSet("alloc"))
+        allocCountingStart();
     QOffscreenSurface* surface = nullptr;
     QOpenGLContext* context = nullptr;
     int tryMajor = tryMajorMax;
@@ -157,6 +241,8 @@ int main(int argc, char* argv[])
         return 1;
     }
     QOpenGLExtraFunctions* gl = context->extraFunctions();
+    contextCreationCounters.stop();
+    AllocCounts contextCreationAllocs = allocCountingStop();
 
     /* Print general info */
     QString contextString = context->isOpenGLES() ? "OpenGLES" : "OpenGL";
@@ -175,17 +261,26 @@ int main(int argc, char* argv[])
     printf("SL Version: %s\n", getS(gl, GL_SHADING_LANGUAGE_VERSION));
     printf("Vendor:     %s\n", getS(gl, GL_VENDOR));
     printf("Renderer:   %s\n", getS(gl, GL_RENDERER));
+    if (parser.isSet("perf") || parser.isSet("alloc")) {
+        printf("Context creation:\n");
+        for (int c = 0; c < PerfCounters::CounterCount; c++) {
+            PerfCounters::Counter counter = static_cast<PerfCounters::Counter>(c);
+            if (contextCreationCounters.available[c])
+                printf("    %-18s %llu\n", PerfCounters::name(counter), contextCreationCounters.values[c]);
+        }
+        if (parser.isSet("alloc")) {
+            printf("    %-18s %llu\n", "heap allocations", contextCreationAllocs.allocations);
+            printf("    %-18s %llu\n", "heap bytes", contextCreationAllocs.bytes);
+        }
+    }
 
     /* Print memory information (may be unknown) */
-    GLint meminfo[4] = { 0, 0, 0, 0 };
-    gl->glGetIntegerv(GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX, meminfo);
-    if (meminfo[0] == 0)
-        gl->glGetIntegerv(TEXTURE_FREE_MEMORY_ATI, meminfo);
-    gl->glGetError(); // clear error state as the above might not be supported
-    printf("Memory:     %s\n", meminfo[0] == 0 ? "unknown"
-            : meminfo[0] > 1024 * 1024 ? qPrintable(QString("%1 GiB").arg(meminfo[0] / (1024.0f * 1024.0f)))
-            : meminfo[0] > 1024        ? qPrintable(QString("%1 MiB").arg(meminfo[0] / 1024.0f))
-            :                            qPrintable(QString("%1 KiB").arg(meminfo[0])));
+    MemInfo memInfo = getMemInfo(gl);
+    GLint mem = (memInfo.dedicated != 0 ? memInfo.dedicated : memInfo.textureFree[0]);
+    printf("Memory:     %s\n", mem == 0 ? "unknown"
+            : mem > 1024 * 1024 ? qPrintable(QString("%1 GiB").arg(mem / (1024.0f * 1024.0f)))
+            : mem > 1024        ? qPrintable(QString("%1 MiB").arg(mem / 1024.0f))
+            :                     qPrintable(QString("%1 KiB").arg(mem)));
 
     /* Print extensions */
     if (parser.isSet("extensions")) {
@@ -201,6 +296,8 @@ int main(int argc, char* argv[])
     }
 
     /* Print implementation-defined limitations */
+    if (parser.isSet("alloc"))
+        allocCountingStart();
     printf("Resource limitations:\n");
     printf("  Texture limits:\n");
     printf("    1D / 2D size: %5d  GL_MAX_TEXTURE_SIZE\n", getI(gl, GL_MAX_TEXTURE_SIZE));
@@ -212,6 +309,20 @@ int main(int argc, char* argv[])
     printf("    Height:       %5d  GL_MAX_FRAMEBUFFER_HEIGHT\n", getI(gl, GL_MAX_FRAMEBUFFER_HEIGHT));
     printf("    Color Attach.:%5d  GL_MAX_COLOR_ATTACHMENTS\n", getI(gl, GL_MAX_COLOR_ATTACHMENTS));
     printf("    Draw buffers: %5d  GL_MAX_DRAW_BUFFERS\n", getI(gl, GL_MAX_DRAW_BUFFERS));
+    bool viewportArray = !context->isOpenGLES() || context->hasExtension("GL_OES_viewport_array");
+    bool multiview = context->hasExtension("GL_OVR_multiview");
+    if (viewportArray || multiview)
+        printf("  Viewport and multiview limits:\n");
+    if (viewportArray)
+        printf("    Viewports:    %5d  GL_MAX_VIEWPORTS\n", getI(gl, GL_MAX_VIEWPORTS));
+    if (multiview)
+        printf("    Views:        %5d  GL_MAX_VIEWS_OVR\n", getI(gl, GL_MAX_VIEWS_OVR));
+    printf("  Transform feedback limits:\n");
+    if (!context->isOpenGLES())
+        printf("    Buffers:      %5d  GL_MAX_TRANSFORM_FEEDBACK_BUFFERS\n", getI(gl, GL_MAX_TRANSFORM_FEEDBACK_BUFFERS));
+    printf("    Interl. comp.:%5d  GL_MAX_TRANSFORM_FEEDBACK_INTERLEAVED_COMPONENTS\n", getI(gl, GL_MAX_TRANSFORM_FEEDBACK_INTERLEAVED_COMPONENTS));
+    printf("    Sep. attribs: %5d  GL_MAX_TRANSFORM_FEEDBACK_SEPARATE_ATTRIBS\n", getI(gl, GL_MAX_TRANSFORM_FEEDBACK_SEPARATE_ATTRIBS));
+    printf("    Sep. comp.:   %5d  GL_MAX_TRANSFORM_FEEDBACK_SEPARATE_COMPONENTS\n", getI(gl, GL_MAX_TRANSFORM_FEEDBACK_SEPARATE_COMPONENTS));
     printf("  Maximum number of uniform components in shader stage:\n");
     printf("    Vertex:       %5d  GL_MAX_VERTEX_UNIFORM_COMPONENTS\n", getI(gl, GL_MAX_VERTEX_UNIFORM_COMPONENTS));
     printf("    Tess. Ctrl.:  %5d  GL_MAX_TESS_CONTROL_UNIFORM_COMPONENTS\n", getI(gl, GL_MAX_TESS_CONTROL_UNIFORM_COMPONENTS));
@@ -241,6 +352,98 @@ int main(int argc, char* argv[])
     printf("    Fragment:     %5d  GL_MAX_TEXTURE_IMAGE_UNITS\n", getI(gl, GL_MAX_TEXTURE_IMAGE_UNITS));
     printf("    Compute:      %5d  GL_MAX_COMPUTE_TEXTURE_IMAGE_UNITS\n", getI(gl, GL_MAX_COMPUTE_TEXTURE_IMAGE_UNITS));
     printf("    Combined:     %5d  GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS\n", getI(gl, GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS));
+    // Not all limits exist in all context types; do not leave their errors
+    // pending for the benchmarks
+    for (int i = 0; i < 16 && gl->glGetError() != GL_NO_ERROR; i++)
+        ;
+    if (parser.isSet("alloc")) {
+        AllocCounts limitQueryAllocs = allocCountingStop();
+        printf("  Heap usage of the limit queries above:\n");
+        printf("    Allocations:  %5llu\n", limitQueryAllocs.allocations);
+        printf("    Bytes:        %5llu\n", limitQueryAllocs.bytes);
+    }
+
+    /* Print vendor performance counters */
+    if (parser.isSet("gpu-counters")) {
+        GpuCounters gpuCounters(context);
+        gpuCounters.list();
+    }
+
+    /* Run benchmarks */
+    QList<Result> results;
+    if (parser.isSet("benchmark") || parser.isSet("pipeline-statistics")
+            || parser.isSet("fdinfo") || parser.isSet("debug-context") || parser.isSet("gpu-counter")
+            || parser.isSet("workload") || parser.isSet("replay")) {
+        Bench bench(context);
+        bench.minTime = benchmarkTime;
+        FdInfoProbe fdInfoProbe;
+        if (parser.isSet("fdinfo")) {
+            if (readFdInfo().isEmpty())
+                fprintf(stderr, "no DRM clients found in /proc/self/fdinfo\n");
+            bench.probes.append(&fdInfoProbe);
+        }
+        PerfProbe perfProbe;
+        if (parser.isSet("perf"))
+            bench.probes.append(&perfProbe);
+        GpuCounters gpuCounters(context);
+        if (parser.isSet("gpu-counter")) {
+            if (!gpuCounters.extension()) {
+                fprintf(stderr, "no GPU performance counters available\n");
+                return 1;
+            }
+            if (!gpuCounters.select(parser.values("gpu-counter")))
+                return 1;
+            bench.probes.append(&gpuCounters);
+        }
+        PipelineStatisticsProbe pipelineStatisticsProbe(context);
+        if (parser.isSet("pipeline-statistics")) {
+            if (!PipelineStatisticsProbe::isAvailable(context)) {
+                fprintf(stderr, "pipeline statistics queries are not available\n");
+                return 1;
+            }
+            bench.probes.append(&pipelineStatisticsProbe);
+        }
+        DebugMessageProbe debugMessageProbe;
+        if (parser.isSet("debug-context")) {
+            if (!debugMessageProbe.initialize()) {
+                fprintf(stderr, "debug output (KHR_debug) is not available\n");
+                return 1;
+            }
+            bench.probes.append(&debugMessageProbe);
+        }
+        AllocProbe allocProbe;
+        if (parser.isSet("alloc"))
+            bench.probes.append(&allocProbe);
+        QStringList benchmarkNames = parser.values("benchmark");
+        if (benchmarkNames.isEmpty() && !parser.isSet("workload") && !parser.isSet("replay"))
+            benchmarkNames.append("scenes");
+        if (!benchmarkNames.isEmpty() && !runBenchmarks(bench, benchmarkNames))
+            return 1;
+        for (const QString& fileName : parser.values("workload"))
+            if (!runWorkload(bench, fileName))
+                return 1;
+        for (const QString& fileName : parser.values("replay"))
+            if (!replayTrace(bench, fileName, parser.isSet("replay-paced")))
+                return 1;
+        bench.flush();
+        results = bench.results();
+    }
+    if (parser.isSet("json")) {
+        QJsonObject contextInfo {
+            { "context", contextString },
+            { "version", getS(gl, GL_VERSION) },
+            { "glsl-version", getS(gl, GL_SHADING_LANGUAGE_VERSION) },
+            { "vendor", getS(gl, GL_VENDOR) },
+            { "renderer", getS(gl, GL_RENDERER) } };
+        if (!writeResults(parser.value("json"), contextInfo, results))
+            return 1;
+    }
+
+    /* Serve metrics until terminated */
+    if (parser.isSet("exporter")) {
+        fflush(stdout);
+        return runExporter(context, surface, contextString, parser.value("exporter"));
+    }
 
     return 0;
 }
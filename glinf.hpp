@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GLINF_HPP
+#define GLINF_HPP
+
+#include <QOpenGLExtraFunctions>
+
+#ifndef GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX
+# define GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX 0x9047
+#endif
+#ifndef GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX
+# define GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX 0x9048
+#endif
+#ifndef GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX
+# define GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX 0x9049
+#endif
+#ifndef GPU_MEMORY_INFO_EVICTION_COUNT_NVX
+# define GPU_MEMORY_INFO_EVICTION_COUNT_NVX 0x904A
+#endif
+#ifndef GPU_MEMORY_INFO_EVICTED_MEMORY_NVX
+# define GPU_MEMORY_INFO_EVICTED_MEMORY_NVX 0x904B
+#endif
+#ifndef VBO_FREE_MEMORY_ATI
+# define VBO_FREE_MEMORY_ATI 0x87FB
+#endif
+#ifndef TEXTURE_FREE_MEMORY_ATI
+# define TEXTURE_FREE_MEMORY_ATI 0x87FC
+#endif
+#ifndef RENDERBUFFER_FREE_MEMORY_ATI
+# define RENDERBUFFER_FREE_MEMORY_ATI 0x87FD
+#endif
+#ifndef GL_MAX_VIEWPORTS
+# define GL_MAX_VIEWPORTS 0x825B
+#endif
+#ifndef GL_MAX_VIEWS_OVR
+# define GL_MAX_VIEWS_OVR 0x9631
+#endif
+#ifndef GL_MAX_TRANSFORM_FEEDBACK_BUFFERS
+# define GL_MAX_TRANSFORM_FEEDBACK_BUFFERS 0x8E70
+#endif
+
+int getI(QOpenGLExtraFunctions* gl, GLenum p);
+const char* getS(QOpenGLExtraFunctions* gl, GLenum p);
+
+/* Memory information from GL_NVX_gpu_memory_info or GL_ATI_meminfo.
+ * All sizes are in KiB. Values that the implementation does not report are 0. */
+struct MemInfo
+{
+    GLint dedicated;            // NVX: dedicated video memory
+    GLint totalAvailable;       // NVX: total available memory
+    GLint currentAvailable;     // NVX: currently available video memory
+    GLint evictionCount;        // NVX: number of evictions
+    GLint evicted;              // NVX: size of evicted memory
+    GLint textureFree[4];       // ATI: free memory in the texture pool
+    GLint vboFree[4];           // ATI: free memory in the VBO pool
+    GLint renderbufferFree[4];  // ATI: free memory in the renderbuffer pool
+};
+
+MemInfo getMemInfo(QOpenGLExtraFunctions* gl);
+
+#endif
@@ -0,0 +1,336 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#include <QOpenGLContext>
+
+#include "gpucounters.hpp"
+
+#ifndef GL_COUNTER_TYPE_AMD
+# define GL_COUNTER_TYPE_AMD 0x8BC0
+# define GL_PERCENTAGE_AMD 0x8BC3
+# define GL_UNSIGNED_INT64_AMD 0x8BC2
+# define GL_PERFMON_RESULT_AVAILABLE_AMD 0x8BC4
+# define GL_PERFMON_RESULT_SIZE_AMD 0x8BC5
+# define GL_PERFMON_RESULT_AMD 0x8BC6
+#endif
+#ifndef GL_PERFQUERY_WAIT_INTEL
+# define GL_PERFQUERY_WAIT_INTEL 0x83FB
+# define GL_PERFQUERY_COUNTER_EVENT_INTEL 0x94F0
+# define GL_PERFQUERY_COUNTER_RAW_INTEL 0x94F4
+# define GL_PERFQUERY_COUNTER_DATA_UINT32_INTEL 0x94F8
+# define GL_PERFQUERY_COUNTER_DATA_UINT64_INTEL 0x94F9
+# define GL_PERFQUERY_COUNTER_DATA_FLOAT_INTEL 0x94FA
+# define GL_PERFQUERY_COUNTER_DATA_DOUBLE_INTEL 0x94FB
+# define GL_PERFQUERY_COUNTER_DATA_BOOL32_INTEL 0x94FC
+#endif
+
+typedef void (QOPENGLF_APIENTRYP GetPerfMonitorGroupsAMD)(GLint* numGroups, GLsizei groupsSize, GLuint* groups);
+typedef void (QOPENGLF_APIENTRYP GetPerfMonitorCountersAMD)(GLuint group, GLint* numCounters, GLint* maxActiveCounters, GLsizei counterSize, GLuint* counters);
+typedef void (QOPENGLF_APIENTRYP GetPerfMonitorGroupStringAMD)(GLuint group, GLsizei bufSize, GLsizei* length, GLchar* groupString);
+typedef void (QOPENGLF_APIENTRYP GetPerfMonitorCounterStringAMD)(GLuint group, GLuint counter, GLsizei bufSize, GLsizei* length, GLchar* counterString);
+typedef void (QOPENGLF_APIENTRYP GetPerfMonitorCounterInfoAMD)(GLuint group, GLuint counter, GLenum pname, void* data);
+typedef void (QOPENGLF_APIENTRYP GenPerfMonitorsAMD)(GLsizei n, GLuint* monitors);
+typedef void (QOPENGLF_APIENTRYP DeletePerfMonitorsAMD)(GLsizei n, GLuint* monitors);
+typedef void (QOPENGLF_APIENTRYP SelectPerfMonitorCountersAMD)(GLuint monitor, GLboolean enable, GLuint group, GLint numCounters, GLuint* counterList);
+typedef void (QOPENGLF_APIENTRYP BeginPerfMonitorAMD)(GLuint monitor);
+typedef void (QOPENGLF_APIENTRYP EndPerfMonitorAMD)(GLuint monitor);
+typedef void (QOPENGLF_APIENTRYP GetPerfMonitorCounterDataAMD)(GLuint monitor, GLenum pname, GLsizei dataSize, GLuint* data, GLint* bytesWritten);
+
+typedef void (QOPENGLF_APIENTRYP GetFirstPerfQueryIdINTEL)(GLuint* queryId);
+typedef void (QOPENGLF_APIENTRYP GetNextPerfQueryIdINTEL)(GLuint queryId, GLuint* nextQueryId);
+typedef void (QOPENGLF_APIENTRYP GetPerfQueryInfoINTEL)(GLuint queryId, GLuint queryNameLength, GLchar* queryName, GLuint* dataSize, GLuint* noCounters, GLuint* noInstances, GLuint* capsMask);
+typedef void (QOPENGLF_APIENTRYP GetPerfCounterInfoINTEL)(GLuint queryId, GLuint counterId, GLuint counterNameLength, GLchar* counterName, GLuint counterDescLength, GLchar* counterDesc, GLuint* counterOffset, GLuint* counterDataSize, GLuint* counterTypeEnum, GLuint* counterDataTypeEnum, GLuint64* rawCounterMaxValue);
+typedef void (QOPENGLF_APIENTRYP CreatePerfQueryINTEL)(GLuint queryId, GLuint* queryHandle);
+typedef void (QOPENGLF_APIENTRYP DeletePerfQueryINTEL)(GLuint queryHandle);
+typedef void (QOPENGLF_APIENTRYP BeginPerfQueryINTEL)(GLuint queryHandle);
+typedef void (QOPENGLF_APIENTRYP EndPerfQueryINTEL)(GLuint queryHandle);
+typedef void (QOPENGLF_APIENTRYP GetPerfQueryDataINTEL)(GLuint queryHandle, GLuint flags, GLsizei dataSize, void* data, GLuint* bytesWritten);
+
+template<typename T> static T proc(QOpenGLContext* context, const char* name)
+{
+    return reinterpret_cast<T>(context->getProcAddress(name));
+}
+
+GpuCounters::GpuCounters(QOpenGLContext* context) :
+    _context(context),
+    _amd(context->hasExtension("GL_AMD_performance_monitor")),
+    _intel(!_amd && context->hasExtension("GL_INTEL_performance_query")),
+    _monitor(0), _query(0), _queryDataSize(0)
+{
+}
+
+GpuCounters::~GpuCounters()
+{
+    if (_monitor)
+        proc<DeletePerfMonitorsAMD>(_context, "glDeletePerfMonitorsAMD")(1, &_monitor);
+    if (_query)
+        proc<DeletePerfQueryINTEL>(_context, "glDeletePerfQueryINTEL")(_query);
+}
+
+const char* GpuCounters::extension() const
+{
+    return _amd ? "GL_AMD_performance_monitor" : _intel ? "GL_INTEL_performance_query" : nullptr;
+}
+
+void GpuCounters::enumerate()
+{
+    if (!counters.isEmpty())
+        return;
+    if (_amd)
+        enumerateAMD();
+    else if (_intel)
+        enumerateIntel();
+}
+
+void GpuCounters::enumerateAMD()
+{
+    auto getGroups = proc<GetPerfMonitorGroupsAMD>(_context, "glGetPerfMonitorGroupsAMD");
+    auto getCounters = proc<GetPerfMonitorCountersAMD>(_context, "glGetPerfMonitorCountersAMD");
+    auto getGroupString = proc<GetPerfMonitorGroupStringAMD>(_context, "glGetPerfMonitorGroupStringAMD");
+    auto getCounterString = proc<GetPerfMonitorCounterStringAMD>(_context, "glGetPerfMonitorCounterStringAMD");
+    auto getCounterInfo = proc<GetPerfMonitorCounterInfoAMD>(_context, "glGetPerfMonitorCounterInfoAMD");
+
+    GLint numGroups = 0;
+    getGroups(&numGroups, 0, nullptr);
+    std::vector<GLuint> groups(numGroups);
+    getGroups(nullptr, numGroups, groups.data());
+    for (GLuint g : groups) {
+        char groupName[256] = "";
+        getGroupString(g, sizeof(groupName), nullptr, groupName);
+        GLint numCounters = 0, maxActive = 0;
+        getCounters(g, &numCounters, &maxActive, 0, nullptr);
+        std::vector<GLuint> ids(numCounters);
+        getCounters(g, nullptr, nullptr, numCounters, ids.data());
+        for (GLuint id : ids) {
+            char counterName[256] = "";
+            getCounterString(g, id, sizeof(counterName), nullptr, counterName);
+            GLenum type = 0;
+            getCounterInfo(g, id, GL_COUNTER_TYPE_AMD, &type);
+            counters.append({ groupName, counterName, QString(), g, id, type, type == GL_PERCENTAGE_AMD, 0 });
+        }
+    }
+}
+
+void GpuCounters::enumerateIntel()
+{
+    auto getFirst = proc<GetFirstPerfQueryIdINTEL>(_context, "glGetFirstPerfQueryIdINTEL");
+    auto getNext = proc<GetNextPerfQueryIdINTEL>(_context, "glGetNextPerfQueryIdINTEL");
+    auto getQueryInfo = proc<GetPerfQueryInfoINTEL>(_context, "glGetPerfQueryInfoINTEL");
+    auto getCounterInfo = proc<GetPerfCounterInfoINTEL>(_context, "glGetPerfCounterInfoINTEL");
+
+    GLuint q = 0;
+    for (getFirst(&q); q != 0; getNext(q, &q)) {
+        char queryName[256] = "";
+        GLuint dataSize = 0, numCounters = 0, numInstances = 0, caps = 0;
+        getQueryInfo(q, sizeof(queryName), queryName, &dataSize, &numCounters, &numInstances, &caps);
+        // counter ids start at 1
+        for (GLuint c = 1; c <= numCounters; c++) {
+            char counterName[256] = "";
+            char counterDesc[1024] = "";
+            GLuint offset = 0, size = 0, type = 0, dataType = 0;
+            GLuint64 maxValue = 0;
+            getCounterInfo(q, c, sizeof(counterName), counterName, sizeof(counterDesc), counterDesc,
+                    &offset, &size, &type, &dataType, &maxValue);
+            bool normalized = (type != GL_PERFQUERY_COUNTER_EVENT_INTEL && type != GL_PERFQUERY_COUNTER_RAW_INTEL);
+            counters.append({ queryName, counterName, counterDesc, q, c, dataType, normalized, offset });
+        }
+    }
+}
+
+void GpuCounters::list()
+{
+    if (!extension()) {
+        printf("GPU performance counters: none\n");
+        return;
+    }
+    enumerate();
+    printf("GPU performance counters (%s):\n", extension());
+    QString group;
+    for (const Counter& c : counters) {
+        if (c.group != group || &c == &counters.first()) {
+            printf("  %s:\n", qPrintable(c.group));
+            group = c.group;
+        }
+        if (c.description.isEmpty())
+            printf("    %s\n", qPrintable(c.name));
+        else
+            printf("    %-40s %s\n", qPrintable(c.name), qPrintable(c.description));
+    }
+}
+
+bool GpuCounters::select(const QStringList& selections)
+{
+    enumerate();
+    _selected.clear();
+    for (const QString& s : selections) {
+        int slash = s.indexOf('/');
+        QString group = (slash < 0 ? s : s.left(slash));
+        QString name = (slash < 0 ? QString() : s.mid(slash + 1));
+        bool found = false;
+        for (const Counter& c : counters) {
+            if (c.group == group && (name.isEmpty() || name == "*" || c.name == name)) {
+                _selected.append(c);
+                found = true;
+            }
+        }
+        if (!found) {
+            fprintf(stderr, "unknown GPU performance counter %s\n", qPrintable(s));
+            return false;
+        }
+    }
+    if (_selected.isEmpty())
+        return true;
+
+    if (_amd) {
+        // clear earlier errors so that only those of the selection are checked
+        for (int i = 0; i < 16 && _context->extraFunctions()->glGetError() != GL_NO_ERROR; i++)
+            ;
+        proc<GenPerfMonitorsAMD>(_context, "glGenPerfMonitorsAMD")(1, &_monitor);
+        auto selectCounters = proc<SelectPerfMonitorCountersAMD>(_context, "glSelectPerfMonitorCountersAMD");
+        for (Counter& c : _selected)
+            selectCounters(_monitor, GL_TRUE, c.groupId, 1, &c.counterId);
+        if (_context->extraFunctions()->glGetError() != GL_NO_ERROR) {
+            fprintf(stderr, "cannot select these GPU performance counters; too many in one group?\n");
+            return false;
+        }
+    } else {
+        // Only one query can be active at a time
+        for (const Counter& c : _selected) {
+            if (c.groupId != _selected.first().groupId) {
+                fprintf(stderr, "GPU performance counters must all be from the same query\n");
+                return false;
+            }
+        }
+        GLuint dataSize = 0, numCounters = 0, numInstances = 0, caps = 0;
+        proc<GetPerfQueryInfoINTEL>(_context, "glGetPerfQueryInfoINTEL")(_selected.first().groupId,
+                0, nullptr, &dataSize, &numCounters, &numInstances, &caps);
+        _queryDataSize = dataSize;
+        proc<CreatePerfQueryINTEL>(_context, "glCreatePerfQueryINTEL")(_selected.first().groupId, &_query);
+        if (!_query) {
+            fprintf(stderr, "cannot create GPU performance query\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+void GpuCounters::begin()
+{
+    if (_monitor)
+        proc<BeginPerfMonitorAMD>(_context, "glBeginPerfMonitorAMD")(_monitor);
+    else if (_query)
+        proc<BeginPerfQueryINTEL>(_context, "glBeginPerfQueryINTEL")(_query);
+}
+
+void GpuCounters::end(Result& result)
+{
+    QList<double> values;
+    if (_monitor) {
+        proc<EndPerfMonitorAMD>(_context, "glEndPerfMonitorAMD")(_monitor);
+        auto getData = proc<GetPerfMonitorCounterDataAMD>(_context, "glGetPerfMonitorCounterDataAMD");
+        GLuint available = 0;
+        while (!available)
+            getData(_monitor, GL_PERFMON_RESULT_AVAILABLE_AMD, sizeof(available), &available, nullptr);
+        GLuint size = 0;
+        getData(_monitor, GL_PERFMON_RESULT_SIZE_AMD, sizeof(size), &size, nullptr);
+        std::vector<GLuint> data(size / sizeof(GLuint));
+        GLint written = 0;
+        getData(_monitor, GL_PERFMON_RESULT_AMD, size, data.data(), &written);
+        // The result is a sequence of group id, counter id, value; the size
+        // of the value depends on the counter type
+        QList<Counter> sampled;
+        QList<double> sampledValues;
+        size_t n = std::min(data.size(), size_t(written) / sizeof(GLuint));
+        for (size_t i = 0; i + 2 < n; ) {
+            Counter c = {};
+            c.groupId = data[i];
+            c.counterId = data[i + 1];
+            c.type = GL_UNSIGNED_INT;
+            for (const Counter& d : counters)
+                if (d.groupId == c.groupId && d.counterId == c.counterId)
+                    c = d;
+            double value;
+            if (c.type == GL_UNSIGNED_INT64_AMD) {
+                GLuint64 v = 0;
+                memcpy(&v, &data[i + 2], std::min(sizeof(v), (n - i - 2) * sizeof(GLuint)));
+                value = v;
+                i += 4;
+            } else if (c.type == GL_FLOAT || c.type == GL_PERCENTAGE_AMD) {
+                float v;
+                memcpy(&v, &data[i + 2], sizeof(v));
+                value = v;
+                i += 3;
+            } else {
+                value = data[i + 2];
+                i += 3;
+            }
+            sampled.append(c);
+            sampledValues.append(value);
+        }
+        for (const Counter& c : _selected) {
+            double value = 0.0;
+            for (int i = 0; i < sampled.size(); i++)
+                if (sampled[i].groupId == c.groupId && sampled[i].counterId == c.counterId)
+                    value = sampledValues[i];
+            values.append(value);
+        }
+    } else if (_query) {
+        proc<EndPerfQueryINTEL>(_context, "glEndPerfQueryINTEL")(_query);
+        std::vector<unsigned char> data(_queryDataSize);
+        GLuint written = 0;
+        proc<GetPerfQueryDataINTEL>(_context, "glGetPerfQueryDataINTEL")(_query,
+                GL_PERFQUERY_WAIT_INTEL, data.size(), data.data(), &written);
+        for (const Counter& c : _selected) {
+            double value = 0.0;
+            const unsigned char* p = data.data() + c.offset;
+            if (c.type == GL_PERFQUERY_COUNTER_DATA_UINT32_INTEL || c.type == GL_PERFQUERY_COUNTER_DATA_BOOL32_INTEL) {
+                GLuint v;
+                memcpy(&v, p, sizeof(v));
+                value = v;
+            } else if (c.type == GL_PERFQUERY_COUNTER_DATA_UINT64_INTEL) {
+                GLuint64 v;
+                memcpy(&v, p, sizeof(v));
+                value = v;
+            } else if (c.type == GL_PERFQUERY_COUNTER_DATA_FLOAT_INTEL) {
+                float v;
+                memcpy(&v, p, sizeof(v));
+                value = v;
+            } else if (c.type == GL_PERFQUERY_COUNTER_DATA_DOUBLE_INTEL) {
+                memcpy(&value, p, sizeof(value));
+            }
+            values.append(value);
+        }
+    }
+    for (int i = 0; i < values.size(); i++) {
+        const Counter& c = _selected[i];
+        if (c.normalized)
+            result.add(c.group + '/' + c.name, values[i], "");
+        else
+            result.add(c.group + '/' + c.name + " per iteration", values[i] / result.iterations, "");
+    }
+}
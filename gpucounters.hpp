@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GPUCOUNTERS_HPP
+#define GPUCOUNTERS_HPP
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include "benchmark.hpp"
+
+/* Vendor performance counters via GL_AMD_performance_monitor or
+ * GL_INTEL_performance_query. In both extensions, counters are organized
+ * in groups (called queries in the Intel extension). */
+class GpuCounters : public Probe
+{
+public:
+    struct Counter
+    {
+        QString group;
+        QString name;
+        QString description;
+        GLuint groupId;
+        GLuint counterId;
+        GLenum type;            // AMD: counter type; Intel: counter data type
+        bool normalized;        // the value is a percentage or rate, not a count
+        GLuint offset;          // Intel: offset in the query result
+    };
+
+private:
+    QOpenGLContext* _context;
+    bool _amd;
+    bool _intel;
+    QList<Counter> _selected;
+    GLuint _monitor;            // AMD: performance monitor
+    GLuint _query;              // Intel: query handle
+    GLuint _queryDataSize;      // Intel: size of the query result
+
+    void enumerate();
+    void enumerateAMD();
+    void enumerateIntel();
+
+public:
+    QList<Counter> counters;    // all counters, available after list() or select()
+
+    GpuCounters(QOpenGLContext* context);
+    ~GpuCounters();
+
+    // Name of the extension used, or nullptr if none is available
+    const char* extension() const;
+
+    // Print all groups and counters
+    void list();
+
+    // Select counters for sampling. Each selection is GROUP/COUNTER or GROUP
+    // for all counters of a group. Returns false on error.
+    bool select(const QStringList& selections);
+
+    void begin() override;
+    void end(Result& result) override;
+};
+
+#endif
@@ -0,0 +1,844 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * glinf-interpose: an LD_PRELOAD library that wraps common OpenGL and EGL/GLX
+ * entry points, records call counts and latency histograms per function, and
+ * writes a report when the process exits.
+ *
+ * Usage: LD_PRELOAD=/path/to/libglinf-interpose.so application
+ *
+ * The report is written to stderr, or to the file named by the environment
+ * variable GLINF_INTERPOSE_OUTPUT.
+ *
+ * Functions are wrapped both when they are called directly and when their
+ * address is obtained via eglGetProcAddress() or glXGetProcAddress[ARB]().
+ * Each thread records into its own buffer, so recording needs no locks.
+ *
+ * If the environment variable GLINF_TRACE_OUTPUT names a file, the calls that
+ * create and use buffers, textures, shaders, programs, vertex arrays and
+ * framebuffers, set state, and draw are additionally written to that file in
+ * the format described in trace.hpp, with a frame marker at each buffer swap.
+ * Such a trace can be replayed with glinf --replay. Client-side vertex and
+ * index arrays are not recorded.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <type_traits>
+
+#include <dlfcn.h>
+
+#include "trace.hpp"
+
+/* Types from the OpenGL, EGL, and GLX headers. We do not include these headers
+ * so that our definitions do not clash with their prototypes. */
+typedef unsigned int GLenum;
+typedef unsigned int GLbitfield;
+typedef unsigned int GLuint;
+typedef int GLint;
+typedef int GLsizei;
+typedef unsigned char GLboolean;
+typedef float GLfloat;
+typedef double GLdouble;
+typedef char GLchar;
+typedef unsigned char GLubyte;
+typedef intptr_t GLintptr;
+typedef intptr_t GLsizeiptr;
+typedef uint64_t GLuint64;
+typedef struct __GLsync* GLsync;
+typedef unsigned int EGLBoolean;
+typedef int32_t EGLint;
+typedef void* EGLDisplay;
+typedef void* EGLSurface;
+typedef void* EGLContext;
+typedef void* EGLConfig;
+typedef struct _XDisplay Display;
+typedef unsigned long GLXDrawable;
+typedef struct __GLXcontextRec* GLXContext;
+
+/* The wrapped functions: F(return type, name, parameters, arguments) */
+#define GLINF_FUNCTIONS(F) \
+    F(void, glActiveTexture, (GLenum texture), (texture)) \
+    F(void, glAttachShader, (GLuint program, GLuint shader), (program, shader)) \
+    F(void, glBindBuffer, (GLenum target, GLuint buffer), (target, buffer)) \
+    F(void, glBindBufferBase, (GLenum target, GLuint index, GLuint buffer), (target, index, buffer)) \
+    F(void, glBindBufferRange, (GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size), (target, index, buffer, offset, size)) \
+    F(void, glBindFramebuffer, (GLenum target, GLuint framebuffer), (target, framebuffer)) \
+    F(void, glBindTexture, (GLenum target, GLuint texture), (target, texture)) \
+    F(void, glBindVertexArray, (GLuint array), (array)) \
+    F(void, glBlendFunc, (GLenum sfactor, GLenum dfactor), (sfactor, dfactor)) \
+    F(void, glBlitFramebuffer, (GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1, GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter), (srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1, mask, filter)) \
+    F(void, glBufferData, (GLenum target, GLsizeiptr size, const void* data, GLenum usage), (target, size, data, usage)) \
+    F(void, glBufferSubData, (GLenum target, GLintptr offset, GLsizeiptr size, const void* data), (target, offset, size, data)) \
+    F(void, glClear, (GLbitfield mask), (mask)) \
+    F(void, glClearColor, (GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha), (red, green, blue, alpha)) \
+    F(void, glClearDepth, (GLdouble depth), (depth)) \
+    F(void, glClearDepthf, (GLfloat depth), (depth)) \
+    F(GLenum, glClientWaitSync, (GLsync sync, GLbitfield flags, GLuint64 timeout), (sync, flags, timeout)) \
+    F(void, glColorMask, (GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha), (red, green, blue, alpha)) \
+    F(void, glCompileShader, (GLuint shader), (shader)) \
+    F(GLuint, glCreateProgram, (void), ()) \
+    F(GLuint, glCreateShader, (GLenum type), (type)) \
+    F(void, glDeleteBuffers, (GLsizei n, const GLuint* buffers), (n, buffers)) \
+    F(void, glDeleteFramebuffers, (GLsizei n, const GLuint* framebuffers), (n, framebuffers)) \
+    F(void, glDeleteProgram, (GLuint program), (program)) \
+    F(void, glDeleteShader, (GLuint shader), (shader)) \
+    F(void, glDeleteTextures, (GLsizei n, const GLuint* textures), (n, textures)) \
+    F(void, glDeleteVertexArrays, (GLsizei n, const GLuint* arrays), (n, arrays)) \
+    F(void, glDepthFunc, (GLenum func), (func)) \
+    F(void, glDepthMask, (GLboolean flag), (flag)) \
+    F(void, glDisable, (GLenum cap), (cap)) \
+    F(void, glDisableVertexAttribArray, (GLuint index), (index)) \
+    F(void, glDispatchCompute, (GLuint x, GLuint y, GLuint z), (x, y, z)) \
+    F(void, glDispatchComputeIndirect, (GLintptr indirect), (indirect)) \
+    F(void, glDrawArrays, (GLenum mode, GLint first, GLsizei count), (mode, first, count)) \
+    F(void, glDrawArraysIndirect, (GLenum mode, const void* indirect), (mode, indirect)) \
+    F(void, glDrawArraysInstanced, (GLenum mode, GLint first, GLsizei count, GLsizei instancecount), (mode, first, count, instancecount)) \
+    F(void, glDrawElements, (GLenum mode, GLsizei count, GLenum type, const void* indices), (mode, count, type, indices)) \
+    F(void, glDrawElementsBaseVertex, (GLenum mode, GLsizei count, GLenum type, const void* indices, GLint basevertex), (mode, count, type, indices, basevertex)) \
+    F(void, glDrawElementsIndirect, (GLenum mode, GLenum type, const void* indirect), (mode, type, indirect)) \
+    F(void, glDrawElementsInstanced, (GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instancecount), (mode, count, type, indices, instancecount)) \
+    F(void, glDrawRangeElements, (GLenum mode, GLuint start, GLuint end, GLsizei count, GLenum type, const void* indices), (mode, start, end, count, type, indices)) \
+    F(void, glEnable, (GLenum cap), (cap)) \
+    F(void, glEnableVertexAttribArray, (GLuint index), (index)) \
+    F(GLsync, glFenceSync, (GLenum condition, GLbitfield flags), (condition, flags)) \
+    F(void, glFinish, (void), ()) \
+    F(void, glFlush, (void), ()) \
+    F(void, glFramebufferTexture2D, (GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level), (target, attachment, textarget, texture, level)) \
+    F(void, glGenBuffers, (GLsizei n, GLuint* buffers), (n, buffers)) \
+    F(void, glGenFramebuffers, (GLsizei n, GLuint* framebuffers), (n, framebuffers)) \
+    F(void, glGenTextures, (GLsizei n, GLuint* textures), (n, textures)) \
+    F(void, glGenVertexArrays, (GLsizei n, GLuint* arrays), (n, arrays)) \
+    F(void, glGenerateMipmap, (GLenum target), (target)) \
+    F(GLenum, glGetError, (void), ()) \
+    F(GLint, glGetUniformLocation, (GLuint program, const GLchar* name), (program, name)) \
+    F(void, glLinkProgram, (GLuint program), (program)) \
+    F(void*, glMapBufferRange, (GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access), (target, offset, length, access)) \
+    F(void, glMemoryBarrier, (GLbitfield barriers), (barriers)) \
+    F(void, glMultiDrawArraysIndirect, (GLenum mode, const void* indirect, GLsizei drawcount, GLsizei stride), (mode, indirect, drawcount, stride)) \
+    F(void, glMultiDrawElementsIndirect, (GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride), (mode, type, indirect, drawcount, stride)) \
+    F(void, glPixelStorei, (GLenum pname, GLint param), (pname, param)) \
+    F(void, glReadPixels, (GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void* pixels), (x, y, width, height, format, type, pixels)) \
+    F(void, glScissor, (GLint x, GLint y, GLsizei width, GLsizei height), (x, y, width, height)) \
+    F(void, glShaderSource, (GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length), (shader, count, string, length)) \
+    F(void, glTexImage2D, (GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels), (target, level, internalformat, width, height, border, format, type, pixels)) \
+    F(void, glTexParameteri, (GLenum target, GLenum pname, GLint param), (target, pname, param)) \
+    F(void, glTexStorage2D, (GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height), (target, levels, internalformat, width, height)) \
+    F(void, glTexSubImage2D, (GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels), (target, level, xoffset, yoffset, width, height, format, type, pixels)) \
+    F(void, glUniform1f, (GLint location, GLfloat v0), (location, v0)) \
+    F(void, glUniform1fv, (GLint location, GLsizei count, const GLfloat* value), (location, count, value)) \
+    F(void, glUniform1i, (GLint location, GLint v0), (location, v0)) \
+    F(void, glUniform2fv, (GLint location, GLsizei count, const GLfloat* value), (location, count, value)) \
+    F(void, glUniform3fv, (GLint location, GLsizei count, const GLfloat* value), (location, count, value)) \
+    F(void, glUniform4f, (GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3), (location, v0, v1, v2, v3)) \
+    F(void, glUniform4fv, (GLint location, GLsizei count, const GLfloat* value), (location, count, value)) \
+    F(void, glUniformMatrix3fv, (GLint location, GLsizei count, GLboolean transpose, const GLfloat* value), (location, count, transpose, value)) \
+    F(void, glUniformMatrix4fv, (GLint location, GLsizei count, GLboolean transpose, const GLfloat* value), (location, count, transpose, value)) \
+    F(GLboolean, glUnmapBuffer, (GLenum target), (target)) \
+    F(void, glUseProgram, (GLuint program), (program)) \
+    F(void, glVertexAttribPointer, (GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer), (index, size, type, normalized, stride, pointer)) \
+    F(void, glViewport, (GLint x, GLint y, GLsizei width, GLsizei height), (x, y, width, height)) \
+    F(EGLContext, eglCreateContext, (EGLDisplay dpy, EGLConfig config, EGLContext share_context, const EGLint* attrib_list), (dpy, config, share_context, attrib_list)) \
+    F(EGLBoolean, eglMakeCurrent, (EGLDisplay dpy, EGLSurface draw, EGLSurface read, EGLContext ctx), (dpy, draw, read, ctx)) \
+    F(EGLBoolean, eglSwapBuffers, (EGLDisplay dpy, EGLSurface surface), (dpy, surface)) \
+    F(int, glXMakeCurrent, (Display* dpy, GLXDrawable drawable, GLXContext ctx), (dpy, drawable, ctx)) \
+    F(void, glXSwapBuffers, (Display* dpy, GLXDrawable drawable), (dpy, drawable))
+
+enum {
+#define F(ret, name, params, args) id_##name,
+    GLINF_FUNCTIONS(F)
+#undef F
+    functionCount
+};
+
+static const char* const functionNames[] = {
+#define F(ret, name, params, args) #name,
+    GLINF_FUNCTIONS(F)
+#undef F
+};
+
+/* Latency histogram: bucket b counts calls that took [2^b, 2^(b+1)) ns,
+ * bucket 0 also counts calls that took 0 ns */
+static const int bucketCount = 40;
+
+/* Statistics of one thread. Only the owning thread writes to it; relaxed
+ * atomics keep reads at exit well-defined without locked instructions. */
+struct ThreadStats
+{
+    ThreadStats* next;
+    std::atomic<uint64_t> calls[functionCount];
+    std::atomic<uint64_t> ns[functionCount];
+    std::atomic<uint64_t> maxNs[functionCount];
+    std::atomic<uint64_t> histogram[functionCount][bucketCount];
+};
+
+/* All thread statistics, as a lock-free list. Entries are never freed so
+ * that statistics of threads that already exited are still reported. */
+static std::atomic<ThreadStats*> allStats(nullptr);
+static thread_local ThreadStats* threadStats = nullptr;
+
+static ThreadStats* getThreadStats()
+{
+    if (!threadStats) {
+        ThreadStats* s = static_cast<ThreadStats*>(calloc(1, sizeof(ThreadStats)));
+        if (!s)
+            abort();
+        s->next = allStats.load();
+        while (!allStats.compare_exchange_weak(s->next, s))
+            ;
+        threadStats = s;
+    }
+    return threadStats;
+}
+
+static inline uint64_t now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+static inline void increase(std::atomic<uint64_t>& v, uint64_t x)
+{
+    v.store(v.load(std::memory_order_relaxed) + x, std::memory_order_relaxed);
+}
+
+static void record(int id, uint64_t ns)
+{
+    ThreadStats* s = getThreadStats();
+    int bucket = (ns == 0 ? 0 : 63 - __builtin_clzll(ns));
+    if (bucket >= bucketCount)
+        bucket = bucketCount - 1;
+    increase(s->calls[id], 1);
+    increase(s->ns[id], ns);
+    increase(s->histogram[id][bucket], 1);
+    if (ns > s->maxNs[id].load(std::memory_order_relaxed))
+        s->maxNs[id].store(ns, std::memory_order_relaxed);
+}
+
+class CallTimer
+{
+private:
+    int _id;
+    uint64_t _t0;
+public:
+    CallTimer(int id) : _id(id), _t0(now()) {}
+    ~CallTimer() { record(_id, now() - _t0); }
+};
+
+/* Tracing (see trace.hpp). Enabled by the environment variable
+ * GLINF_TRACE_OUTPUT. Records are assembled in a per-thread buffer and then
+ * appended to the file under a lock. */
+
+static FILE* traceFile = nullptr;
+static std::mutex traceMutex;
+static uint64_t traceStart = 0;
+
+__attribute__((constructor)) static void traceInit()
+{
+    const char* fileName = getenv("GLINF_TRACE_OUTPUT");
+    if (fileName && fileName[0]) {
+        traceFile = fopen(fileName, "wb");
+        if (!traceFile) {
+            fprintf(stderr, "glinf-interpose: cannot open %s\n", fileName);
+            return;
+        }
+        fwrite(traceMagic, sizeof(traceMagic), 1, traceFile);
+        traceStart = now();
+    }
+}
+
+class TraceRecord
+{
+private:
+    uint32_t _opcode;
+    std::vector<unsigned char>& _data;
+
+    static std::vector<unsigned char>& buffer()
+    {
+        static thread_local std::vector<unsigned char> data;
+        return data;
+    }
+
+public:
+    TraceRecord(uint32_t opcode) : _opcode(opcode), _data(buffer())
+    {
+        _data.clear();
+    }
+
+    ~TraceRecord()
+    {
+        uint32_t header[2] = { _opcode, uint32_t(_data.size()) };
+        std::lock_guard<std::mutex> lock(traceMutex);
+        fwrite(header, sizeof(header), 1, traceFile);
+        fwrite(_data.data(), 1, _data.size(), traceFile);
+        if (_opcode == TraceFrame)
+            fflush(traceFile);
+    }
+
+    TraceRecord& bytes(const void* p, size_t n)
+    {
+        const unsigned char* c = static_cast<const unsigned char*>(p);
+        _data.insert(_data.end(), c, c + n);
+        return *this;
+    }
+    TraceRecord& u32(uint32_t v) { return bytes(&v, sizeof(v)); }
+    TraceRecord& f32(float v) { return bytes(&v, sizeof(v)); }
+    TraceRecord& u64(uint64_t v) { return bytes(&v, sizeof(v)); }
+};
+
+/* Context state that the recorder needs to know. We track it per thread,
+ * which matches the common case of one context per thread. */
+struct MappedRange
+{
+    GLenum target;
+    GLintptr offset;
+    GLsizeiptr length;
+    void* pointer;
+};
+
+struct TraceState
+{
+    GLint unpackAlignment = 4;
+    GLint unpackRowLength = 0;
+    GLint unpackSkipPixels = 0;
+    GLint unpackSkipRows = 0;
+    GLuint unpackBuffer = 0;
+    MappedRange mapped[8] = {};
+};
+
+static thread_local TraceState traceState;
+
+/* Size of pixel data in client memory, following the unpack state. This
+ * includes the skipped rows and pixels, since replay restores them too. */
+static size_t pixelDataSize(GLsizei width, GLsizei height, GLenum format, GLenum type)
+{
+    size_t components;
+    switch (format) {
+    case 0x8227: /* GL_RG */
+    case 0x8228: /* GL_RG_INTEGER */
+    case 0x84F9: /* GL_DEPTH_STENCIL */
+        components = 2;
+        break;
+    case 0x1907: /* GL_RGB */
+    case 0x80E0: /* GL_BGR */
+    case 0x8D98: /* GL_RGB_INTEGER */
+        components = 3;
+        break;
+    case 0x1908: /* GL_RGBA */
+    case 0x80E1: /* GL_BGRA */
+    case 0x8D99: /* GL_RGBA_INTEGER */
+        components = 4;
+        break;
+    default:
+        components = 1;
+        break;
+    }
+    size_t pixelSize;
+    switch (type) {
+    case 0x1400: /* GL_BYTE */
+    case 0x1401: /* GL_UNSIGNED_BYTE */
+        pixelSize = components;
+        break;
+    case 0x1402: /* GL_SHORT */
+    case 0x1403: /* GL_UNSIGNED_SHORT */
+    case 0x140B: /* GL_HALF_FLOAT */
+    case 0x8D61: /* GL_HALF_FLOAT_OES */
+        pixelSize = 2 * components;
+        break;
+    case 0x8363: /* GL_UNSIGNED_SHORT_5_6_5 */
+    case 0x8033: /* GL_UNSIGNED_SHORT_4_4_4_4 */
+    case 0x8034: /* GL_UNSIGNED_SHORT_5_5_5_1 */
+        pixelSize = 2;
+        break;
+    case 0x8035: /* GL_UNSIGNED_INT_8_8_8_8 */
+    case 0x8367: /* GL_UNSIGNED_INT_8_8_8_8_REV */
+    case 0x8368: /* GL_UNSIGNED_INT_2_10_10_10_REV */
+    case 0x8C3B: /* GL_UNSIGNED_INT_10F_11F_11F_REV */
+    case 0x8C3E: /* GL_UNSIGNED_INT_5_9_9_9_REV */
+    case 0x84FA: /* GL_UNSIGNED_INT_24_8 */
+        pixelSize = 4;
+        break;
+    case 0x8DAD: /* GL_FLOAT_32_UNSIGNED_INT_24_8_REV */
+        pixelSize = 8;
+        break;
+    default: /* GL_INT, GL_UNSIGNED_INT, GL_FLOAT */
+        pixelSize = 4 * components;
+        break;
+    }
+    if (width <= 0 || height <= 0)
+        return 0;
+    size_t alignment = traceState.unpackAlignment;
+    size_t rowLength = traceState.unpackRowLength > 0 ? traceState.unpackRowLength : width;
+    size_t rowSize = (rowLength * pixelSize + alignment - 1) / alignment * alignment;
+    return rowSize * (traceState.unpackSkipRows + height - 1)
+        + (traceState.unpackSkipPixels + width) * pixelSize;
+}
+
+static void tracePixels(TraceRecord& r, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels)
+{
+    if (traceState.unpackBuffer) {
+        r.u32(TracePixelsUnpackBuffer).u64(reinterpret_cast<uintptr_t>(pixels));
+    } else if (!pixels) {
+        r.u32(TracePixelsNone).u64(0);
+    } else {
+        size_t size = pixelDataSize(width, height, format, type);
+        r.u32(TracePixelsInline).u64(size).bytes(pixels, size);
+    }
+}
+
+static void traceNames(uint32_t opcode, GLsizei n, const GLuint* names)
+{
+    if (n > 0)
+        TraceRecord(opcode).u32(n).bytes(names, n * sizeof(GLuint));
+}
+
+/* Each wrapper calls traceBefore() and traceAfter() (the latter with the
+ * return value, if any). The templates do nothing; the overloads below record
+ * the traced functions. */
+
+template<int id> struct Id {};
+template<int id, typename... A> static inline void traceBefore(Id<id>, A...) {}
+template<int id, typename... A> static inline void traceAfter(Id<id>, A...) {}
+
+#define TRACE_BEFORE(name, params) static void traceBefore(Id<id_##name>, GLINF_UNPACK params)
+#define TRACE_AFTER(name, params) static void traceAfter(Id<id_##name>, GLINF_UNPACK params)
+#define GLINF_UNPACK(...) __VA_ARGS__
+
+TRACE_BEFORE(eglSwapBuffers, (EGLDisplay, EGLSurface)) { TraceRecord(TraceFrame).u64(now() - traceStart); }
+TRACE_BEFORE(glXSwapBuffers, (Display*, GLXDrawable)) { TraceRecord(TraceFrame).u64(now() - traceStart); }
+TRACE_AFTER(glGenBuffers, (GLsizei n, GLuint* names)) { traceNames(TraceGenBuffers, n, names); }
+TRACE_AFTER(glDeleteBuffers, (GLsizei n, const GLuint* names)) { traceNames(TraceDeleteBuffers, n, names); }
+TRACE_AFTER(glGenTextures, (GLsizei n, GLuint* names)) { traceNames(TraceGenTextures, n, names); }
+TRACE_AFTER(glDeleteTextures, (GLsizei n, const GLuint* names)) { traceNames(TraceDeleteTextures, n, names); }
+TRACE_AFTER(glGenVertexArrays, (GLsizei n, GLuint* names)) { traceNames(TraceGenVertexArrays, n, names); }
+TRACE_AFTER(glDeleteVertexArrays, (GLsizei n, const GLuint* names)) { traceNames(TraceDeleteVertexArrays, n, names); }
+TRACE_AFTER(glGenFramebuffers, (GLsizei n, GLuint* names)) { traceNames(TraceGenFramebuffers, n, names); }
+TRACE_AFTER(glDeleteFramebuffers, (GLsizei n, const GLuint* names)) { traceNames(TraceDeleteFramebuffers, n, names); }
+TRACE_AFTER(glCreateShader, (GLuint result, GLenum type)) { TraceRecord(TraceCreateShader).u32(type).u32(result); }
+TRACE_AFTER(glShaderSource, (GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length))
+{
+    TraceRecord r(TraceShaderSource);
+    r.u32(shader);
+    for (GLsizei i = 0; i < count; i++)
+        r.bytes(string[i], length && length[i] >= 0 ? length[i] : strlen(string[i]));
+}
+TRACE_AFTER(glCompileShader, (GLuint shader)) { TraceRecord(TraceCompileShader).u32(shader); }
+TRACE_AFTER(glDeleteShader, (GLuint shader)) { TraceRecord(TraceDeleteShader).u32(shader); }
+TRACE_AFTER(glCreateProgram, (GLuint result)) { TraceRecord(TraceCreateProgram).u32(result); }
+TRACE_AFTER(glAttachShader, (GLuint program, GLuint shader)) { TraceRecord(TraceAttachShader).u32(program).u32(shader); }
+TRACE_AFTER(glLinkProgram, (GLuint program)) { TraceRecord(TraceLinkProgram).u32(program); }
+TRACE_AFTER(glDeleteProgram, (GLuint program)) { TraceRecord(TraceDeleteProgram).u32(program); }
+TRACE_AFTER(glUseProgram, (GLuint program)) { TraceRecord(TraceUseProgram).u32(program); }
+TRACE_AFTER(glGetUniformLocation, (GLint result, GLuint program, const GLchar* name))
+{
+    TraceRecord(TraceGetUniformLocation).u32(program).u32(result).bytes(name, strlen(name));
+}
+TRACE_AFTER(glUniform1i, (GLint location, GLint v0)) { TraceRecord(TraceUniform1i).u32(location).u32(v0); }
+TRACE_AFTER(glUniform1f, (GLint location, GLfloat v0)) { TraceRecord(TraceUniform1f).u32(location).f32(v0); }
+TRACE_AFTER(glUniform4f, (GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3))
+{
+    TraceRecord(TraceUniform4f).u32(location).f32(v0).f32(v1).f32(v2).f32(v3);
+}
+static void traceUniformfv(uint32_t components, GLint location, GLsizei count, const GLfloat* value)
+{
+    TraceRecord(TraceUniformfv).u32(components).u32(location).u32(count).bytes(value, count * components * sizeof(GLfloat));
+}
+TRACE_AFTER(glUniform1fv, (GLint location, GLsizei count, const GLfloat* value)) { traceUniformfv(1, location, count, value); }
+TRACE_AFTER(glUniform2fv, (GLint location, GLsizei count, const GLfloat* value)) { traceUniformfv(2, location, count, value); }
+TRACE_AFTER(glUniform3fv, (GLint location, GLsizei count, const GLfloat* value)) { traceUniformfv(3, location, count, value); }
+TRACE_AFTER(glUniform4fv, (GLint location, GLsizei count, const GLfloat* value)) { traceUniformfv(4, location, count, value); }
+static void traceUniformMatrixfv(uint32_t columns, GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+{
+    TraceRecord(TraceUniformMatrixfv).u32(columns).u32(location).u32(count).u32(transpose)
+        .bytes(value, count * columns * columns * sizeof(GLfloat));
+}
+TRACE_AFTER(glUniformMatrix3fv, (GLint location, GLsizei count, GLboolean transpose, const GLfloat* value))
+{
+    traceUniformMatrixfv(3, location, count, transpose, value);
+}
+TRACE_AFTER(glUniformMatrix4fv, (GLint location, GLsizei count, GLboolean transpose, const GLfloat* value))
+{
+    traceUniformMatrixfv(4, location, count, transpose, value);
+}
+TRACE_AFTER(glBindBuffer, (GLenum target, GLuint buffer))
+{
+    if (target == 0x88EC /* GL_PIXEL_UNPACK_BUFFER */)
+        traceState.unpackBuffer = buffer;
+    TraceRecord(TraceBindBuffer).u32(target).u32(buffer);
+}
+TRACE_AFTER(glBindBufferBase, (GLenum target, GLuint index, GLuint buffer))
+{
+    TraceRecord(TraceBindBufferBase).u32(target).u32(index).u32(buffer);
+}
+TRACE_AFTER(glBindBufferRange, (GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size))
+{
+    TraceRecord(TraceBindBufferRange).u32(target).u32(index).u32(buffer).u64(offset).u64(size);
+}
+TRACE_AFTER(glBufferData, (GLenum target, GLsizeiptr size, const void* data, GLenum usage))
+{
+    TraceRecord r(TraceBufferData);
+    r.u32(target).u32(usage).u64(size).u32(data ? 1 : 0);
+    if (data)
+        r.bytes(data, size);
+}
+TRACE_AFTER(glBufferSubData, (GLenum target, GLintptr offset, GLsizeiptr size, const void* data))
+{
+    TraceRecord(TraceBufferSubData).u32(target).u64(offset).u64(size).bytes(data, size);
+}
+TRACE_AFTER(glMapBufferRange, (void* result, GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access))
+{
+    if (!result || !(access & 0x0002 /* GL_MAP_WRITE_BIT */))
+        return;
+    for (MappedRange& m : traceState.mapped) {
+        if (!m.pointer || m.target == target) {
+            m = { target, offset, length, result };
+            break;
+        }
+    }
+}
+TRACE_BEFORE(glUnmapBuffer, (GLenum target))
+{
+    // Record what was written to the mapping while it is still valid
+    for (MappedRange& m : traceState.mapped) {
+        if (m.pointer && m.target == target) {
+            TraceRecord(TraceBufferSubData).u32(target).u64(m.offset).u64(m.length).bytes(m.pointer, m.length);
+            m.pointer = nullptr;
+            break;
+        }
+    }
+}
+TRACE_AFTER(glActiveTexture, (GLenum texture)) { TraceRecord(TraceActiveTexture).u32(texture); }
+TRACE_AFTER(glBindTexture, (GLenum target, GLuint texture)) { TraceRecord(TraceBindTexture).u32(target).u32(texture); }
+TRACE_AFTER(glTexParameteri, (GLenum target, GLenum pname, GLint param))
+{
+    TraceRecord(TraceTexParameteri).u32(target).u32(pname).u32(param);
+}
+TRACE_AFTER(glPixelStorei, (GLenum pname, GLint param))
+{
+    if (pname == 0x0CF5 /* GL_UNPACK_ALIGNMENT */)
+        traceState.unpackAlignment = param;
+    else if (pname == 0x0CF2 /* GL_UNPACK_ROW_LENGTH */)
+        traceState.unpackRowLength = param;
+    else if (pname == 0x0CF4 /* GL_UNPACK_SKIP_PIXELS */)
+        traceState.unpackSkipPixels = param > 0 ? param : 0;
+    else if (pname == 0x0CF3 /* GL_UNPACK_SKIP_ROWS */)
+        traceState.unpackSkipRows = param > 0 ? param : 0;
+    TraceRecord(TracePixelStorei).u32(pname).u32(param);
+}
+TRACE_AFTER(glTexImage2D, (GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height,
+            GLint border, GLenum format, GLenum type, const void* pixels))
+{
+    TraceRecord r(TraceTexImage2D);
+    r.u32(target).u32(level).u32(internalformat).u32(width).u32(height).u32(border).u32(format).u32(type);
+    tracePixels(r, width, height, format, type, pixels);
+}
+TRACE_AFTER(glTexStorage2D, (GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height))
+{
+    TraceRecord(TraceTexStorage2D).u32(target).u32(levels).u32(internalformat).u32(width).u32(height);
+}
+TRACE_AFTER(glTexSubImage2D, (GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height,
+            GLenum format, GLenum type, const void* pixels))
+{
+    TraceRecord r(TraceTexSubImage2D);
+    r.u32(target).u32(level).u32(xoffset).u32(yoffset).u32(width).u32(height).u32(format).u32(type);
+    tracePixels(r, width, height, format, type, pixels);
+}
+TRACE_AFTER(glGenerateMipmap, (GLenum target)) { TraceRecord(TraceGenerateMipmap).u32(target); }
+TRACE_AFTER(glBindVertexArray, (GLuint array)) { TraceRecord(TraceBindVertexArray).u32(array); }
+TRACE_AFTER(glVertexAttribPointer, (GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer))
+{
+    TraceRecord(TraceVertexAttribPointer).u32(index).u32(size).u32(type).u32(normalized).u32(stride)
+        .u64(reinterpret_cast<uintptr_t>(pointer));
+}
+TRACE_AFTER(glEnableVertexAttribArray, (GLuint index)) { TraceRecord(TraceEnableVertexAttribArray).u32(index); }
+TRACE_AFTER(glDisableVertexAttribArray, (GLuint index)) { TraceRecord(TraceDisableVertexAttribArray).u32(index); }
+TRACE_AFTER(glBindFramebuffer, (GLenum target, GLuint framebuffer))
+{
+    TraceRecord(TraceBindFramebuffer).u32(target).u32(framebuffer);
+}
+TRACE_AFTER(glFramebufferTexture2D, (GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level))
+{
+    TraceRecord(TraceFramebufferTexture2D).u32(target).u32(attachment).u32(textarget).u32(texture).u32(level);
+}
+TRACE_AFTER(glEnable, (GLenum cap)) { TraceRecord(TraceEnable).u32(cap); }
+TRACE_AFTER(glDisable, (GLenum cap)) { TraceRecord(TraceDisable).u32(cap); }
+TRACE_AFTER(glBlendFunc, (GLenum sfactor, GLenum dfactor)) { TraceRecord(TraceBlendFunc).u32(sfactor).u32(dfactor); }
+TRACE_AFTER(glDepthFunc, (GLenum func)) { TraceRecord(TraceDepthFunc).u32(func); }
+TRACE_AFTER(glDepthMask, (GLboolean flag)) { TraceRecord(TraceDepthMask).u32(flag); }
+TRACE_AFTER(glColorMask, (GLboolean r, GLboolean g, GLboolean b, GLboolean a))
+{
+    TraceRecord(TraceColorMask).u32(r).u32(g).u32(b).u32(a);
+}
+TRACE_AFTER(glViewport, (GLint x, GLint y, GLsizei width, GLsizei height))
+{
+    TraceRecord(TraceViewport).u32(x).u32(y).u32(width).u32(height);
+}
+TRACE_AFTER(glScissor, (GLint x, GLint y, GLsizei width, GLsizei height))
+{
+    TraceRecord(TraceScissor).u32(x).u32(y).u32(width).u32(height);
+}
+TRACE_AFTER(glClearColor, (GLfloat r, GLfloat g, GLfloat b, GLfloat a))
+{
+    TraceRecord(TraceClearColor).f32(r).f32(g).f32(b).f32(a);
+}
+TRACE_AFTER(glClearDepth, (GLdouble depth)) { TraceRecord(TraceClearDepth).f32(depth); }
+TRACE_AFTER(glClearDepthf, (GLfloat depth)) { TraceRecord(TraceClearDepth).f32(depth); }
+TRACE_AFTER(glClear, (GLbitfield mask)) { TraceRecord(TraceClear).u32(mask); }
+TRACE_AFTER(glDrawArrays, (GLenum mode, GLint first, GLsizei count))
+{
+    TraceRecord(TraceDrawArrays).u32(mode).u32(first).u32(count).u32(1);
+}
+TRACE_AFTER(glDrawArraysInstanced, (GLenum mode, GLint first, GLsizei count, GLsizei instances))
+{
+    TraceRecord(TraceDrawArrays).u32(mode).u32(first).u32(count).u32(instances);
+}
+static void traceDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instances, GLint basevertex)
+{
+    TraceRecord(TraceDrawElements).u32(mode).u32(count).u32(type).u64(reinterpret_cast<uintptr_t>(indices))
+        .u32(instances).u32(basevertex);
+}
+TRACE_AFTER(glDrawElements, (GLenum mode, GLsizei count, GLenum type, const void* indices))
+{
+    traceDrawElements(mode, count, type, indices, 1, 0);
+}
+TRACE_AFTER(glDrawElementsBaseVertex, (GLenum mode, GLsizei count, GLenum type, const void* indices, GLint basevertex))
+{
+    traceDrawElements(mode, count, type, indices, 1, basevertex);
+}
+TRACE_AFTER(glDrawElementsInstanced, (GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instances))
+{
+    traceDrawElements(mode, count, type, indices, instances, 0);
+}
+TRACE_AFTER(glDrawRangeElements, (GLenum mode, GLuint, GLuint, GLsizei count, GLenum type, const void* indices))
+{
+    traceDrawElements(mode, count, type, indices, 1, 0);
+}
+TRACE_AFTER(glDispatchCompute, (GLuint x, GLuint y, GLuint z)) { TraceRecord(TraceDispatchCompute).u32(x).u32(y).u32(z); }
+TRACE_AFTER(glMemoryBarrier, (GLbitfield barriers)) { TraceRecord(TraceMemoryBarrier).u32(barriers); }
+
+#undef TRACE_BEFORE
+#undef TRACE_AFTER
+#undef GLINF_UNPACK
+
+/* Call a real function: time it, and trace it if enabled */
+template<int id, typename F> class Call;
+template<int id, typename R, typename... A> class Call<id, R (*)(A...)>
+{
+private:
+    R (*_real)(A...);
+
+public:
+    Call(R (*real)(A...)) : _real(real) {}
+
+    R operator()(A... a) const
+    {
+        if (traceFile)
+            traceBefore(Id<id>(), a...);
+        if constexpr (std::is_void<R>::value) {
+            {
+                CallTimer timer(id);
+                _real(a...);
+            }
+            if (traceFile)
+                traceAfter(Id<id>(), a...);
+        } else {
+            R r;
+            {
+                CallTimer timer(id);
+                r = _real(a...);
+            }
+            if (traceFile)
+                traceAfter(Id<id>(), r, a...);
+            return r;
+        }
+    }
+};
+
+/* Resolving the real functions */
+
+typedef void (*Proc)();
+static std::atomic<Proc> realFunctions[functionCount];
+
+static Proc realEglGetProcAddress(const char* name)
+{
+    typedef Proc (*F)(const char*);
+    static F f = reinterpret_cast<F>(dlsym(RTLD_NEXT, "eglGetProcAddress"));
+    return f ? f(name) : nullptr;
+}
+
+static Proc realGlXGetProcAddressARB(const GLubyte* name)
+{
+    typedef Proc (*F)(const GLubyte*);
+    static F f = reinterpret_cast<F>(dlsym(RTLD_NEXT, "glXGetProcAddressARB"));
+    return f ? f(name) : nullptr;
+}
+
+static Proc resolve(int id)
+{
+    Proc p = realFunctions[id].load(std::memory_order_relaxed);
+    if (!p) {
+        const char* name = functionNames[id];
+        p = reinterpret_cast<Proc>(dlsym(RTLD_NEXT, name));
+        if (!p && name[0] == 'g')
+            p = realGlXGetProcAddressARB(reinterpret_cast<const GLubyte*>(name));
+        if (!p)
+            p = realEglGetProcAddress(name);
+        if (!p) {
+            fprintf(stderr, "glinf-interpose: cannot resolve %s\n", name);
+            abort();
+        }
+        realFunctions[id].store(p, std::memory_order_relaxed);
+    }
+    return p;
+}
+
+/* The wrappers */
+
+#define F(ret, name, params, args) \
+    extern "C" __attribute__((visibility("default"))) ret name params \
+    { \
+        typedef ret (*Real) params; \
+        Real real = reinterpret_cast<Real>(resolve(id_##name)); \
+        return Call<id_##name, Real>(real) args; \
+    }
+GLINF_FUNCTIONS(F)
+#undef F
+
+static const Proc wrappers[] = {
+#define F(ret, name, params, args) reinterpret_cast<Proc>(name),
+    GLINF_FUNCTIONS(F)
+#undef F
+};
+
+/* Return our wrapper for a wrapped function, and remember the real address */
+static Proc interpose(const char* name, Proc real)
+{
+    if (!real || !name)
+        return real;
+    for (int id = 0; id < functionCount; id++) {
+        if (strcmp(name, functionNames[id]) == 0) {
+            Proc expected = nullptr;
+            realFunctions[id].compare_exchange_strong(expected, real);
+            return wrappers[id];
+        }
+    }
+    return real;
+}
+
+extern "C" __attribute__((visibility("default"))) Proc eglGetProcAddress(const char* name)
+{
+    return interpose(name, realEglGetProcAddress(name));
+}
+
+extern "C" __attribute__((visibility("default"))) Proc glXGetProcAddressARB(const GLubyte* name)
+{
+    return interpose(reinterpret_cast<const char*>(name), realGlXGetProcAddressARB(name));
+}
+
+extern "C" __attribute__((visibility("default"))) Proc glXGetProcAddress(const GLubyte* name)
+{
+    return glXGetProcAddressARB(name);
+}
+
+/* The report */
+
+static void printTime(FILE* f, const char* label, double ns)
+{
+    if (ns >= 1e6)
+        fprintf(f, "      %-12s %12.3f ms\n", label, ns / 1e6);
+    else
+        fprintf(f, "      %-12s %12.3f us\n", label, ns / 1e3);
+}
+
+__attribute__((destructor)) static void report()
+{
+    uint64_t calls[functionCount] = {};
+    uint64_t ns[functionCount] = {};
+    uint64_t maxNs[functionCount] = {};
+    static uint64_t histogram[functionCount][bucketCount];
+    int threads = 0;
+    for (ThreadStats* s = allStats.load(); s; s = s->next) {
+        threads++;
+        for (int id = 0; id < functionCount; id++) {
+            calls[id] += s->calls[id].load(std::memory_order_relaxed);
+            ns[id] += s->ns[id].load(std::memory_order_relaxed);
+            uint64_t m = s->maxNs[id].load(std::memory_order_relaxed);
+            if (m > maxNs[id])
+                maxNs[id] = m;
+            for (int b = 0; b < bucketCount; b++)
+                histogram[id][b] += s->histogram[id][b].load(std::memory_order_relaxed);
+        }
+    }
+
+    FILE* f = stderr;
+    const char* fileName = getenv("GLINF_INTERPOSE_OUTPUT");
+    if (fileName && fileName[0]) {
+        f = fopen(fileName, "w");
+        if (!f) {
+            fprintf(stderr, "glinf-interpose: cannot open %s\n", fileName);
+            f = stderr;
+        }
+    }
+    fprintf(f, "GL call statistics (%d threads):\n", threads);
+    for (int id = 0; id < functionCount; id++) {
+        if (calls[id] == 0)
+            continue;
+        fprintf(f, "    %s:\n", functionNames[id]);
+        fprintf(f, "      %-12s %12llu\n", "calls", static_cast<unsigned long long>(calls[id]));
+        printTime(f, "total", ns[id]);
+        printTime(f, "mean", double(ns[id]) / calls[id]);
+        printTime(f, "max", maxNs[id]);
+        uint64_t sum = 0;
+        bool havePercentiles[3] = { false, false, false };
+        const double percentiles[3] = { 0.5, 0.9, 0.99 };
+        const char* percentileLabels[3] = { "p50 <", "p90 <", "p99 <" };
+        for (int b = 0; b < bucketCount; b++) {
+            sum += histogram[id][b];
+            for (int p = 0; p < 3; p++) {
+                if (!havePercentiles[p] && sum >= percentiles[p] * calls[id]) {
+                    printTime(f, percentileLabels[p], double(uint64_t(1) << (b + 1)));
+                    havePercentiles[p] = true;
+                }
+            }
+        }
+        fprintf(f, "      histogram:\n");
+        for (int b = 0; b < bucketCount; b++) {
+            if (histogram[id][b] == 0)
+                continue;
+            double lo = (b == 0 ? 0.0 : double(uint64_t(1) << b));
+            double hi = double(uint64_t(1) << (b + 1));
+            fprintf(f, "        [%10.3f us, %10.3f us): %12llu\n", lo / 1e3, hi / 1e3,
+                    static_cast<unsigned long long>(histogram[id][b]));
+        }
+    }
+    if (f != stderr)
+        fclose(f);
+}
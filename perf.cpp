@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstring>
+
+#ifdef __linux__
+# include <unistd.h>
+# include <sys/ioctl.h>
+# include <sys/syscall.h>
+# include <linux/perf_event.h>
+# include <QDir>
+#endif
+
+#include "perf.hpp"
+
+PerfCounters::PerfCounters()
+{
+    for (int c = 0; c < CounterCount; c++) {
+        available[c] = false;
+        values[c] = 0;
+    }
+}
+
+PerfCounters::~PerfCounters()
+{
+    stop();
+}
+
+const char* PerfCounters::name(Counter counter)
+{
+    static const char* names[] = { "cpu cycles", "instructions", "cache misses", "context switches" };
+    return names[counter];
+}
+
+#ifdef __linux__
+
+static int openCounter(PerfCounters::Counter counter, pid_t tid)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    switch (counter) {
+    case PerfCounters::Cycles:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+    case PerfCounters::Instructions:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+    case PerfCounters::CacheMisses:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        break;
+    case PerfCounters::ContextSwitches:
+    case PerfCounters::CounterCount:
+        attr.type = PERF_TYPE_SOFTWARE;
+        attr.config = PERF_COUNT_SW_CONTEXT_SWITCHES;
+        break;
+    }
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // Driver time spent in the kernel is interesting, but may not be permitted
+    int fd = syscall(SYS_perf_event_open, &attr, tid, -1, -1, 0);
+    if (fd < 0) {
+        attr.exclude_kernel = 1;
+        fd = syscall(SYS_perf_event_open, &attr, tid, -1, -1, 0);
+    }
+    return fd;
+}
+
+bool PerfCounters::start()
+{
+    stop();
+    QStringList tasks = QDir("/proc/self/task").entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    bool any = false;
+    for (int c = 0; c < CounterCount; c++) {
+        for (const QString& task : tasks) {
+            int fd = openCounter(static_cast<Counter>(c), task.toInt());
+            if (fd >= 0)
+                _fds[c].append(fd);
+        }
+        available[c] = !_fds[c].isEmpty();
+        any = any || available[c];
+    }
+    for (int c = 0; c < CounterCount; c++) {
+        for (int fd : _fds[c]) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+    return any;
+}
+
+void PerfCounters::stop()
+{
+    for (int c = 0; c < CounterCount; c++)
+        for (int fd : _fds[c])
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    for (int c = 0; c < CounterCount; c++) {
+        if (_fds[c].isEmpty())
+            continue;
+        values[c] = 0;
+        for (int fd : _fds[c]) {
+            unsigned long long v[3]; // value, time enabled, time running
+            if (read(fd, v, sizeof(v)) == sizeof(v) && v[2] > 0) {
+                // scale if the counter was multiplexed
+                values[c] += (v[2] < v[1] ? static_cast<unsigned long long>(double(v[0]) * v[1] / v[2]) : v[0]);
+            }
+            close(fd);
+        }
+        _fds[c].clear();
+    }
+}
+
+#else
+
+bool PerfCounters::start()
+{
+    return false;
+}
+
+void PerfCounters::stop()
+{
+}
+
+#endif
+
+void PerfProbe::begin()
+{
+    _counters.start();
+}
+
+void PerfProbe::end(Result& result)
+{
+    _counters.stop();
+    for (int c = 0; c < PerfCounters::CounterCount; c++) {
+        if (_counters.available[c]) {
+            PerfCounters::Counter counter = static_cast<PerfCounters::Counter>(c);
+            result.add(QString(PerfCounters::name(counter)) + " per iteration",
+                    double(_counters.values[c]) / result.iterations, "");
+        }
+    }
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef PERF_HPP
+#define PERF_HPP
+
+#include <QList>
+
+#include "benchmark.hpp"
+
+/* CPU performance counters via perf_event_open (Linux only). The counters
+ * cover all threads of the process, including threads that a driver creates
+ * while counting. */
+class PerfCounters
+{
+public:
+    enum Counter { Cycles, Instructions, CacheMisses, ContextSwitches, CounterCount };
+
+private:
+    QList<int> _fds[CounterCount];
+
+public:
+    bool available[CounterCount];
+    unsigned long long values[CounterCount];
+
+    PerfCounters();
+    ~PerfCounters();
+
+    // Start counting and update available[]. Returns false if no counter is available.
+    bool start();
+    // Stop counting and update values[]
+    void stop();
+
+    static const char* name(Counter counter);
+};
+
+/* A probe that reports CPU counters per iteration */
+class PerfProbe : public Probe
+{
+private:
+    PerfCounters _counters;
+
+public:
+    void begin() override;
+    void end(Result& result) override;
+};
+
+#endif
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+
+#include "pipelinestats.hpp"
+
+#ifndef GL_VERTICES_SUBMITTED
+# define GL_VERTICES_SUBMITTED 0x82EE
+# define GL_PRIMITIVES_SUBMITTED 0x82EF
+# define GL_VERTEX_SHADER_INVOCATIONS 0x82F0
+# define GL_TESS_CONTROL_SHADER_PATCHES 0x82F1
+# define GL_TESS_EVALUATION_SHADER_INVOCATIONS 0x82F2
+# define GL_GEOMETRY_SHADER_PRIMITIVES_EMITTED 0x82F3
+# define GL_FRAGMENT_SHADER_INVOCATIONS 0x82F4
+# define GL_COMPUTE_SHADER_INVOCATIONS 0x82F5
+# define GL_CLIPPING_INPUT_PRIMITIVES 0x82F6
+# define GL_CLIPPING_OUTPUT_PRIMITIVES 0x82F7
+#endif
+#ifndef GL_GEOMETRY_SHADER_INVOCATIONS
+# define GL_GEOMETRY_SHADER_INVOCATIONS 0x887F
+#endif
+
+typedef void (QOPENGLF_APIENTRYP GetQueryObjectui64v)(GLuint id, GLenum pname, GLuint64* params);
+
+static const struct {
+    GLenum target;
+    const char* name;
+} statistics[] = {
+    { GL_VERTICES_SUBMITTED, "vertices submitted" },
+    { GL_PRIMITIVES_SUBMITTED, "primitives submitted" },
+    { GL_VERTEX_SHADER_INVOCATIONS, "vertex shader invocations" },
+    { GL_TESS_CONTROL_SHADER_PATCHES, "tess. control shader patches" },
+    { GL_TESS_EVALUATION_SHADER_INVOCATIONS, "tess. evaluation shader invocations" },
+    { GL_GEOMETRY_SHADER_INVOCATIONS, "geometry shader invocations" },
+    { GL_GEOMETRY_SHADER_PRIMITIVES_EMITTED, "geometry shader primitives emitted" },
+    { GL_CLIPPING_INPUT_PRIMITIVES, "clipping input primitives" },
+    { GL_CLIPPING_OUTPUT_PRIMITIVES, "clipping output primitives" },
+    { GL_FRAGMENT_SHADER_INVOCATIONS, "fragment shader invocations" },
+    { GL_COMPUTE_SHADER_INVOCATIONS, "compute shader invocations" }
+};
+
+PipelineStatisticsProbe::PipelineStatisticsProbe(QOpenGLContext* context) : _context(context)
+{
+    _context->extraFunctions()->glGenQueries(11, _queries);
+}
+
+PipelineStatisticsProbe::~PipelineStatisticsProbe()
+{
+    _context->extraFunctions()->glDeleteQueries(11, _queries);
+}
+
+bool PipelineStatisticsProbe::isAvailable(QOpenGLContext* context)
+{
+    return !context->isOpenGLES()
+        && (context->format().majorVersion() > 4
+                || (context->format().majorVersion() == 4 && context->format().minorVersion() >= 6)
+                || context->hasExtension("GL_ARB_pipeline_statistics_query"));
+}
+
+void PipelineStatisticsProbe::begin()
+{
+    QOpenGLExtraFunctions* gl = _context->extraFunctions();
+    for (int i = 0; i < 11; i++)
+        gl->glBeginQuery(statistics[i].target, _queries[i]);
+}
+
+void PipelineStatisticsProbe::end(Result& result)
+{
+    QOpenGLExtraFunctions* gl = _context->extraFunctions();
+    auto getQueryObjectui64v = reinterpret_cast<GetQueryObjectui64v>(_context->getProcAddress("glGetQueryObjectui64v"));
+    double values[11];
+    for (int i = 0; i < 11; i++)
+        gl->glEndQuery(statistics[i].target);
+    for (int i = 0; i < 11; i++) {
+        GLuint64 v = 0;
+        getQueryObjectui64v(_queries[i], GL_QUERY_RESULT, &v);
+        values[i] = double(v) / result.iterations;
+        if (v > 0)
+            result.add(statistics[i].name, values[i], "per iteration");
+    }
+
+    GLint viewport[4];
+    gl->glGetIntegerv(GL_VIEWPORT, viewport);
+    double pixels = double(viewport[2]) * viewport[3];
+    if (values[9] > 0.0 && pixels > 0.0)
+        result.add("fragment shader invocations per viewport pixel", values[9] / pixels, "");
+    // Clipping may split a primitive into several, so the output count can
+    // exceed the input count; whether culled primitives count as clipping
+    // output depends on the implementation.
+    if (values[7] > 0.0)
+        result.add("primitives discarded by clipping and culling", std::max(0.0, 100.0 * (1.0 - values[8] / values[7])), "%");
+    if (values[0] > 0.0 && values[2] > 0.0)
+        result.add("vertex shader invocations per vertex", values[2] / values[0], "");
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef PIPELINESTATS_HPP
+#define PIPELINESTATS_HPP
+
+#include "benchmark.hpp"
+
+/* A probe that collects pipeline statistics (ARB_pipeline_statistics_query,
+ * core in OpenGL 4.6) per iteration, and derives the number of fragment
+ * shader invocations per viewport pixel (overdraw), the percentage of
+ * primitives discarded by clipping and culling, and the number of vertex
+ * shader invocations per submitted vertex (post-transform cache efficiency). */
+class PipelineStatisticsProbe : public Probe
+{
+private:
+    QOpenGLContext* _context;
+    GLuint _queries[11];
+
+public:
+    PipelineStatisticsProbe(QOpenGLContext* context);
+    ~PipelineStatisticsProbe();
+
+    static bool isAvailable(QOpenGLContext* context);
+
+    void begin() override;
+    void end(Result& result) override;
+};
+
+#endif
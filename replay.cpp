@@ -0,0 +1,745 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QElapsedTimer>
+
+#include "replay.hpp"
+#include "trace.hpp"
+
+/* Reads the payload of one record. Reading past the end yields zeros and
+ * marks the payload as invalid. */
+class Payload
+{
+private:
+    const char* _p;
+    const char* _end;
+
+public:
+    bool valid;
+
+    Payload(const char* p, uint32_t size) : _p(p), _end(p + size), valid(true) {}
+
+    const char* bytes(size_t n)
+    {
+        if (size_t(_end - _p) < n) {
+            valid = false;
+            return nullptr;
+        }
+        const char* p = _p;
+        _p += n;
+        return p;
+    }
+
+    template<typename T> T get()
+    {
+        T v {};
+        const char* p = bytes(sizeof(T));
+        if (p)
+            std::memcpy(&v, p, sizeof(T));
+        return v;
+    }
+
+    uint32_t u32() { return get<uint32_t>(); }
+    int32_t i32() { return get<int32_t>(); }
+    float f32() { return get<float>(); }
+    uint64_t u64() { return get<uint64_t>(); }
+    size_t remaining() const { return _end - _p; }
+    const char* rest() { return bytes(remaining()); }
+};
+
+struct Record
+{
+    uint32_t opcode;
+    uint32_t size;
+    const char* payload;
+};
+
+class Replayer
+{
+private:
+    QOpenGLExtraFunctions* gl;
+    GLuint _framebuffer;        // replaces the default framebuffer
+    QHash<GLuint, GLuint> _buffers, _textures, _vertexArrays, _framebuffers, _shaders, _programs;
+    QHash<quint64, GLint> _uniformLocations;
+    GLuint _program;            // recorded name of the current program
+
+    GLuint name(QHash<GLuint, GLuint>& names, GLuint recorded, void (QOpenGLExtraFunctions::*gen)(GLsizei, GLuint*));
+    void deleteNames(QHash<GLuint, GLuint>& names, Payload& p, void (QOpenGLExtraFunctions::*del)(GLsizei, const GLuint*));
+    GLint location(GLint recorded) const;
+    const void* pixels(Payload& p);
+
+public:
+    long long drawCalls;
+    long long uploadBytes;
+
+    Replayer(QOpenGLExtraFunctions* gl, GLuint framebuffer);
+    ~Replayer();
+
+    bool execute(const Record& r);
+};
+
+Replayer::Replayer(QOpenGLExtraFunctions* gl, GLuint framebuffer) :
+    gl(gl), _framebuffer(framebuffer), _program(0), drawCalls(0), uploadBytes(0)
+{
+}
+
+Replayer::~Replayer()
+{
+    for (GLuint b : _buffers)
+        gl->glDeleteBuffers(1, &b);
+    for (GLuint t : _textures)
+        gl->glDeleteTextures(1, &t);
+    for (GLuint a : _vertexArrays)
+        gl->glDeleteVertexArrays(1, &a);
+    for (GLuint f : _framebuffers)
+        gl->glDeleteFramebuffers(1, &f);
+    for (GLuint s : _shaders)
+        gl->glDeleteShader(s);
+    for (GLuint p : _programs)
+        gl->glDeleteProgram(p);
+}
+
+/* Map a recorded object name to ours; create the object on first use */
+GLuint Replayer::name(QHash<GLuint, GLuint>& names, GLuint recorded, void (QOpenGLExtraFunctions::*gen)(GLsizei, GLuint*))
+{
+    if (recorded == 0)
+        return 0;
+    auto it = names.constFind(recorded);
+    if (it != names.constEnd())
+        return it.value();
+    GLuint n = 0;
+    (gl->*gen)(1, &n);
+    names.insert(recorded, n);
+    return n;
+}
+
+void Replayer::deleteNames(QHash<GLuint, GLuint>& names, Payload& p, void (QOpenGLExtraFunctions::*del)(GLsizei, const GLuint*))
+{
+    uint32_t n = p.u32();
+    for (uint32_t i = 0; i < n && p.valid; i++) {
+        GLuint recorded = p.u32();
+        if (names.contains(recorded)) {
+            GLuint ours = names.take(recorded);
+            (gl->*del)(1, &ours);
+        }
+    }
+}
+
+GLint Replayer::location(GLint recorded) const
+{
+    return _uniformLocations.value((quint64(_program) << 32) | quint32(recorded), recorded);
+}
+
+const void* Replayer::pixels(Payload& p)
+{
+    uint32_t mode = p.u32();
+    uint64_t sizeOrOffset = p.u64();
+    if (mode == TracePixelsInline) {
+        uploadBytes += sizeOrOffset;
+        return p.bytes(sizeOrOffset);
+    }
+    return reinterpret_cast<const void*>(uintptr_t(mode == TracePixelsUnpackBuffer ? sizeOrOffset : 0));
+}
+
+bool Replayer::execute(const Record& r)
+{
+    Payload p(r.payload, r.size);
+    switch (r.opcode) {
+    case TraceFrame:
+        break;
+    case TraceGenBuffers:
+    case TraceGenTextures:
+    case TraceGenVertexArrays:
+    case TraceGenFramebuffers:
+        // Objects are created on first use
+        break;
+    case TraceDeleteBuffers:
+        deleteNames(_buffers, p, &QOpenGLExtraFunctions::glDeleteBuffers);
+        break;
+    case TraceDeleteTextures:
+        deleteNames(_textures, p, &QOpenGLExtraFunctions::glDeleteTextures);
+        break;
+    case TraceDeleteVertexArrays:
+        deleteNames(_vertexArrays, p, &QOpenGLExtraFunctions::glDeleteVertexArrays);
+        break;
+    case TraceDeleteFramebuffers:
+        deleteNames(_framebuffers, p, &QOpenGLExtraFunctions::glDeleteFramebuffers);
+        break;
+    case TraceCreateShader:
+        {
+            GLenum type = p.u32();
+            GLuint recorded = p.u32();
+            _shaders.insert(recorded, gl->glCreateShader(type));
+        }
+        break;
+    case TraceShaderSource:
+        {
+            GLuint shader = _shaders.value(p.u32());
+            GLint length = p.remaining();
+            const char* source = p.rest();
+            gl->glShaderSource(shader, 1, &source, &length);
+        }
+        break;
+    case TraceCompileShader:
+        gl->glCompileShader(_shaders.value(p.u32()));
+        break;
+    case TraceDeleteShader:
+        {
+            GLuint recorded = p.u32();
+            gl->glDeleteShader(_shaders.take(recorded));
+        }
+        break;
+    case TraceCreateProgram:
+        {
+            GLuint recorded = p.u32();
+            _programs.insert(recorded, gl->glCreateProgram());
+        }
+        break;
+    case TraceAttachShader:
+        {
+            GLuint program = _programs.value(p.u32());
+            gl->glAttachShader(program, _shaders.value(p.u32()));
+        }
+        break;
+    case TraceLinkProgram:
+        {
+            GLuint recorded = p.u32();
+            GLuint program = _programs.value(recorded);
+            gl->glLinkProgram(program);
+            GLint status;
+            gl->glGetProgramiv(program, GL_LINK_STATUS, &status);
+            if (status != GL_TRUE)
+                fprintf(stderr, "trace program %u cannot be linked in this context\n", recorded);
+        }
+        break;
+    case TraceDeleteProgram:
+        {
+            GLuint recorded = p.u32();
+            gl->glDeleteProgram(_programs.take(recorded));
+        }
+        break;
+    case TraceUseProgram:
+        _program = p.u32();
+        gl->glUseProgram(_programs.value(_program));
+        break;
+    case TraceGetUniformLocation:
+        {
+            GLuint program = p.u32();
+            GLint recorded = p.i32();
+            QByteArray uniformName(p.rest(), p.remaining());
+            _uniformLocations.insert((quint64(program) << 32) | quint32(recorded),
+                    gl->glGetUniformLocation(_programs.value(program), uniformName.constData()));
+        }
+        break;
+    case TraceUniform1i:
+        {
+            GLint loc = location(p.i32());
+            gl->glUniform1i(loc, p.i32());
+        }
+        break;
+    case TraceUniform1f:
+        {
+            GLint loc = location(p.i32());
+            gl->glUniform1f(loc, p.f32());
+        }
+        break;
+    case TraceUniform4f:
+        {
+            GLint loc = location(p.i32());
+            float v[4] = { p.f32(), p.f32(), p.f32(), p.f32() };
+            gl->glUniform4fv(loc, 1, v);
+        }
+        break;
+    case TraceUniformfv:
+        {
+            uint32_t components = p.u32();
+            GLint loc = location(p.i32());
+            GLsizei count = p.i32();
+            if (count < 0 || components < 1 || components > 4) {
+                p.valid = false;
+                break;
+            }
+            const char* data = p.bytes(size_t(count) * components * sizeof(float));
+            if (!data)
+                break;
+            std::vector<float> v(size_t(count) * components);
+            std::memcpy(v.data(), data, v.size() * sizeof(float));
+            switch (components) {
+            case 1: gl->glUniform1fv(loc, count, v.data()); break;
+            case 2: gl->glUniform2fv(loc, count, v.data()); break;
+            case 3: gl->glUniform3fv(loc, count, v.data()); break;
+            case 4: gl->glUniform4fv(loc, count, v.data()); break;
+            }
+        }
+        break;
+    case TraceUniformMatrixfv:
+        {
+            uint32_t columns = p.u32();
+            GLint loc = location(p.i32());
+            GLsizei count = p.i32();
+            GLboolean transpose = p.u32();
+            if (count < 0 || columns < 2 || columns > 4) {
+                p.valid = false;
+                break;
+            }
+            const char* data = p.bytes(size_t(count) * columns * columns * sizeof(float));
+            if (!data)
+                break;
+            std::vector<float> v(size_t(count) * columns * columns);
+            std::memcpy(v.data(), data, v.size() * sizeof(float));
+            if (columns == 2)
+                gl->glUniformMatrix2fv(loc, count, transpose, v.data());
+            else if (columns == 3)
+                gl->glUniformMatrix3fv(loc, count, transpose, v.data());
+            else
+                gl->glUniformMatrix4fv(loc, count, transpose, v.data());
+        }
+        break;
+    case TraceBindBuffer:
+        {
+            GLenum target = p.u32();
+            gl->glBindBuffer(target, name(_buffers, p.u32(), &QOpenGLExtraFunctions::glGenBuffers));
+        }
+        break;
+    case TraceBindBufferBase:
+        {
+            GLenum target = p.u32();
+            GLuint index = p.u32();
+            gl->glBindBufferBase(target, index, name(_buffers, p.u32(), &QOpenGLExtraFunctions::glGenBuffers));
+        }
+        break;
+    case TraceBindBufferRange:
+        {
+            GLenum target = p.u32();
+            GLuint index = p.u32();
+            GLuint buffer = name(_buffers, p.u32(), &QOpenGLExtraFunctions::glGenBuffers);
+            GLintptr offset = p.u64();
+            GLsizeiptr size = p.u64();
+            gl->glBindBufferRange(target, index, buffer, offset, size);
+        }
+        break;
+    case TraceBufferData:
+        {
+            GLenum target = p.u32();
+            GLenum usage = p.u32();
+            GLsizeiptr size = p.u64();
+            bool hasData = p.u32();
+            if (size < 0) {
+                p.valid = false;
+                break;
+            }
+            const char* data = nullptr;
+            if (hasData) {
+                // the data must be part of the record
+                data = p.bytes(size);
+                if (!data)
+                    break;
+                uploadBytes += size;
+            }
+            gl->glBufferData(target, size, data, usage);
+        }
+        break;
+    case TraceBufferSubData:
+        {
+            GLenum target = p.u32();
+            GLintptr offset = p.u64();
+            GLsizeiptr size = p.u64();
+            const char* data = p.bytes(size);
+            if (data) {
+                uploadBytes += size;
+                gl->glBufferSubData(target, offset, size, data);
+            }
+        }
+        break;
+    case TraceActiveTexture:
+        gl->glActiveTexture(p.u32());
+        break;
+    case TraceBindTexture:
+        {
+            GLenum target = p.u32();
+            gl->glBindTexture(target, name(_textures, p.u32(), &QOpenGLExtraFunctions::glGenTextures));
+        }
+        break;
+    case TraceTexParameteri:
+        {
+            GLenum target = p.u32();
+            GLenum pname = p.u32();
+            gl->glTexParameteri(target, pname, p.i32());
+        }
+        break;
+    case TracePixelStorei:
+        {
+            GLenum pname = p.u32();
+            gl->glPixelStorei(pname, p.i32());
+        }
+        break;
+    case TraceTexImage2D:
+        {
+            GLenum target = p.u32();
+            GLint level = p.i32();
+            GLint internalFormat = p.i32();
+            GLsizei width = p.i32();
+            GLsizei height = p.i32();
+            GLint border = p.i32();
+            GLenum format = p.u32();
+            GLenum type = p.u32();
+            const void* data = pixels(p);
+            if (p.valid)
+                gl->glTexImage2D(target, level, internalFormat, width, height, border, format, type, data);
+        }
+        break;
+    case TraceTexStorage2D:
+        {
+            GLenum target = p.u32();
+            GLsizei levels = p.i32();
+            GLenum internalFormat = p.u32();
+            GLsizei width = p.i32();
+            gl->glTexStorage2D(target, levels, internalFormat, width, p.i32());
+        }
+        break;
+    case TraceTexSubImage2D:
+        {
+            GLenum target = p.u32();
+            GLint level = p.i32();
+            GLint x = p.i32();
+            GLint y = p.i32();
+            GLsizei width = p.i32();
+            GLsizei height = p.i32();
+            GLenum format = p.u32();
+            GLenum type = p.u32();
+            const void* data = pixels(p);
+            if (p.valid)
+                gl->glTexSubImage2D(target, level, x, y, width, height, format, type, data);
+        }
+        break;
+    case TraceGenerateMipmap:
+        gl->glGenerateMipmap(p.u32());
+        break;
+    case TraceBindVertexArray:
+        gl->glBindVertexArray(name(_vertexArrays, p.u32(), &QOpenGLExtraFunctions::glGenVertexArrays));
+        break;
+    case TraceVertexAttribPointer:
+        {
+            GLuint index = p.u32();
+            GLint size = p.i32();
+            GLenum type = p.u32();
+            GLboolean normalized = p.u32();
+            GLsizei stride = p.i32();
+            uintptr_t offset = p.u64();
+            gl->glVertexAttribPointer(index, size, type, normalized, stride, reinterpret_cast<const void*>(offset));
+        }
+        break;
+    case TraceEnableVertexAttribArray:
+        gl->glEnableVertexAttribArray(p.u32());
+        break;
+    case TraceDisableVertexAttribArray:
+        gl->glDisableVertexAttribArray(p.u32());
+        break;
+    case TraceBindFramebuffer:
+        {
+            GLenum target = p.u32();
+            GLuint recorded = p.u32();
+            gl->glBindFramebuffer(target, recorded == 0 ? _framebuffer
+                    : name(_framebuffers, recorded, &QOpenGLExtraFunctions::glGenFramebuffers));
+        }
+        break;
+    case TraceFramebufferTexture2D:
+        {
+            GLenum target = p.u32();
+            GLenum attachment = p.u32();
+            GLenum textarget = p.u32();
+            GLuint texture = name(_textures, p.u32(), &QOpenGLExtraFunctions::glGenTextures);
+            gl->glFramebufferTexture2D(target, attachment, textarget, texture, p.i32());
+        }
+        break;
+    case TraceEnable:
+        gl->glEnable(p.u32());
+        break;
+    case TraceDisable:
+        gl->glDisable(p.u32());
+        break;
+    case TraceBlendFunc:
+        {
+            GLenum sfactor = p.u32();
+            gl->glBlendFunc(sfactor, p.u32());
+        }
+        break;
+    case TraceDepthFunc:
+        gl->glDepthFunc(p.u32());
+        break;
+    case TraceDepthMask:
+        gl->glDepthMask(p.u32());
+        break;
+    case TraceColorMask:
+        {
+            GLboolean r = p.u32();
+            GLboolean g = p.u32();
+            GLboolean b = p.u32();
+            gl->glColorMask(r, g, b, p.u32());
+        }
+        break;
+    case TraceViewport:
+    case TraceScissor:
+        {
+            GLint x = p.i32();
+            GLint y = p.i32();
+            GLsizei width = p.i32();
+            GLsizei height = p.i32();
+            if (r.opcode == TraceViewport)
+                gl->glViewport(x, y, width, height);
+            else
+                gl->glScissor(x, y, width, height);
+        }
+        break;
+    case TraceClearColor:
+        {
+            float c[4] = { p.f32(), p.f32(), p.f32(), p.f32() };
+            gl->glClearColor(c[0], c[1], c[2], c[3]);
+        }
+        break;
+    case TraceClearDepth:
+        gl->glClearDepthf(p.f32());
+        break;
+    case TraceClear:
+        gl->glClear(p.u32());
+        break;
+    case TraceDrawArrays:
+        {
+            GLenum mode = p.u32();
+            GLint first = p.i32();
+            GLsizei count = p.i32();
+            GLsizei instances = p.i32();
+            gl->glDrawArraysInstanced(mode, first, count, instances);
+            drawCalls++;
+        }
+        break;
+    case TraceDrawElements:
+        {
+            GLenum mode = p.u32();
+            GLsizei count = p.i32();
+            GLenum type = p.u32();
+            const void* offset = reinterpret_cast<const void*>(uintptr_t(p.u64()));
+            GLsizei instances = p.i32();
+            GLint baseVertex = p.i32();
+            if (baseVertex != 0)
+                gl->glDrawElementsInstancedBaseVertex(mode, count, type, offset, instances, baseVertex);
+            else
+                gl->glDrawElementsInstanced(mode, count, type, offset, instances);
+            drawCalls++;
+        }
+        break;
+    case TraceDispatchCompute:
+        {
+            GLuint x = p.u32();
+            GLuint y = p.u32();
+            gl->glDispatchCompute(x, y, p.u32());
+        }
+        break;
+    case TraceMemoryBarrier:
+        gl->glMemoryBarrier(p.u32());
+        break;
+    default:
+        // Unknown records (from newer recorders) are skipped
+        break;
+    }
+    return p.valid;
+}
+
+bool replayTrace(Bench& bench, const QString& fileName, bool paced)
+{
+    QOpenGLExtraFunctions* gl = bench.gl;
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        fprintf(stderr, "%s: %s\n", qPrintable(fileName), qPrintable(file.errorString()));
+        return false;
+    }
+    QByteArray data = file.readAll();
+    if (data.size() < int(sizeof(traceMagic)) || std::memcmp(data.constData(), traceMagic, sizeof(traceMagic)) != 0) {
+        fprintf(stderr, "%s: not a glinf trace\n", qPrintable(fileName));
+        return false;
+    }
+
+    // Split the file into records and frames, and find the size of the
+    // recorded default framebuffer from the viewports used with it
+    QList<Record> records;
+    QList<int> frameEnds;               // index of the TraceFrame record of each frame
+    QList<uint64_t> frameTimes;         // recorded end of each frame in ns
+    int width = 0, height = 0;
+    bool defaultFramebuffer = true;
+    const char* p = data.constData() + sizeof(traceMagic);
+    const char* end = data.constData() + data.size();
+    while (p < end) {
+        Record r;
+        if (end - p < 8) {
+            fprintf(stderr, "%s: truncated record\n", qPrintable(fileName));
+            return false;
+        }
+        std::memcpy(&r.opcode, p, 4);
+        std::memcpy(&r.size, p + 4, 4);
+        r.payload = p + 8;
+        if (uint64_t(end - r.payload) < r.size) {
+            fprintf(stderr, "%s: truncated record\n", qPrintable(fileName));
+            return false;
+        }
+        p = r.payload + r.size;
+        Payload payload(r.payload, r.size);
+        if (r.opcode == TraceFrame) {
+            frameEnds.append(records.size());
+            frameTimes.append(payload.u64());
+        } else if (r.opcode == TraceBindFramebuffer) {
+            GLenum target = payload.u32();
+            if (target != GL_READ_FRAMEBUFFER)
+                defaultFramebuffer = (payload.u32() == 0);
+        } else if (r.opcode == TraceViewport && defaultFramebuffer) {
+            payload.u64();
+            width = std::max(width, payload.i32());
+            height = std::max(height, payload.i32());
+        }
+        records.append(r);
+    }
+    if (frameEnds.isEmpty()) {
+        fprintf(stderr, "%s: no frames\n", qPrintable(fileName));
+        return false;
+    }
+    if (width <= 0 || height <= 0) {
+        width = 1920;
+        height = 1080;
+    }
+
+    GLint vao;
+    gl->glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vao);
+    GLuint colorTex = bench.texture(GL_RGBA8, width, height);
+    GLuint depthTex = bench.texture(GL_DEPTH24_STENCIL8, width, height);
+    GLuint fbo = bench.framebuffer(colorTex, 0);
+    gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTex, 0);
+    gl->glViewport(0, 0, width, height);
+
+    QString benchmark = QString("replay %1").arg(QFileInfo(fileName).fileName());
+    bench.begin(benchmark);
+    bool ok = true;
+    {
+        Replayer replayer(gl, fbo);
+        auto replay = [&](int first, int last) {
+            for (int i = first; i <= last; i++) {
+                if (!replayer.execute(records[i]) && ok) {
+                    fprintf(stderr, "%s: invalid record %d\n", qPrintable(fileName), i);
+                    ok = false;
+                }
+            }
+            gl->glFinish();
+        };
+        QElapsedTimer timer;
+
+        // The first frame includes loading the resources and is reported separately
+        timer.start();
+        replay(0, frameEnds[0]);
+        bench.addResult(benchmark, "first frame", 1, timer.nsecsElapsed() / 1e9);
+
+        // The remaining frames
+        int frames = frameEnds.size() - 1;
+        if (frames > 0) {
+            std::vector<double> seconds(frames);
+            int late = 0;
+            replayer.drawCalls = 0;
+            replayer.uploadBytes = 0;
+            bench.startProbes();
+            QElapsedTimer total;
+            total.start();
+            for (int f = 1; f <= frames; f++) {
+                // With pacing, frame f starts when frame f-1 ended in the recording
+                double start = (frameTimes[f - 1] - frameTimes[0]) / 1e9;
+                if (paced) {
+                    double wait = start - total.nsecsElapsed() / 1e9;
+                    if (wait > 0.0)
+                        std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+                }
+                timer.start();
+                replay(frameEnds[f - 1] + 1, frameEnds[f]);
+                seconds[f - 1] = timer.nsecsElapsed() / 1e9;
+                if (paced && total.nsecsElapsed() / 1e9 > (frameTimes[f] - frameTimes[0]) / 1e9)
+                    late++;
+            }
+            double totalSeconds = total.nsecsElapsed() / 1e9;
+            std::vector<double> sorted = seconds;
+            std::sort(sorted.begin(), sorted.end());
+            double sum = 0.0;
+            for (double s : sorted)
+                sum += s;
+            auto percentile = [&](double q) { return sorted[std::min(frames - 1, int(std::ceil(q * frames)) - 1)]; };
+            Result& r = bench.addResult(benchmark, QString("frames 2-%1%2").arg(frames + 1).arg(paced ? " (paced)" : ""),
+                    frames, sum / frames);
+            r.add("frame time median", percentile(0.5) * 1e3, "ms");
+            r.add("frame time 90th percentile", percentile(0.9) * 1e3, "ms");
+            r.add("frame time 99th percentile", percentile(0.99) * 1e3, "ms");
+            r.add("frame time maximum", sorted.back() * 1e3, "ms");
+            r.add("frame rate", frames / totalSeconds, "1/s");
+            r.add("draw calls", double(replayer.drawCalls) / frames, "per frame");
+            r.add("uploads", replayer.uploadBytes / 1e6 / frames, "MB per frame");
+            if (paced) {
+                r.add("recorded frame rate", frames / ((frameTimes[frames] - frameTimes[0]) / 1e9), "1/s");
+                r.add("frames later than recorded", late, "");
+            }
+            int slowest = std::max_element(seconds.begin(), seconds.end()) - seconds.begin();
+            r.notes.append(QString("slowest frame: %1").arg(slowest + 2));
+        }
+
+        // Remaining records, e.g. cleanup
+        replay(frameEnds.last() + 1, records.size() - 1);
+        bench.flush();
+    }
+
+    gl->glBindVertexArray(vao);
+    gl->glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    gl->glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    gl->glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    gl->glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    gl->glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, 0);
+    gl->glPixelStorei(GL_UNPACK_SKIP_IMAGES, 0);
+    gl->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    gl->glBindBuffer(GL_ARRAY_BUFFER, 0);
+    gl->glActiveTexture(GL_TEXTURE0);
+    gl->glDisable(GL_DEPTH_TEST);
+    gl->glDisable(GL_STENCIL_TEST);
+    gl->glDisable(GL_CULL_FACE);
+    gl->glDisable(GL_BLEND);
+    gl->glDisable(GL_SCISSOR_TEST);
+    gl->glDepthMask(GL_TRUE);
+    gl->glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    gl->glUseProgram(0);
+    gl->glDeleteFramebuffers(1, &fbo);
+    gl->glDeleteTextures(1, &depthTex);
+    gl->glDeleteTextures(1, &colorTex);
+    return ok;
+}
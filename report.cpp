@@ -0,0 +1,492 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+
+#include <QFile>
+#include <QFileInfo>
+#include <QMap>
+#include <QDateTime>
+#include <QSysInfo>
+#include <QJsonDocument>
+#include <QJsonArray>
+
+#include "report.hpp"
+
+bool writeResults(const QString& fileName, const QJsonObject& context, const QList<Result>& results)
+{
+    QJsonArray resultArray;
+    for (const Result& r : results) {
+        QJsonArray metrics;
+        for (const Metric& m : r.metrics)
+            metrics.append(QJsonObject { { "name", m.name }, { "value", m.value }, { "unit", m.unit } });
+        QJsonArray notes;
+        for (const QString& note : r.notes)
+            notes.append(note);
+        resultArray.append(QJsonObject {
+                { "benchmark", r.benchmark },
+                { "name", r.name },
+                { "iterations", r.iterations },
+                { "seconds", r.seconds },
+                { "metrics", metrics },
+                { "notes", notes } });
+    }
+    QJsonObject root {
+        { "host", QSysInfo::machineHostName() },
+        { "date", QDateTime::currentDateTimeUtc().toString(Qt::ISODate) },
+        { "context", context },
+        { "results", resultArray } };
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)
+            || file.write(QJsonDocument(root).toJson()) < 0 || !file.flush()) {
+        fprintf(stderr, "%s: %s\n", qPrintable(fileName), qPrintable(file.errorString()));
+        return false;
+    }
+    return true;
+}
+
+/* One result file */
+struct Run
+{
+    QString label;
+    QString host;
+    QString date;
+    QJsonObject context;
+    QMap<QString, Result> results;     // key: benchmark + '\n' + name
+};
+
+static QString key(const QString& benchmark, const QString& name)
+{
+    return benchmark + '\n' + name;
+}
+
+static bool readRun(const QString& fileName, Run& run, QStringList& benchmarks, QMap<QString, QStringList>& cases)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        fprintf(stderr, "%s: %s\n", qPrintable(fileName), qPrintable(file.errorString()));
+        return false;
+    }
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &error);
+    if (error.error != QJsonParseError::NoError) {
+        fprintf(stderr, "%s: %s at offset %d\n", qPrintable(fileName), qPrintable(error.errorString()), int(error.offset));
+        return false;
+    }
+    QJsonObject root = doc.object();
+    if (!root.value("results").isArray()) {
+        fprintf(stderr, "%s: not a glinf result file\n", qPrintable(fileName));
+        return false;
+    }
+    run.label = QFileInfo(fileName).completeBaseName();
+    run.host = root.value("host").toString();
+    run.date = root.value("date").toString();
+    run.context = root.value("context").toObject();
+    for (const QJsonValue& v : root.value("results").toArray()) {
+        QJsonObject o = v.toObject();
+        Result r;
+        r.benchmark = o.value("benchmark").toString();
+        r.name = o.value("name").toString();
+        r.iterations = o.value("iterations").toDouble();
+        r.seconds = o.value("seconds").toDouble();
+        for (const QJsonValue& m : o.value("metrics").toArray())
+            r.metrics.append({ m.toObject().value("name").toString(), m.toObject().value("value").toDouble(),
+                    m.toObject().value("unit").toString() });
+        for (const QJsonValue& n : o.value("notes").toArray())
+            r.notes.append(n.toString());
+        if (r.benchmark.isEmpty() || r.name.isEmpty() || r.seconds <= 0.0) {
+            fprintf(stderr, "%s: invalid result\n", qPrintable(fileName));
+            return false;
+        }
+        if (!benchmarks.contains(r.benchmark))
+            benchmarks.append(r.benchmark);
+        if (!cases[r.benchmark].contains(r.name))
+            cases[r.benchmark].append(r.name);
+        run.results.insert(key(r.benchmark, r.name), r);
+    }
+    return true;
+}
+
+/* Split a case name such as "RGBA8 1920x1080" or "glBufferSubData 64 KiB"
+ * into the name of a scaling series, with the last size replaced by '#', and
+ * the size itself (the pixel count for WIDTHxHEIGHT). */
+static bool scalingParameter(const QString& name, QString& series, double& x)
+{
+    int end = name.length();
+    while (end > 0 && !name[end - 1].isDigit())
+        end--;
+    if (end == 0 || (end < name.length() && name[end].isLetterOrNumber()))
+        return false;
+    int start = end;
+    while (start > 0 && name[start - 1].isDigit())
+        start--;
+    x = name.mid(start, end - start).toDouble();
+    if (start > 1 && name[start - 1] == QChar('x') && name[start - 2].isDigit()) {
+        int widthStart = start - 1;
+        while (widthStart > 0 && name[widthStart - 1].isDigit())
+            widthStart--;
+        x *= name.mid(widthStart, start - 1 - widthStart).toDouble();
+        start = widthStart;
+    }
+    if (start > 0 && name[start - 1].isLetterOrNumber())
+        return false;
+    series = name.left(start) + '#' + name.mid(end);
+    return x > 0.0;
+}
+
+static QString num(double v)
+{
+    return QString::number(v, 'g', 4);
+}
+
+static const char* colors[] = {
+    "#4e79a7", "#f28e2b", "#e15759", "#76b7b2", "#59a14f",
+    "#edc948", "#b07aa1", "#ff9da7", "#9c755f", "#bab0ac"
+};
+
+static QString color(int i)
+{
+    return colors[i % int(sizeof(colors) / sizeof(colors[0]))];
+}
+
+/* Chart axis, linear from zero or logarithmic if the values span a large range */
+class Axis
+{
+public:
+    double min, max;
+    bool log;
+
+    Axis(double lo, double hi, bool allowLog)
+    {
+        log = allowLog && lo > 0.0 && hi / lo > 20.0;
+        if (log) {
+            min = std::pow(10.0, std::floor(std::log10(lo)));
+            max = std::pow(10.0, std::ceil(std::log10(hi)));
+        } else {
+            min = 0.0;
+            double step = this->step(hi > 0.0 ? hi : 1.0);
+            max = std::ceil(hi / step) * step;
+            if (max <= 0.0)
+                max = step;
+        }
+    }
+
+    static double step(double range)
+    {
+        double p = std::pow(10.0, std::floor(std::log10(range / 5.0)));
+        double f = range / 5.0 / p;
+        return (f <= 1.0 ? 1.0 : f <= 2.0 ? 2.0 : f <= 5.0 ? 5.0 : 10.0) * p;
+    }
+
+    // Map a value to [0,1]
+    double map(double v) const
+    {
+        if (log)
+            return (std::log10(std::max(v, min)) - std::log10(min)) / (std::log10(max) - std::log10(min));
+        return (v - min) / (max - min);
+    }
+
+    QList<double> ticks() const
+    {
+        QList<double> t;
+        if (log) {
+            for (double v = min; v <= max * 1.001; v *= 10.0)
+                t.append(v);
+        } else {
+            double s = step(max);
+            for (double v = 0.0; v <= max * 1.001; v += s)
+                t.append(v);
+        }
+        return t;
+    }
+};
+
+struct Series
+{
+    QString name;
+    QList<double> x, y;
+};
+
+/* A line chart of y over x for several series, with a legend on the right */
+static QString lineChart(const QString& title, const QString& yUnit, const QList<Series>& series)
+{
+    const double w = 640, h = 300, left = 70, right = 170, top = 30, bottom = 40;
+    double xLo = 1e300, xHi = 0.0, yLo = 1e300, yHi = 0.0;
+    for (const Series& s : series) {
+        for (int i = 0; i < s.x.size(); i++) {
+            xLo = std::min(xLo, s.x[i]);
+            xHi = std::max(xHi, s.x[i]);
+            yLo = std::min(yLo, s.y[i]);
+            yHi = std::max(yHi, s.y[i]);
+        }
+    }
+    Axis xAxis(xLo, xHi, true), yAxis(yLo, yHi, true);
+    auto px = [&](double x) { return left + xAxis.map(x) * (w - left - right); };
+    auto py = [&](double y) { return h - bottom - yAxis.map(y) * (h - top - bottom); };
+
+    QString svg = QString("<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%1\" height=\"%2\">\n").arg(w).arg(h);
+    svg += QString("<text x=\"%1\" y=\"18\" class=\"title\">%2</text>\n").arg(left).arg(title.toHtmlEscaped());
+    for (double t : xAxis.ticks()) {
+        svg += QString("<line x1=\"%1\" y1=\"%2\" x2=\"%1\" y2=\"%3\" class=\"grid\"/>"
+                "<text x=\"%1\" y=\"%4\" text-anchor=\"middle\">%5</text>\n")
+            .arg(px(t)).arg(top).arg(h - bottom).arg(h - bottom + 16).arg(num(t));
+    }
+    for (double t : yAxis.ticks()) {
+        svg += QString("<line x1=\"%1\" y1=\"%2\" x2=\"%3\" y2=\"%2\" class=\"grid\"/>"
+                "<text x=\"%4\" y=\"%5\" text-anchor=\"end\">%6</text>\n")
+            .arg(left).arg(py(t)).arg(w - right).arg(left - 6).arg(py(t) + 4).arg(num(t));
+    }
+    svg += QString("<text x=\"%1\" y=\"%2\" text-anchor=\"middle\">%3</text>\n")
+        .arg((left + w - right) / 2).arg(h - 6).arg(xAxis.log ? "# (log scale)" : "#");
+    svg += QString("<text x=\"12\" y=\"%1\" transform=\"rotate(-90 12 %1)\" text-anchor=\"middle\">%2</text>\n")
+        .arg((top + h - bottom) / 2).arg(yUnit.toHtmlEscaped() + (yAxis.log ? " (log scale)" : ""));
+    for (int i = 0; i < series.size(); i++) {
+        const Series& s = series[i];
+        QString points;
+        for (int j = 0; j < s.x.size(); j++)
+            points += QString("%1,%2 ").arg(px(s.x[j])).arg(py(s.y[j]));
+        svg += QString("<polyline points=\"%1\" fill=\"none\" stroke=\"%2\" stroke-width=\"2\"/>\n").arg(points.trimmed()).arg(color(i));
+        for (int j = 0; j < s.x.size(); j++)
+            svg += QString("<circle cx=\"%1\" cy=\"%2\" r=\"3\" fill=\"%3\"><title>%4: %5 %6</title></circle>\n")
+                .arg(px(s.x[j])).arg(py(s.y[j])).arg(color(i)).arg(s.name.toHtmlEscaped()).arg(num(s.y[j])).arg(yUnit);
+        svg += QString("<rect x=\"%1\" y=\"%2\" width=\"10\" height=\"10\" fill=\"%3\"/><text x=\"%4\" y=\"%5\">%6</text>\n")
+            .arg(w - right + 16).arg(top + 16 * i).arg(color(i)).arg(w - right + 30).arg(top + 16 * i + 9).arg(s.name.toHtmlEscaped());
+    }
+    svg += "</svg>\n";
+    return svg;
+}
+
+/* A horizontal bar chart of the speed of each run relative to the baseline,
+ * grouped by case */
+static QString speedChart(const QString& title, const QList<Run>& runs, const QString& benchmark, const QStringList& names)
+{
+    const double w = 760, left = 300, right = 20, top = 30, bar = 10, gap = 10;
+    double groupHeight = runs.size() * bar + gap;
+    double h = top + names.size() * groupHeight + 30;
+    double hi = 1.0;
+    for (const QString& name : names) {
+        Result base = runs[0].results.value(key(benchmark, name));
+        for (const Run& run : runs)
+            if (base.seconds > 0.0 && run.results.contains(key(benchmark, name)))
+                hi = std::max(hi, base.seconds / run.results.value(key(benchmark, name)).seconds);
+    }
+    Axis axis(0.0, hi, false);
+    auto px = [&](double v) { return left + axis.map(v) * (w - left - right); };
+
+    QString svg = QString("<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%1\" height=\"%2\">\n").arg(w).arg(h);
+    svg += QString("<text x=\"%1\" y=\"18\" class=\"title\">%2</text>\n").arg(left).arg(title.toHtmlEscaped());
+    for (double t : axis.ticks()) {
+        svg += QString("<line x1=\"%1\" y1=\"%2\" x2=\"%1\" y2=\"%3\" class=\"%4\"/>"
+                "<text x=\"%1\" y=\"%5\" text-anchor=\"middle\">%6%</text>\n")
+            .arg(px(t)).arg(top).arg(h - 30).arg(t == 1.0 ? "base" : "grid").arg(h - 14).arg(num(t * 100.0));
+    }
+    for (int c = 0; c < names.size(); c++) {
+        double y = top + c * groupHeight;
+        svg += QString("<text x=\"%1\" y=\"%2\" text-anchor=\"end\">%3</text>\n")
+            .arg(left - 6).arg(y + runs.size() * bar / 2 + 4).arg(names[c].toHtmlEscaped());
+        Result base = runs[0].results.value(key(benchmark, names[c]));
+        for (int r = 0; r < runs.size(); r++) {
+            if (base.seconds <= 0.0 || !runs[r].results.contains(key(benchmark, names[c])))
+                continue;
+            double speed = base.seconds / runs[r].results.value(key(benchmark, names[c])).seconds;
+            svg += QString("<rect x=\"%1\" y=\"%2\" width=\"%3\" height=\"%4\" fill=\"%5\"><title>%6: %7%</title></rect>\n")
+                .arg(left).arg(y + r * bar).arg(px(speed) - left).arg(bar - 1).arg(color(r))
+                .arg(runs[r].label.toHtmlEscaped()).arg(num(speed * 100.0));
+        }
+    }
+    svg += "</svg>\n";
+    return svg;
+}
+
+static const char* style =
+    "body { font-family: sans-serif; margin: 2em; }\n"
+    "table { border-collapse: collapse; margin: 1em 0; }\n"
+    "th, td { border: 1px solid #ccc; padding: 0.2em 0.6em; text-align: left; }\n"
+    "td.num { text-align: right; font-variant-numeric: tabular-nums; }\n"
+    "tr.metric td { color: #555; font-size: 90%; }\n"
+    "tr.metric td:first-child { padding-left: 2em; }\n"
+    ".slower { color: #c00; } .faster { color: #080; }\n"
+    "svg { display: block; margin: 1em 0; font-size: 11px; }\n"
+    "svg .title { font-size: 13px; font-weight: bold; }\n"
+    "svg .grid { stroke: #ddd; } svg .base { stroke: #000; }\n";
+
+bool writeReport(const QStringList& resultFileNames, const QString& fileName)
+{
+    if (resultFileNames.isEmpty()) {
+        fprintf(stderr, "no result files given\n");
+        return false;
+    }
+    QList<Run> runs;
+    QStringList benchmarks;
+    QMap<QString, QStringList> cases;
+    for (const QString& resultFileName : resultFileNames) {
+        Run run;
+        if (!readRun(resultFileName, run, benchmarks, cases))
+            return false;
+        runs.append(run);
+    }
+    const Run& baseline = runs[0];
+
+    QString html = "<!DOCTYPE html>\n<html>\n<head>\n<meta charset=\"utf-8\">\n<title>glinf report</title>\n";
+    html += QString("<style>\n%1</style>\n</head>\n<body>\n<h1>glinf report</h1>\n").arg(style);
+
+    /* Overview of the runs with the geometric mean of the speed relative to the baseline */
+    html += "<h2>Runs</h2>\n<table>\n<tr><th>Run</th><th>Host</th><th>Date</th><th>Context</th>"
+        "<th>Vendor</th><th>Renderer</th><th>Version</th><th>Relative speed</th></tr>\n";
+    for (const Run& run : runs) {
+        double logSum = 0.0;
+        int n = 0;
+        for (const Result& r : run.results) {
+            QString k = key(r.benchmark, r.name);
+            if (baseline.results.contains(k)) {
+                logSum += std::log(baseline.results.value(k).seconds / r.seconds);
+                n++;
+            }
+        }
+        html += QString("<tr><td>%1</td><td>%2</td><td>%3</td><td>%4</td><td>%5</td><td>%6</td><td>%7</td>"
+                "<td class=\"num\">%8</td></tr>\n")
+            .arg(run.label.toHtmlEscaped(), run.host.toHtmlEscaped(), run.date.toHtmlEscaped(),
+                    run.context.value("context").toString().toHtmlEscaped(),
+                    run.context.value("vendor").toString().toHtmlEscaped(),
+                    run.context.value("renderer").toString().toHtmlEscaped(),
+                    run.context.value("version").toString().toHtmlEscaped(),
+                    n > 0 ? num(std::exp(logSum / n) * 100.0) + "%" : QString("&ndash;"));
+    }
+    html += "</table>\n";
+    if (runs.size() > 1)
+        html += QString("<p>Relative speeds and differences refer to the baseline <b>%1</b>; "
+                "relative speed is the geometric mean over all common cases.</p>\n")
+            .arg(baseline.label.toHtmlEscaped());
+
+    /* Per benchmark: table, speed comparison, and scaling curves */
+    for (const QString& benchmark : benchmarks) {
+        const QStringList& names = cases[benchmark];
+        html += QString("<h2>Benchmark %1</h2>\n<table>\n<tr><th>Case</th>").arg(benchmark.toHtmlEscaped());
+        for (const Run& run : runs)
+            html += QString("<th>%1</th>").arg(run.label.toHtmlEscaped());
+        html += "</tr>\n";
+        for (const QString& name : names) {
+            QString k = key(benchmark, name);
+            html += QString("<tr><td>%1</td>").arg(name.toHtmlEscaped());
+            for (int i = 0; i < runs.size(); i++) {
+                if (!runs[i].results.contains(k)) {
+                    html += "<td class=\"num\">&ndash;</td>";
+                    continue;
+                }
+                double seconds = runs[i].results.value(k).seconds;
+                QString diff;
+                if (i > 0 && baseline.results.contains(k)) {
+                    double change = seconds / baseline.results.value(k).seconds - 1.0;
+                    diff = QString(" <span class=\"%1\">%2%3%</span>")
+                        .arg(change > 0.05 ? "slower" : change < -0.05 ? "faster" : "")
+                        .arg(change >= 0.0 ? "+" : "").arg(num(change * 100.0));
+                }
+                html += QString("<td class=\"num\">%1 ms%2</td>").arg(num(seconds * 1e3)).arg(diff);
+            }
+            html += "</tr>\n";
+            // Metrics in the order of their first occurrence
+            QStringList metricNames;
+            for (const Run& run : runs)
+                for (const Metric& m : run.results.value(k).metrics)
+                    if (!metricNames.contains(m.name))
+                        metricNames.append(m.name);
+            for (const QString& metricName : metricNames) {
+                html += QString("<tr class=\"metric\"><td>%1</td>").arg(metricName.toHtmlEscaped());
+                for (const Run& run : runs) {
+                    QString cell = "&ndash;";
+                    for (const Metric& m : run.results.value(k).metrics)
+                        if (m.name == metricName)
+                            cell = QString("%1 %2").arg(num(m.value)).arg(m.unit.toHtmlEscaped());
+                    html += QString("<td class=\"num\">%1</td>").arg(cell);
+                }
+                html += "</tr>\n";
+            }
+        }
+        html += "</table>\n";
+
+        if (runs.size() > 1)
+            html += speedChart(QString("Speed relative to %1").arg(baseline.label), runs, benchmark, names);
+
+        // Scaling curves: cases that differ only in their size, with at least 3 sizes
+        QStringList seriesNames;
+        QMap<QString, QList<QString>> seriesCases;
+        for (const QString& name : names) {
+            QString series;
+            double x;
+            if (scalingParameter(name, series, x)) {
+                if (!seriesNames.contains(series))
+                    seriesNames.append(series);
+                seriesCases[series].append(name);
+            }
+        }
+        for (const QString& seriesName : seriesNames) {
+            if (seriesCases[seriesName].size() < 3)
+                continue;
+            QList<Series> series;
+            for (const Run& run : runs) {
+                Series s;
+                s.name = run.label;
+                for (const QString& name : seriesCases[seriesName]) {
+                    QString unused;
+                    double x;
+                    scalingParameter(name, unused, x);
+                    if (run.results.contains(key(benchmark, name))) {
+                        s.x.append(x);
+                        s.y.append(run.results.value(key(benchmark, name)).seconds * 1e3);
+                    }
+                }
+                if (!s.x.isEmpty())
+                    series.append(s);
+            }
+            html += lineChart(seriesName, "ms", series);
+        }
+
+        // Notes, e.g. driver messages
+        QString notes;
+        for (const Run& run : runs) {
+            for (const QString& name : names) {
+                for (const QString& note : run.results.value(key(benchmark, name)).notes)
+                    notes += QString("<li>%1, %2: %3</li>\n").arg(run.label.toHtmlEscaped(),
+                            name.toHtmlEscaped(), note.toHtmlEscaped());
+            }
+        }
+        if (!notes.isEmpty())
+            html += QString("<h3>Notes</h3>\n<ul>\n%1</ul>\n").arg(notes);
+    }
+    html += "</body>\n</html>\n";
+
+    QByteArray data = html.toUtf8();
+    if (fileName.isEmpty()) {
+        fwrite(data.constData(), 1, data.size(), stdout);
+        return true;
+    }
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(data) < 0 || !file.flush()) {
+        fprintf(stderr, "%s: %s\n", qPrintable(fileName), qPrintable(file.errorString()));
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,20 @@
+# Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+# Martin Lambers <marlam@marlam.de>
+#
+# Copying and distribution of this file, with or without modification, are
+# permitted in any medium without royalty provided the copyright notice and this
+# notice are preserved. This file is offered as-is, without any warranty.
+
+# Parse a recorded fdinfo file with "glinf --fdinfo-file" and compare the
+# engines and memory regions it prints with the expected output.
+# Usage: cmake -DGLINF=... -DINPUT=... -DEXPECTED=... -P check.cmake
+
+execute_process(COMMAND ${GLINF} --fdinfo-file ${INPUT}
+    OUTPUT_VARIABLE output RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${GLINF} --fdinfo-file ${INPUT} failed: ${result}")
+endif()
+file(READ ${EXPECTED} expected)
+if(NOT output STREQUAL expected)
+    message(FATAL_ERROR "unexpected output for ${INPUT}:\n${output}\nexpected:\n${expected}")
+endif()
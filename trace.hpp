@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <cstdint>
+
+/* glinf trace files: a compact binary format for a subset of GL calls,
+ * written by glinf-interpose and replayed by glinf --replay.
+ *
+ * A file starts with the 8 bytes traceMagic. It is followed by records, each
+ * consisting of a 32 bit opcode, a 32 bit payload size in bytes, and the
+ * payload, so that readers can skip records they do not know. Payloads hold
+ * the call arguments in order: enums, integers, floats, and object names as 32
+ * bit values; offsets, sizes, and timestamps as 64 bit values. Variable length
+ * data (names, sources, uniform values, pixels, buffer contents) follows at the
+ * end. All values are in the byte order of the recording machine, which is
+ * little endian on all platforms we care about.
+ *
+ * Object names, uniform locations, and the default framebuffer are remapped
+ * on replay. Writes to mapped buffers are recorded as TraceBufferSubData when
+ * the buffer is unmapped. Client-side vertex and index arrays are not
+ * supported. */
+
+static const char traceMagic[8] = { 'G', 'L', 'I', 'N', 'F', 'T', 'R', '1' };
+
+enum TraceOpcode : uint32_t
+{
+    TraceFrame = 1,             // u64 ns since start of recording, at the end of the frame
+    TraceGenBuffers,            // n, n names
+    TraceDeleteBuffers,         // n, n names
+    TraceGenTextures,           // n, n names
+    TraceDeleteTextures,        // n, n names
+    TraceGenVertexArrays,       // n, n names
+    TraceDeleteVertexArrays,    // n, n names
+    TraceGenFramebuffers,       // n, n names
+    TraceDeleteFramebuffers,    // n, n names
+    TraceCreateShader,          // type, result name
+    TraceShaderSource,          // shader, source
+    TraceCompileShader,         // shader
+    TraceDeleteShader,          // shader
+    TraceCreateProgram,         // result name
+    TraceAttachShader,          // program, shader
+    TraceLinkProgram,           // program
+    TraceDeleteProgram,         // program
+    TraceUseProgram,            // program
+    TraceGetUniformLocation,    // program, result location, name
+    TraceUniform1i,             // location, v0
+    TraceUniform1f,             // location, v0
+    TraceUniform4f,             // location, v0, v1, v2, v3
+    TraceUniformfv,             // components (1-4), location, count, count * components floats
+    TraceUniformMatrixfv,       // columns (3, 4), location, count, transpose, count * columns^2 floats
+    TraceBindBuffer,            // target, buffer
+    TraceBindBufferBase,        // target, index, buffer
+    TraceBindBufferRange,       // target, index, buffer, u64 offset, u64 size
+    TraceBufferData,            // target, usage, u64 size, has data (0/1), data
+    TraceBufferSubData,         // target, u64 offset, u64 size, data
+    TraceActiveTexture,         // texture unit
+    TraceBindTexture,           // target, texture
+    TraceTexParameteri,         // target, pname, param
+    TracePixelStorei,           // pname, param
+    TraceTexImage2D,            // target, level, internalformat, width, height, border, format, type, pixels
+    TraceTexStorage2D,          // target, levels, internalformat, width, height
+    TraceTexSubImage2D,         // target, level, x, y, width, height, format, type, pixels
+    TraceGenerateMipmap,        // target
+    TraceBindVertexArray,       // array
+    TraceVertexAttribPointer,   // index, size, type, normalized, stride, u64 offset
+    TraceEnableVertexAttribArray,  // index
+    TraceDisableVertexAttribArray, // index
+    TraceBindFramebuffer,       // target, framebuffer
+    TraceFramebufferTexture2D,  // target, attachment, textarget, texture, level
+    TraceEnable,                // cap
+    TraceDisable,               // cap
+    TraceBlendFunc,             // sfactor, dfactor
+    TraceDepthFunc,             // func
+    TraceDepthMask,             // flag
+    TraceColorMask,             // r, g, b, a
+    TraceViewport,              // x, y, width, height
+    TraceScissor,               // x, y, width, height
+    TraceClearColor,            // r, g, b, a
+    TraceClearDepth,            // depth (float)
+    TraceClear,                 // mask
+    TraceDrawArrays,            // mode, first, count, instances
+    TraceDrawElements,          // mode, count, type, u64 offset, instances, basevertex
+    TraceDispatchCompute,       // x, y, z
+    TraceMemoryBarrier,         // barriers
+    TraceOpcodeCount
+};
+
+/* Pixel data of TraceTexImage2D and TraceTexSubImage2D is one of these,
+ * followed by a u64 size or offset and, for TracePixelsInline, the data */
+enum TracePixels : uint32_t
+{
+    TracePixelsNone = 0,        // a null pointer
+    TracePixelsInline = 1,      // data follows
+    TracePixelsUnpackBuffer = 2 // offset into the bound pixel unpack buffer
+};
+
+#endif
@@ -0,0 +1,632 @@
+/*
+ * Copyright (C) 2017, 2018, 2019, 2020, 2021, 2022
+ * Martin Lambers <marlam@marlam.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cmath>
+#include <vector>
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QMap>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#include "workload.hpp"
+
+/* Deterministic pseudo random numbers (splitmix64). Unlike the distributions
+ * of the C++ standard library, the sequence is the same on all platforms. */
+class Random
+{
+private:
+    uint64_t _state;
+
+public:
+    Random(uint64_t seed) : _state(seed) {}
+
+    uint64_t next()
+    {
+        uint64_t z = (_state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    // A float in [a,b)
+    float uniform(float a = 0.0f, float b = 1.0f)
+    {
+        return a + (b - a) * float(next() >> 40) / 16777216.0f;
+    }
+};
+
+static const struct {
+    const char* name;
+    GLenum value;
+} colorFormats[] = {
+    { "RGBA8", GL_RGBA8 },
+    { "RGBA16F", GL_RGBA16F },
+    { "RGBA32F", GL_RGBA32F }
+}, depthFormats[] = {
+    { "DEPTH16", GL_DEPTH_COMPONENT16 },
+    { "DEPTH24", GL_DEPTH_COMPONENT24 },
+    { "DEPTH32F", GL_DEPTH_COMPONENT32F }
+}, depthFuncs[] = {
+    { "less", GL_LESS },
+    { "lequal", GL_LEQUAL },
+    { "equal", GL_EQUAL },
+    { "greater", GL_GREATER },
+    { "gequal", GL_GEQUAL },
+    { "always", GL_ALWAYS }
+}, cullFaces[] = {
+    { "none", GL_NONE },
+    { "back", GL_BACK },
+    { "front", GL_FRONT }
+}, primitives[] = {
+    { "triangles", GL_TRIANGLES },
+    { "lines", GL_LINES },
+    { "points", GL_POINTS }
+};
+
+template<typename T> static bool lookup(const T& table, const QString& name, GLenum* value)
+{
+    for (const auto& entry : table) {
+        if (name == entry.name) {
+            *value = entry.value;
+            return true;
+        }
+    }
+    return false;
+}
+
+struct Mesh
+{
+    GLuint vao;
+    GLuint buffers[2];
+    GLsizei indexCount;
+};
+
+struct Uniform
+{
+    GLint location;
+    QList<float> value;
+};
+
+struct Draw
+{
+    Mesh mesh;
+    GLuint program;
+    GLenum primitive;
+    QList<GLint> samplers;      // sampler uniform locations, set to units 0, 1, ...
+    QList<GLuint> textures;     // textures bound to units 0, 1, ...
+    QList<Uniform> uniforms;
+    int instances;
+    int repeat;                 // number of draw calls
+};
+
+struct Pass
+{
+    QString name;
+    bool clearColor;
+    float color[4];
+    bool clearDepth;
+    float depth;
+    bool depthTest;
+    GLenum depthFunc;
+    bool depthWrite;
+    bool colorWrite;
+    GLenum cullFace;            // GL_NONE to disable culling
+    QString blend;              // "none", "alpha", or "additive"
+    QList<Draw> draws;
+};
+
+class Workload
+{
+public:
+    Bench& bench;
+    QOpenGLExtraFunctions* gl;
+    QString fileName;
+    QString name;
+    int width, height;
+    GLuint colorTex, depthTex, fbo;
+    QMap<QString, Mesh> meshes;
+    QMap<QString, GLuint> textures;
+    QMap<QString, GLuint> programs;
+    QList<Pass> passes;
+
+    Workload(Bench& bench, const QString& fileName);
+    ~Workload();
+
+    bool error(const QString& message) const;
+    bool load();
+    void render(const Pass& pass);
+
+private:
+    bool loadFramebuffer(const QJsonObject& o);
+    bool loadMesh(const QString& name, const QJsonObject& o);
+    bool loadTexture(const QString& name, const QJsonObject& o);
+    bool loadShaderSource(const QJsonObject& o, const QString& stage, QByteArray* source);
+    bool loadProgram(const QString& name, const QJsonObject& o);
+    bool loadPass(const QJsonObject& o);
+    bool loadDraw(const QJsonObject& o, Draw* draw);
+};
+
+Workload::Workload(Bench& bench, const QString& fileName) :
+    bench(bench), gl(bench.gl), fileName(fileName), width(0), height(0), colorTex(0), depthTex(0), fbo(0)
+{
+}
+
+Workload::~Workload()
+{
+    for (const Mesh& m : meshes) {
+        gl->glDeleteVertexArrays(1, &m.vao);
+        gl->glDeleteBuffers(2, m.buffers);
+    }
+    for (GLuint tex : textures)
+        gl->glDeleteTextures(1, &tex);
+    for (GLuint prg : programs)
+        gl->glDeleteProgram(prg);
+    gl->glDeleteFramebuffers(1, &fbo);
+    gl->glDeleteTextures(1, &depthTex);
+    gl->glDeleteTextures(1, &colorTex);
+}
+
+bool Workload::error(const QString& message) const
+{
+    fprintf(stderr, "%s: %s\n", qPrintable(fileName), qPrintable(message));
+    return false;
+}
+
+bool Workload::loadFramebuffer(const QJsonObject& o)
+{
+    width = o.value("width").toInt(1920);
+    height = o.value("height").toInt(1080);
+    GLenum colorFormat, depthFormat = GL_NONE;
+    if (width < 1 || height < 1)
+        return error("invalid framebuffer size");
+    if (!lookup(colorFormats, o.value("color").toString("RGBA8"), &colorFormat))
+        return error("invalid framebuffer color format");
+    if (o.contains("depth") && !lookup(depthFormats, o.value("depth").toString(), &depthFormat))
+        return error("invalid framebuffer depth format");
+    colorTex = bench.texture(colorFormat, width, height);
+    if (depthFormat != GL_NONE)
+        depthTex = bench.texture(depthFormat, width, height);
+    fbo = bench.framebuffer(colorTex, depthTex);
+    return true;
+}
+
+/* Meshes have 3D positions (attribute 0), normals (attribute 1), and texture
+ * coordinates (attribute 2), interleaved, and 32 bit indices. */
+bool Workload::loadMesh(const QString& name, const QJsonObject& o)
+{
+    std::vector<float> v;
+    std::vector<GLuint> indices;
+    auto vertex = [&](float x, float y, float z, float nx, float ny, float nz, float s, float t) {
+        float a[8] = { x, y, z, nx, ny, nz, s, t };
+        v.insert(v.end(), a, a + 8);
+    };
+    Random random(o.value("seed").toInteger(1));
+    QString type = o.value("type").toString();
+    if (type == "grid") {
+        // A grid in the xy plane with random heights in z
+        int n = o.value("size").toInt(64);
+        float amplitude = o.value("height").toDouble(0.0);
+        if (n < 1)
+            return error(QString("mesh %1: invalid size").arg(name));
+        std::vector<float> h((n + 1) * (n + 1));
+        for (float& z : h)
+            z = random.uniform(0.0f, amplitude);
+        for (int y = 0; y <= n; y++) {
+            for (int x = 0; x <= n; x++) {
+                float dx = (h[y * (n + 1) + std::min(x + 1, n)] - h[y * (n + 1) + std::max(x - 1, 0)]) * n / 4.0f;
+                float dy = (h[std::min(y + 1, n) * (n + 1) + x] - h[std::max(y - 1, 0) * (n + 1) + x]) * n / 4.0f;
+                float l = std::sqrt(dx * dx + dy * dy + 1.0f);
+                vertex(x * 2.0f / n - 1.0f, y * 2.0f / n - 1.0f, h[y * (n + 1) + x],
+                        -dx / l, -dy / l, 1.0f / l, float(x) / n, float(y) / n);
+            }
+        }
+        for (int y = 0; y < n; y++) {
+            for (int x = 0; x < n; x++) {
+                GLuint i = y * (n + 1) + x;
+                GLuint quad[6] = { i, i + 1, i + n + 2, i, i + n + 2, i + n + 1 };
+                indices.insert(indices.end(), quad, quad + 6);
+            }
+        }
+    } else if (type == "sphere") {
+        // A unit sphere
+        int slices = o.value("slices").toInt(32);
+        int stacks = o.value("stacks").toInt(16);
+        if (slices < 3 || stacks < 2)
+            return error(QString("mesh %1: invalid number of slices or stacks").arg(name));
+        const float pi = 3.14159265358979f;
+        for (int j = 0; j <= stacks; j++) {
+            float t = float(j) / stacks;
+            for (int i = 0; i <= slices; i++) {
+                float s = float(i) / slices;
+                float x = std::sin(t * pi) * std::cos(s * 2.0f * pi);
+                float y = std::sin(t * pi) * std::sin(s * 2.0f * pi);
+                float z = -std::cos(t * pi);
+                vertex(x, y, z, x, y, z, s, t);
+            }
+        }
+        for (int j = 0; j < stacks; j++) {
+            for (int i = 0; i < slices; i++) {
+                GLuint k = j * (slices + 1) + i;
+                GLuint quad[6] = { k, k + 1, k + slices + 2, k, k + slices + 2, k + slices + 1 };
+                indices.insert(indices.end(), quad, quad + 6);
+            }
+        }
+    } else if (type == "triangles") {
+        // Randomly placed and oriented triangles in [-1,1]^3
+        int count = o.value("count").toInt(1000);
+        float size = o.value("size").toDouble(0.05);
+        if (count < 1)
+            return error(QString("mesh %1: invalid count").arg(name));
+        for (int i = 0; i < count; i++) {
+            float c[3] = { random.uniform(-1.0f, 1.0f), random.uniform(-1.0f, 1.0f), random.uniform(-1.0f, 1.0f) };
+            float p[3][3];
+            for (int k = 0; k < 3; k++)
+                for (int l = 0; l < 3; l++)
+                    p[k][l] = c[l] + random.uniform(-size, size);
+            float e1[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+            float e2[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+            float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            float l = std::max(std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]), 1e-12f);
+            for (int k = 0; k < 3; k++) {
+                vertex(p[k][0], p[k][1], p[k][2], n[0] / l, n[1] / l, n[2] / l, k == 1 ? 1.0f : 0.0f, k == 2 ? 1.0f : 0.0f);
+                indices.push_back(3 * i + k);
+            }
+        }
+    } else {
+        return error(QString("mesh %1: invalid type").arg(name));
+    }
+
+    Mesh m;
+    gl->glGenVertexArrays(1, &m.vao);
+    gl->glBindVertexArray(m.vao);
+    gl->glGenBuffers(2, m.buffers);
+    gl->glBindBuffer(GL_ARRAY_BUFFER, m.buffers[0]);
+    gl->glBufferData(GL_ARRAY_BUFFER, v.size() * sizeof(float), v.data(), GL_STATIC_DRAW);
+    gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m.buffers[1]);
+    gl->glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+    for (int i = 0; i < 3; i++) {
+        const int offsets[3] = { 0, 3, 6 };
+        gl->glVertexAttribPointer(i, i < 2 ? 3 : 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float),
+                reinterpret_cast<const void*>(offsets[i] * sizeof(float)));
+        gl->glEnableVertexAttribArray(i);
+    }
+    m.indexCount = indices.size();
+    meshes.insert(name, m);
+    return true;
+}
+
+bool Workload::loadTexture(const QString& name, const QJsonObject& o)
+{
+    int w = o.value("width").toInt(256);
+    int h = o.value("height").toInt(256);
+    GLenum format;
+    if (w < 1 || h < 1)
+        return error(QString("texture %1: invalid size").arg(name));
+    if (!lookup(colorFormats, o.value("format").toString("RGBA8"), &format))
+        return error(QString("texture %1: invalid format").arg(name));
+    Random random(o.value("seed").toInteger(1));
+    QString content = o.value("content").toString("noise");
+    if (content != "noise" && content != "checker" && content != "gradient")
+        return error(QString("texture %1: invalid content").arg(name));
+    std::vector<float> data(4 * w * h);
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            float* texel = data.data() + 4 * (y * w + x);
+            for (int c = 0; c < 4; c++) {
+                if (content == "noise")
+                    texel[c] = random.uniform();
+                else if (content == "checker")
+                    texel[c] = ((x / 8 + y / 8) % 2) ? 1.0f : 0.0f;
+                else
+                    texel[c] = c == 0 ? float(x) / w : c == 1 ? float(y) / h : c == 2 ? 0.5f : 1.0f;
+            }
+        }
+    }
+    bool mipmaps = o.value("mipmaps").toBool(false);
+    int levels = 1;
+    if (mipmaps)
+        while ((std::max(w, h) >> levels) > 0)
+            levels++;
+    GLuint tex = bench.texture(format, w, h, levels);
+    if (format == GL_RGBA8) {
+        std::vector<unsigned char> bytes(data.size());
+        for (size_t i = 0; i < data.size(); i++)
+            bytes[i] = std::min(int(data[i] * 256.0f), 255);
+        gl->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, bytes.data());
+    } else {
+        gl->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, GL_RGBA, GL_FLOAT, data.data());
+    }
+    if (mipmaps)
+        gl->glGenerateMipmap(GL_TEXTURE_2D);
+    gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    textures.insert(name, tex);
+    return true;
+}
+
+/* Shader sources are given as a string, as an array of lines, or as the name
+ * of a file relative to the workload file */
+bool Workload::loadShaderSource(const QJsonObject& o, const QString& stage, QByteArray* source)
+{
+    source->clear();
+    if (o.contains(stage + "-file")) {
+        QFile file(QFileInfo(fileName).dir().filePath(o.value(stage + "-file").toString()));
+        if (!file.open(QIODevice::ReadOnly))
+            return error(QString("%1: %2").arg(file.fileName()).arg(file.errorString()));
+        *source = file.readAll();
+    } else if (o.value(stage).isArray()) {
+        for (const QJsonValue& line : o.value(stage).toArray())
+            *source += line.toString().toUtf8() + '\n';
+    } else {
+        *source = o.value(stage).toString().toUtf8();
+    }
+    return true;
+}
+
+bool Workload::loadProgram(const QString& name, const QJsonObject& o)
+{
+    QByteArray vs, fs, gs;
+    if (!loadShaderSource(o, "vertex", &vs) || !loadShaderSource(o, "fragment", &fs)
+            || !loadShaderSource(o, "geometry", &gs))
+        return false;
+    if (vs.isEmpty() || fs.isEmpty())
+        return error(QString("shader %1: vertex and fragment shaders are required").arg(name));
+    GLuint prg = bench.program(vs, fs, gs);
+    if (!prg)
+        return error(QString("shader %1: cannot build shader program").arg(name));
+    programs.insert(name, prg);
+    return true;
+}
+
+bool Workload::loadDraw(const QJsonObject& o, Draw* draw)
+{
+    QString meshName = o.value("mesh").toString();
+    QString programName = o.value("shader").toString();
+    if (!meshes.contains(meshName))
+        return error(QString("draw: unknown mesh %1").arg(meshName));
+    if (!programs.contains(programName))
+        return error(QString("draw: unknown shader %1").arg(programName));
+    draw->mesh = meshes.value(meshName);
+    draw->program = programs.value(programName);
+    if (!lookup(primitives, o.value("primitive").toString("triangles"), &draw->primitive))
+        return error("draw: invalid primitive");
+    QJsonObject samplers = o.value("textures").toObject();
+    for (auto it = samplers.constBegin(); it != samplers.constEnd(); ++it) {
+        QString textureName = it.value().toString();
+        if (!textures.contains(textureName))
+            return error(QString("draw: unknown texture %1").arg(textureName));
+        draw->samplers.append(gl->glGetUniformLocation(draw->program, qPrintable(it.key())));
+        draw->textures.append(textures.value(textureName));
+    }
+    QJsonObject uniforms = o.value("uniforms").toObject();
+    for (auto it = uniforms.constBegin(); it != uniforms.constEnd(); ++it) {
+        Uniform u;
+        u.location = gl->glGetUniformLocation(draw->program, qPrintable(it.key()));
+        if (it.value().isArray()) {
+            for (const QJsonValue& v : it.value().toArray())
+                u.value.append(v.toDouble());
+        } else {
+            u.value.append(it.value().toDouble());
+        }
+        if (u.value.size() > 4 && u.value.size() != 9 && u.value.size() != 16)
+            return error(QString("draw: invalid value for uniform %1").arg(it.key()));
+        draw->uniforms.append(u);
+    }
+    draw->instances = o.value("instances").toInt(1);
+    draw->repeat = o.value("repeat").toInt(1);
+    if (draw->instances < 1 || draw->repeat < 1)
+        return error("draw: invalid instance or repeat count");
+    return true;
+}
+
+bool Workload::loadPass(const QJsonObject& o)
+{
+    Pass pass;
+    pass.name = o.value("name").toString(QString("pass %1").arg(passes.size()));
+    QJsonObject clear = o.value("clear").toObject();
+    pass.clearColor = clear.contains("color");
+    QJsonArray color = clear.value("color").toArray();
+    for (int i = 0; i < 4; i++)
+        pass.color[i] = color.at(i).toDouble(i == 3 ? 1.0 : 0.0);
+    pass.clearDepth = clear.contains("depth");
+    pass.depth = clear.value("depth").toDouble(1.0);
+    QJsonObject state = o.value("state").toObject();
+    pass.depthTest = state.value("depth-test").toBool(false);
+    if (!lookup(depthFuncs, state.value("depth-func").toString("less"), &pass.depthFunc))
+        return error(QString("%1: invalid depth function").arg(pass.name));
+    pass.depthWrite = state.value("depth-write").toBool(true);
+    pass.colorWrite = state.value("color-write").toBool(true);
+    if (!lookup(cullFaces, state.value("cull").toString("none"), &pass.cullFace))
+        return error(QString("%1: invalid cull mode").arg(pass.name));
+    pass.blend = state.value("blend").toString("none");
+    if (pass.blend != "none" && pass.blend != "alpha" && pass.blend != "additive")
+        return error(QString("%1: invalid blend mode").arg(pass.name));
+    for (const QJsonValue& d : o.value("draws").toArray()) {
+        Draw draw;
+        if (!loadDraw(d.toObject(), &draw))
+            return false;
+        pass.draws.append(draw);
+    }
+    passes.append(pass);
+    return true;
+}
+
+bool Workload::load()
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return error(file.errorString());
+    QJsonParseError parseError;
+    QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &parseError);
+    if (parseError.error != QJsonParseError::NoError)
+        return error(QString("offset %1: %2").arg(parseError.offset).arg(parseError.errorString()));
+    if (!doc.isObject())
+        return error("not a workload description");
+    QJsonObject root = doc.object();
+    name = root.value("name").toString(QFileInfo(fileName).completeBaseName());
+    if (!loadFramebuffer(root.value("framebuffer").toObject()))
+        return false;
+    QJsonObject o = root.value("meshes").toObject();
+    for (auto it = o.constBegin(); it != o.constEnd(); ++it)
+        if (!loadMesh(it.key(), it.value().toObject()))
+            return false;
+    o = root.value("textures").toObject();
+    for (auto it = o.constBegin(); it != o.constEnd(); ++it)
+        if (!loadTexture(it.key(), it.value().toObject()))
+            return false;
+    o = root.value("shaders").toObject();
+    for (auto it = o.constBegin(); it != o.constEnd(); ++it)
+        if (!loadProgram(it.key(), it.value().toObject()))
+            return false;
+    for (const QJsonValue& p : root.value("passes").toArray())
+        if (!loadPass(p.toObject()))
+            return false;
+    if (passes.isEmpty())
+        return error("no passes");
+    return true;
+}
+
+void Workload::render(const Pass& pass)
+{
+    if (pass.depthTest)
+        gl->glEnable(GL_DEPTH_TEST);
+    else
+        gl->glDisable(GL_DEPTH_TEST);
+    gl->glDepthFunc(pass.depthFunc);
+    gl->glDepthMask(pass.depthWrite);
+    gl->glColorMask(pass.colorWrite, pass.colorWrite, pass.colorWrite, pass.colorWrite);
+    if (pass.cullFace != GL_NONE) {
+        gl->glEnable(GL_CULL_FACE);
+        gl->glCullFace(pass.cullFace);
+    } else {
+        gl->glDisable(GL_CULL_FACE);
+    }
+    if (pass.blend == "none") {
+        gl->glDisable(GL_BLEND);
+    } else {
+        gl->glEnable(GL_BLEND);
+        if (pass.blend == "alpha")
+            gl->glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        else
+            gl->glBlendFunc(GL_ONE, GL_ONE);
+    }
+    GLbitfield clearMask = 0;
+    if (pass.clearColor) {
+        gl->glClearColor(pass.color[0], pass.color[1], pass.color[2], pass.color[3]);
+        clearMask |= GL_COLOR_BUFFER_BIT;
+    }
+    if (pass.clearDepth) {
+        gl->glClearDepthf(pass.depth);
+        clearMask |= GL_DEPTH_BUFFER_BIT;
+    }
+    if (clearMask) {
+        // glClear respects the write masks
+        gl->glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        gl->glDepthMask(GL_TRUE);
+        gl->glClear(clearMask);
+        gl->glColorMask(pass.colorWrite, pass.colorWrite, pass.colorWrite, pass.colorWrite);
+        gl->glDepthMask(pass.depthWrite);
+    }
+    for (const Draw& d : pass.draws) {
+        gl->glUseProgram(d.program);
+        for (int i = 0; i < d.textures.size(); i++) {
+            gl->glActiveTexture(GL_TEXTURE0 + i);
+            gl->glBindTexture(GL_TEXTURE_2D, d.textures[i]);
+            gl->glUniform1i(d.samplers[i], i);
+        }
+        for (const Uniform& u : d.uniforms) {
+            switch (u.value.size()) {
+            case 1: gl->glUniform1fv(u.location, 1, u.value.constData()); break;
+            case 2: gl->glUniform2fv(u.location, 1, u.value.constData()); break;
+            case 3: gl->glUniform3fv(u.location, 1, u.value.constData()); break;
+            case 4: gl->glUniform4fv(u.location, 1, u.value.constData()); break;
+            case 9: gl->glUniformMatrix3fv(u.location, 1, GL_FALSE, u.value.constData()); break;
+            case 16: gl->glUniformMatrix4fv(u.location, 1, GL_FALSE, u.value.constData()); break;
+            }
+        }
+        gl->glBindVertexArray(d.mesh.vao);
+        for (int i = 0; i < d.repeat; i++)
+            gl->glDrawElementsInstanced(d.primitive, d.mesh.indexCount, GL_UNSIGNED_INT, nullptr, d.instances);
+    }
+}
+
+bool runWorkload(Bench& bench, const QString& fileName)
+{
+    QOpenGLExtraFunctions* gl = bench.gl;
+    if (!bench.atLeast(42, 30)) {
+        fprintf(stderr, "workloads require OpenGL 4.2 or OpenGL ES 3.0\n");
+        return false;
+    }
+    GLint vao;
+    gl->glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vao);
+    bool ok;
+    {
+        Workload workload(bench, fileName);
+        ok = workload.load();
+        if (ok) {
+            bench.begin(QString("workload %1").arg(workload.name));
+            gl->glBindFramebuffer(GL_FRAMEBUFFER, workload.fbo);
+            gl->glViewport(0, 0, workload.width, workload.height);
+            double drawCalls = 0.0;
+            double triangles = 0.0;
+            for (const Pass& pass : workload.passes) {
+                double passDrawCalls = 0.0;
+                double passTriangles = 0.0;
+                for (const Draw& d : pass.draws) {
+                    passDrawCalls += d.repeat;
+                    if (d.primitive == GL_TRIANGLES)
+                        passTriangles += double(d.repeat) * d.instances * d.mesh.indexCount / 3;
+                }
+                Result& r = bench.measure(workload.name, pass.name, [&]() { workload.render(pass); });
+                r.add("draw calls", passDrawCalls, "per iteration");
+                r.addRate("triangles", passTriangles / 1e6, "MTriangles/s");
+                drawCalls += passDrawCalls;
+                triangles += passTriangles;
+            }
+            Result& r = bench.measure(workload.name, "frame", [&]() {
+                    for (const Pass& pass : workload.passes)
+                        workload.render(pass);
+                    });
+            r.add("draw calls", drawCalls, "per iteration");
+            r.addRate("triangles", triangles / 1e6, "MTriangles/s");
+            r.addRate("frames", 1.0, "1/s");
+            bench.flush();
+        }
+    }
+    gl->glBindVertexArray(vao);
+    gl->glActiveTexture(GL_TEXTURE0);
+    gl->glDisable(GL_DEPTH_TEST);
+    gl->glDisable(GL_CULL_FACE);
+    gl->glDisable(GL_BLEND);
+    gl->glDepthMask(GL_TRUE);
+    gl->glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    gl->glUseProgram(0);
+    return ok;
+}